@@ -0,0 +1,312 @@
+#include "blend.h"
+
+// A pixel is packed into a uint32 (a,r,g,b from the top byte down) and
+// split into two pairs of channels (b,r and g,a), each channel in its own
+// 16-bit lane:
+//
+//   0x00rr00bb * t  ->  0xrrrrbbbb
+//
+// A weighted sum of channels (weights adding up to 255) always fits in
+// 16 bits, so one multiply does two channels without them carrying into
+// each other, and Div255() works on both lanes at once.
+// Pixels are packed a channel at a time rather than copied as raw bytes,
+// so byte order doesn't matter. (On little-endian machines the packed
+// value matches the RGBX8/RGBA8 layout, and the compiler turns it into a
+// plain load/store.)
+
+static const uint32_t LANES = 0x00FF00FF;
+static const uint32_t OPAQUE = 0xFF000000;
+
+static inline uint32_t load(RGBA8 const* p)
+{
+    return p->b | (p->g << 8) | (p->r << 16) | ((uint32_t)p->a << 24);
+}
+
+static inline uint32_t load(RGBX8 const* p)
+{
+    return p->b | (p->g << 8) | (p->r << 16) | ((uint32_t)p->pad << 24);
+}
+
+static inline void store(RGBA8* p, uint32_t v)
+{
+    p->b = v & 0xFF;
+    p->g = (v >> 8) & 0xFF;
+    p->r = (v >> 16) & 0xFF;
+    p->a = v >> 24;
+}
+
+static inline void store(RGBX8* p, uint32_t v)
+{
+    p->b = v & 0xFF;
+    p->g = (v >> 8) & 0xFF;
+    p->r = (v >> 16) & 0xFF;
+    p->pad = v >> 24;
+}
+
+// Pack/unpack a block of n pixels.
+template<typename PIX>
+static inline void loadBlock(PIX const* p, uint32_t* v, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        v[i] = load(p + i);
+    }
+}
+
+template<typename PIX>
+static inline void storeBlock(PIX* p, uint32_t const* v, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        store(p + i, v[i]);
+    }
+}
+
+// Div255() on both lanes.
+static inline uint32_t div255Lanes(uint32_t x)
+{
+    x += 0x00800080;
+    return ((x + ((x >> 8) & LANES)) >> 8) & LANES;
+}
+
+// s over an opaque d, with src alpha t. Result is opaque.
+static inline uint32_t overOpaque(uint32_t s, uint32_t d, uint32_t t)
+{
+    uint32_t inv = 255 - t;
+    uint32_t rb = div255Lanes((s & LANES)*t + (d & LANES)*inv);
+    uint32_t ga = div255Lanes(((s >> 8) & LANES)*t + ((d >> 8) & LANES)*inv);
+    return rb | (ga << 8) | OPAQUE;
+}
+
+// s over d, both premultiplied.
+static inline uint32_t overPM(uint32_t s, uint32_t d)
+{
+    uint32_t inv = 255 - (s >> 24);
+    uint32_t rb = (s & LANES) + div255Lanes((d & LANES)*inv);
+    uint32_t ga = ((s >> 8) & LANES) + div255Lanes(((d >> 8) & LANES)*inv);
+    return rb | (ga << 8);
+}
+
+// s over d, where both are partly transparent (0 < t < 255, 0 < d.a < 255).
+// Rare enough (overlapping soft strokes on a transparent layer) to just
+// divide.
+static inline uint32_t overTranslucent(uint32_t s, uint32_t d, uint32_t t)
+{
+    // weights, scaled by 255*255
+    uint32_t ws = t*255;
+    uint32_t wd = (d >> 24)*(255 - t);
+    uint32_t sum = ws + wd;
+    uint32_t half = sum / 2;
+    uint32_t b = ((s & 0xFF)*ws + (d & 0xFF)*wd + half) / sum;
+    uint32_t g = (((s >> 8) & 0xFF)*ws + ((d >> 8) & 0xFF)*wd + half) / sum;
+    uint32_t r = (((s >> 16) & 0xFF)*ws + ((d >> 16) & 0xFF)*wd + half) / sum;
+    return b | (g << 8) | (r << 16) | (Div255(sum) << 24);
+}
+
+// s over d, any alphas.
+static inline uint32_t over(uint32_t s, uint32_t d)
+{
+    uint32_t t = s >> 24;
+    uint32_t da = d >> 24;
+    if (t == 0) {
+        return d;
+    }
+    if (t == 255 || da == 0) {
+        return s;
+    }
+    if (da == 255) {
+        return overOpaque(s, d, t);
+    }
+    return overTranslucent(s, d, t);
+}
+
+
+// Spans are done in blocks of BLOCK pixels. The common cases are spotted for
+// a whole block at once, and then run without any per-pixel branches (so
+// the compiler can vectorise them).
+static const int BLOCK = 8;
+
+void BlendSpan(RGBA8 const* src, RGBX8* dest, int w)
+{
+    // (overOpaque() is fine for any src alpha, so no special cases needed)
+    uint32_t s[BLOCK];
+    uint32_t d[BLOCK];
+    int x = 0;
+    for (; x + BLOCK <= w; x += BLOCK) {
+        loadBlock(src + x, s, BLOCK);
+        loadBlock(dest + x, d, BLOCK);
+        for (int i = 0; i < BLOCK; ++i) {
+            d[i] = overOpaque(s[i], d[i], s[i] >> 24);
+        }
+        storeBlock(dest + x, d, BLOCK);
+    }
+    for (; x < w; ++x) {
+        uint32_t p = load(src + x);
+        store(dest + x, overOpaque(p, load(dest + x), p >> 24));
+    }
+}
+
+void BlendSpan(RGBA8 const* src, RGBA8* dest, int w)
+{
+    uint32_t s[BLOCK];
+    uint32_t d[BLOCK];
+    int x = 0;
+    for (; x + BLOCK <= w; x += BLOCK) {
+        loadBlock(src + x, s, BLOCK);
+        loadBlock(dest + x, d, BLOCK);
+        uint32_t sAnd = ~0u, sOr = 0, dAnd = ~0u, dOr = 0;
+        for (int i = 0; i < BLOCK; ++i) {
+            sAnd &= s[i];
+            sOr |= s[i];
+            dAnd &= d[i];
+            dOr |= d[i];
+        }
+        if ((sOr >> 24) == 0) {
+            continue;   // src all clear
+        }
+        if ((sAnd >> 24) == 255) {
+            storeBlock(dest + x, s, BLOCK);     // src all opaque
+            continue;
+        }
+        if ((dAnd >> 24) == 255) {
+            for (int i = 0; i < BLOCK; ++i) {
+                d[i] = overOpaque(s[i], d[i], s[i] >> 24);
+            }
+        } else if ((dOr >> 24) == 0) {
+            for (int i = 0; i < BLOCK; ++i) {
+                d[i] = (s[i] >> 24) ? s[i] : d[i];
+            }
+        } else {
+            for (int i = 0; i < BLOCK; ++i) {
+                d[i] = over(s[i], d[i]);
+            }
+        }
+        storeBlock(dest + x, d, BLOCK);
+    }
+    for (; x < w; ++x) {
+        store(dest + x, over(load(src + x), load(dest + x)));
+    }
+}
+
+void BlendFill(RGBA8 c, RGBX8* dest, int w)
+{
+    uint32_t s = load(&c);
+    uint32_t t = s >> 24;
+    if (t == 0) {
+        return;
+    }
+    if (t == 255) {
+        for (int x = 0; x < w; ++x) {
+            store(dest + x, s);
+        }
+        return;
+    }
+    // src side of the sum is the same for every pixel
+    uint32_t inv = 255 - t;
+    uint32_t srb = (s & LANES)*t;
+    uint32_t sga = ((s >> 8) & LANES)*t;
+    for (int x = 0; x < w; ++x) {
+        uint32_t d = load(dest + x);
+        uint32_t rb = div255Lanes(srb + (d & LANES)*inv);
+        uint32_t ga = div255Lanes(sga + ((d >> 8) & LANES)*inv);
+        store(dest + x, rb | (ga << 8) | OPAQUE);
+    }
+}
+
+void BlendFill(RGBA8 c, RGBA8* dest, int w)
+{
+    uint32_t s = load(&c);
+    uint32_t t = s >> 24;
+    if (t == 0) {
+        return;
+    }
+    if (t == 255) {
+        for (int x = 0; x < w; ++x) {
+            store(dest + x, s);
+        }
+        return;
+    }
+    uint32_t inv = 255 - t;
+    uint32_t srb = (s & LANES)*t;
+    uint32_t sga = ((s >> 8) & LANES)*t;
+    uint32_t d[BLOCK];
+    int x = 0;
+    for (; x + BLOCK <= w; x += BLOCK) {
+        loadBlock(dest + x, d, BLOCK);
+        uint32_t dAnd = ~0u, dOr = 0;
+        for (int i = 0; i < BLOCK; ++i) {
+            dAnd &= d[i];
+            dOr |= d[i];
+        }
+        if ((dAnd >> 24) == 255) {
+            for (int i = 0; i < BLOCK; ++i) {
+                uint32_t rb = div255Lanes(srb + (d[i] & LANES)*inv);
+                uint32_t ga = div255Lanes(sga + ((d[i] >> 8) & LANES)*inv);
+                d[i] = rb | (ga << 8) | OPAQUE;
+            }
+        } else if ((dOr >> 24) == 0) {
+            for (int i = 0; i < BLOCK; ++i) {
+                d[i] = s;
+            }
+        } else {
+            for (int i = 0; i < BLOCK; ++i) {
+                d[i] = over(s, d[i]);
+            }
+        }
+        storeBlock(dest + x, d, BLOCK);
+    }
+    for (; x < w; ++x) {
+        store(dest + x, over(s, load(dest + x)));
+    }
+}
+
+void BlendSpanPM(RGBA8 const* src, RGBA8* dest, int w)
+{
+    uint32_t s[BLOCK];
+    uint32_t d[BLOCK];
+    int x = 0;
+    for (; x + BLOCK <= w; x += BLOCK) {
+        loadBlock(src + x, s, BLOCK);
+        loadBlock(dest + x, d, BLOCK);
+        for (int i = 0; i < BLOCK; ++i) {
+            d[i] = overPM(s[i], d[i]);
+        }
+        storeBlock(dest + x, d, BLOCK);
+    }
+    for (; x < w; ++x) {
+        store(dest + x, overPM(load(src + x), load(dest + x)));
+    }
+}
+
+void BlendFillPM(RGBA8 c, RGBA8* dest, int w)
+{
+    uint32_t s = load(&c);
+    uint32_t inv = 255 - (s >> 24);
+    if (inv == 255) {
+        return;
+    }
+    uint32_t srb = s & LANES;
+    uint32_t sga = (s >> 8) & LANES;
+    for (int x = 0; x < w; ++x) {
+        uint32_t d = load(dest + x);
+        uint32_t rb = srb + div255Lanes((d & LANES)*inv);
+        uint32_t ga = sga + div255Lanes(((d >> 8) & LANES)*inv);
+        store(dest + x, rb | (ga << 8));
+    }
+}
+
+void PremultiplySpan(RGBA8 const* src, RGBA8* dest, int w)
+{
+    for (int x = 0; x < w; ++x) {
+        uint32_t p = load(src + x);
+        uint32_t a = p >> 24;
+        uint32_t rb = div255Lanes((p & LANES)*a);
+        uint32_t g = div255Lanes(((p >> 8) & 0xFF)*a);
+        store(dest + x, rb | (g << 8) | (a << 24));
+    }
+}
+
+void UnpremultiplySpan(RGBA8 const* src, RGBA8* dest, int w)
+{
+    for (int x = 0; x < w; ++x) {
+        dest[x] = Unpremultiply(src[x]);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef BLEND_H_INCLUDED
+#define BLEND_H_INCLUDED
+
+#include "colours.h"
+
+// Source-over compositing of runs of RGBA8 onto RGBX8/RGBA8 pixels.
+// Results are identical to Blend() in colours.h, but pixels are worked on
+// a pair of channels at a time, and the common cases (opaque src, opaque
+// or empty dest) don't need any divides.
+
+// Blend w src pixels onto dest.
+void BlendSpan(RGBA8 const* src, RGBX8* dest, int w);
+void BlendSpan(RGBA8 const* src, RGBA8* dest, int w);
+
+// Blend a single colour onto w dest pixels.
+void BlendFill(RGBA8 c, RGBX8* dest, int w);
+void BlendFill(RGBA8 c, RGBA8* dest, int w);
+
+// Premultiplied versions (src and dest both premultiplied, as in
+// FMT_RGBA8PM). These are always just a multiply-add per channel.
+void BlendSpanPM(RGBA8 const* src, RGBA8* dest, int w);
+void BlendFillPM(RGBA8 c, RGBA8* dest, int w);
+
+// Convert w pixels between straight and premultiplied alpha
+// (src and dest may be the same).
+void PremultiplySpan(RGBA8 const* src, RGBA8* dest, int w);
+void UnpremultiplySpan(RGBA8 const* src, RGBA8* dest, int w);
+
+#endif // BLEND_H_INCLUDED
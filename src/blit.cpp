@@ -4,6 +4,8 @@
 #include "palette.h"
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
 
 // clips a blit against the destination boundary.
 // assumes srcbox is already valid.
@@ -31,6 +33,58 @@ void clip_blit(
 }
 
 
+// Copy nbits bits, from bit srcBit of src to bit destBit of dest (bits
+// counted from the msb of the first byte), for the packed formats.
+// Works a byte at a time.
+static void copyBits(uint8_t const* src, int srcBit, uint8_t* dest, int destBit, int nbits)
+{
+    if (nbits <= 0) {
+        return;
+    }
+    src += srcBit >> 3;
+    srcBit &= 7;
+    dest += destBit >> 3;
+    destBit &= 7;
+    const int srcBytes = (srcBit + nbits + 7) >> 3;
+    const int destBytes = (destBit + nbits + 7) >> 3;
+    const uint8_t headMask = (uint8_t)(0xff >> destBit);
+    const uint8_t tailMask = (uint8_t)(0xff << (7 - ((destBit + nbits - 1) & 7)));
+
+    if (srcBit == destBit) {
+        // aligned - just need to take care at the ends.
+        if (destBytes == 1) {
+            uint8_t mask = headMask & tailMask;
+            *dest = (uint8_t)((*dest & ~mask) | (*src & mask));
+            return;
+        }
+        *dest = (uint8_t)((*dest & ~headMask) | (*src & headMask));
+        if (destBytes > 2) {
+            memcpy(dest + 1, src + 1, destBytes - 2);
+        }
+        uint8_t& last = dest[destBytes - 1];
+        last = (uint8_t)((last & ~tailMask) | (src[destBytes - 1] & tailMask));
+        return;
+    }
+
+    // Unaligned. Each dest byte is built from (up to) two src bytes.
+    const int offset = srcBit - destBit;   // -7..7
+    for (int i = 0; i < destBytes; ++i) {
+        int pos = i * 8 + offset;
+        int idx = (pos >= 0) ? (pos >> 3) : -1;
+        int sh = pos & 7;
+        unsigned hi = (idx >= 0 && idx < srcBytes) ? src[idx] : 0;
+        unsigned lo = (idx + 1 < srcBytes) ? src[idx + 1] : 0;
+        uint8_t v = (uint8_t)((((hi << 8) | lo) << sh) >> 8);
+        uint8_t mask = 0xff;
+        if (i == 0) {
+            mask &= headMask;
+        }
+        if (i == destBytes - 1) {
+            mask &= tailMask;
+        }
+        dest[i] = (uint8_t)((dest[i] & ~mask) | (v & mask));
+    }
+}
 
 void Blit(
     Img const& srcimg, Box const& srcbox,
@@ -63,12 +117,23 @@ void Blit(
             }
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:
             {
                 RGBA8 const* src = srcimg.PtrConst_RGBA8( srcclipped.x+0, srcclipped.y+y );
                 RGBA8* dest = destimg.Ptr_RGBA8( destclipped.x+0, destclipped.y+y );
                 std::copy( src,src+destclipped.w, dest);
             }
             break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            {
+                int bits = srcimg.BitsPerPixel();
+                copyBits( srcimg.PtrConst(0, srcclipped.y+y), srcclipped.x*bits,
+                    destimg.Ptr(0, destclipped.y+y), destclipped.x*bits,
+                    destclipped.w*bits);
+            }
+            break;
         default:
             assert(false);
             break;
@@ -90,6 +155,10 @@ void BlitSwap(
     Box srcclipped( srcbox );
     clip_blit( srcimg.Bounds(), srcclipped, destimg.Bounds(), destclipped );
 
+    std::vector<uint8_t> tmp;   // for packed formats
+    if (FmtIsPacked(srcimg.Fmt())) {
+        tmp.resize((destclipped.w*srcimg.BitsPerPixel() + 7)/8);
+    }
 
     int y;
     for( y=0; y<destclipped.h; ++y )
@@ -111,12 +180,26 @@ void BlitSwap(
             }
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:
             {
                 RGBA8* src = srcimg.Ptr_RGBA8( srcclipped.x+0, srcclipped.y+y );
                 RGBA8* dest = destimg.Ptr_RGBA8( destclipped.x+0, destclipped.y+y );
                 std::swap_ranges( src,src+destclipped.w, dest);
             }
             break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            {
+                int bits = srcimg.BitsPerPixel();
+                uint8_t* src = srcimg.Ptr(0, srcclipped.y+y);
+                uint8_t* dest = destimg.Ptr(0, destclipped.y+y);
+                int n = destclipped.w*bits;
+                copyBits( dest, destclipped.x*bits, tmp.data(), 0, n);
+                copyBits( src, srcclipped.x*bits, dest, destclipped.x*bits, n);
+                copyBits( tmp.data(), 0, src, srcclipped.x*bits, n);
+            }
+            break;
         default:
             assert(false);
             break;
@@ -127,68 +210,6 @@ void BlitSwap(
 }
 
 
-#if 0
-
-// blit src upon dest, blending with src.alpha
-static void scan_RGBA8_RGBX8(RGBA8 const* src, RGBX8* dest, int w)
-{
-    int x;
-    for( x=0; x<w; ++x )
-    {
-        RGBX8 out = Blend(*src++, *dest);
-        *dest++ = out;
-    }
-}
-
-// blit src upon dest, blending with src.alpha
-static void scan_RGBA8_RGBA8(RGBA8 const* src, RGBA8* dest, int w)
-{
-    int x;
-    for( x=0; x<w; ++x )
-    {
-        RGBA8 out = Blend(*src++, *dest);
-        *dest++ = out;
-    }
-}
-
-
-// blit an RGBA img, blending with src alpha onto the dest (must be RGBX8 or RGBA8)
-void BlitRGBA8( Img const& srcimg, Box const& srcbox, Img& destimg, Box& destbox )
-{
-    assert(srcimg.Fmt()==FMT_RGBA8);
-    assert(destimg.Fmt()!=FMT_I8);
-
-    Box destclipped( destbox );
-    Box srcclipped( srcbox );
-    clip_blit( srcimg.Bounds(), srcclipped, destimg.Bounds(), destclipped );
-
-    const int w = destclipped.w;
-    int y;
-    for( y=0; y<destclipped.h; ++y )
-    {
-        RGBA8 const* src = srcimg.PtrConst_RGBA8( srcclipped.x+0, srcclipped.y+y );
-        switch(destimg.Fmt())
-        {
-            case FMT_I8:
-                assert(false);  // not implemented
-                break;
-            case FMT_RGBX8:
-                scan_RGBA8_RGBX8(src, destimg.Ptr_RGBX8(destclipped.x+0,destclipped.y+y), w);
-                break;
-            case FMT_RGBA8:
-                scan_RGBA8_RGBA8(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w);
-                break;
-            default:
-                assert(false);
-                break;
-        }
-    }
-    destbox = destclipped;
-}
-
-#endif
-
-
 //----------------------------------------------
 
 
@@ -22,9 +22,6 @@ void Blit(Img const& srcimg, Box const& srcbox, Img& destimg, Box& destbox);
 void BlitSwap( Img& srcimg, Box const& srcbox, Img& destimg, Box& destbox);
 
 
-// blit an RGBA img, blending with src alpha onto the dest (must be RGBX8 or RGBA8)
-//void BlitRGBA8( Img const& srcimg, Box const& srcbox, Img& destimg, Box& destbox );
-
 
 #endif // BLIT_H_INCLUDED
 
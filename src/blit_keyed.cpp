@@ -1,8 +1,12 @@
 #include "blit_keyed.h"
 #include "blit.h"
+#include "blend.h"
 #include "img.h"
+#include "img_convert.h"
 #include "palette.h"
 
+#include <vector>
+
 // Keyed blits - blit I8 to dest, with a single transparent colour.
 
 static void scan_I8_I8_keyed(I8 const* src, I8* dest, int w, I8 transparent)
@@ -41,6 +45,18 @@ static void scan_I8_RGBA8_keyed(I8 const* src, Palette const& pal, RGBA8* dest,
     }
 }
 
+static void scan_I8_RGBA8PM_keyed(I8 const* src, Palette const& pal, RGBA8* dest, int w, I8 transparent)
+{
+    int x;
+    for( x=0; x<w; ++x )
+    {
+        I8 c = *src++;
+        if( c != transparent)
+            *dest = Premultiply(pal.GetColour(c));
+        ++dest;
+    }
+}
+
 
 
 
@@ -74,6 +90,9 @@ void BlitI8Keyed(
         case FMT_RGBA8:
             scan_I8_RGBA8_keyed(src, srcpalette, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, transparentIdx);
             break;
+        case FMT_RGBA8PM:
+            scan_I8_RGBA8PM_keyed(src, srcpalette, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, transparentIdx);
+            break;
         default:
             assert(false);
             break;
@@ -96,34 +115,9 @@ static void scan_RGBA8_I8_keyed(RGBA8 const* src, I8* dest, int w )
     }
 }
 
-static void scan_RGBA8_RGBX8_keyed(RGBA8 const* src, RGBX8* dest, int w ) 
-{
-    int x;
-    for( x=0; x<w; ++x )
-    {
-        RGBA8 c = *src++;
-        if( c.a > 0)
-            *dest = RGBX8(c.r, c.g, c.b);
-        ++dest;
-    }
-}
-
-static void scan_RGBA8_RGBA8_keyed(RGBA8 const* src, RGBA8* dest, int w )
-{
-    int x;
-    for( x=0; x<w; ++x )
-    {
-        RGBA8 c = *src++;
-        if( c.a > 0)
-            *dest = c;
-        ++dest;
-    }
-}
-
-
-
-
-// blit from an RGBX8 source to any target, with colourkey transparency
+// blit from an RGBA8 source to any target. Onto RGB targets, src is
+// composited using its alpha (src-over). Onto I8, any non-transparent
+// pixel is drawn.
 void BlitRGBA8Keyed(
     Img const& srcimg, Box const& srcbox,
     Img& destimg, Box& destbox )
@@ -135,6 +129,10 @@ void BlitRGBA8Keyed(
     clip_blit( srcimg.Bounds(), srcclipped, destimg.Bounds(), destclipped );
 
     const int w = destclipped.w;
+    std::vector<RGBA8> tmp;     // premultiplied src row, for FMT_RGBA8PM
+    if (destimg.Fmt() == FMT_RGBA8PM) {
+        tmp.resize(w);
+    }
 
     int y;
     for( y=0; y<destclipped.h; ++y )
@@ -146,10 +144,14 @@ void BlitRGBA8Keyed(
             scan_RGBA8_I8_keyed(src, destimg.Ptr_I8(destclipped.x+0,destclipped.y+y), w );
             break;
         case FMT_RGBX8:
-            scan_RGBA8_RGBX8_keyed(src, destimg.Ptr_RGBX8(destclipped.x+0,destclipped.y+y), w );
+            BlendSpan(src, destimg.Ptr_RGBX8(destclipped.x+0,destclipped.y+y), w );
             break;
         case FMT_RGBA8:
-            scan_RGBA8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w );
+            BlendSpan(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w );
+            break;
+        case FMT_RGBA8PM:
+            PremultiplySpan(src, tmp.data(), w);
+            BlendSpanPM(tmp.data(), destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w );
             break;
         default:
             assert(false);
@@ -228,6 +230,7 @@ void BlitRGBX8Keyed(
             scan_RGBX8_RGBX8_keyed(src, destimg.Ptr_RGBX8(destclipped.x+0,destclipped.y+y), w, transparent);
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:   // (opaque, so the same either way)
             scan_RGBX8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, transparent);
             break;
         default:
@@ -246,6 +249,19 @@ void BlitTransparent(
     Img& destimg, Box& destbox,
     PenColour const& transparentcolour )
 {
+    if (FmtIsPacked(destimg.Fmt())) {
+        Box area(destbox.x, destbox.y, srcbox.w, srcbox.h);
+        WithUnpacked(destimg, area, destbox, [&](Img& tmp, Box& tmpbox) {
+            BlitTransparent(srcimg, srcbox, srcpalette, tmp, tmpbox, transparentcolour);
+        });
+        return;
+    }
+    if (FmtIsPacked(srcimg.Fmt())) {
+        Img* tmp = UnpackArea(srcimg, srcbox);
+        BlitTransparent(*tmp, tmp->Bounds(), srcpalette, destimg, destbox, transparentcolour);
+        delete tmp;
+        return;
+    }
     switch(srcimg.Fmt())
     {
         case FMT_I8:
@@ -73,6 +73,9 @@ void BlitMatteI8Keyed(
         case FMT_RGBA8:
             scan_matte_I8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, transparentIdx, mattecolour.rgb());
             break;
+        case FMT_RGBA8PM:
+            scan_matte_I8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, transparentIdx, mattecolour.toRGBA8PM());
+            break;
         default:
             assert(false);
             break;
@@ -155,6 +158,9 @@ void BlitMatteRGBX8Keyed(
             case FMT_RGBA8:
                 scan_matte_RGBX8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, transparent, matte.rgb());
                 break;
+            case FMT_RGBA8PM:
+                scan_matte_RGBX8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, transparent, matte.toRGBA8PM());
+                break;
             default:
                 assert(false);
                 break;
@@ -212,7 +218,8 @@ void BlitMatteRGBA8Keyed(
     Img& destimg, Box& destbox,
     PenColour const& matte )
 {
-    assert(srcimg.Fmt()==FMT_RGBA8);
+    // (keyed on alpha alone, so premultiplied is the same)
+    assert(srcimg.Fmt()==FMT_RGBA8 || srcimg.Fmt()==FMT_RGBA8PM);
 
     Box destclipped( destbox );
     Box srcclipped( srcbox );
@@ -234,6 +241,9 @@ void BlitMatteRGBA8Keyed(
             case FMT_RGBA8:
                 scan_matte_RGBA8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, matte.rgb());
                 break;
+            case FMT_RGBA8PM:
+                scan_matte_RGBA8_RGBA8_keyed(src, destimg.Ptr_RGBA8(destclipped.x+0,destclipped.y+y), w, matte.toRGBA8PM());
+                break;
             default:
                 assert(false);
                 break;
@@ -258,7 +268,8 @@ void BlitMatte(
         case FMT_RGBX8:
             BlitMatteRGBX8Keyed(srcimg,srcbox,destimg,destbox,transparentcolour.rgb(), mattecolour);
             return;
-        case FMT_RGBA8: 
+        case FMT_RGBA8:
+        case FMT_RGBA8PM:
             BlitMatteRGBA8Keyed(srcimg,srcbox,destimg,destbox, mattecolour);
             return;
         default:
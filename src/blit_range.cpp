@@ -3,125 +3,138 @@
 
 #include "box.h"
 #include "img.h"
+#include "img_convert.h"
 
 #include <algorithm>
 
+
 //----
-// range inc/dec, using a src img as key.
+// RangeShift
 
-static void scan_rangeinc_keyed_I8_I8(I8 const* src, I8* dest, int w, I8 transparent, std::vector<PenColour> const& range)
+RangeShift::RangeShift(std::vector<PenColour> const& range, int direction, PixelFormat fmt) :
+    m_Fmt(fmt),
+    m_Empty(range.empty()),
+    m_Mul(1),
+    m_Shift(31)
 {
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        I8 c = *src++;
-        if( c != transparent) {
-            I8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->idx();
-            }
+    const int n = (int)range.size();
+    // where each range entry moves to (or -1 if it stays put)
+    auto target = [n, direction](int i) -> int {
+        int t = (direction > 0) ? i + 1 : i - 1;
+        return (t >= 0 && t < n) ? t : -1;
+    };
+
+    for (int i = 0; i < 256; ++i) {
+        m_I8[i] = (I8)i;
+    }
+    if (FmtIsIndexed(fmt)) {
+        // backwards, so the first occurrence of an index in the range wins.
+        for (int i = n - 1; i >= 0; --i) {
+            int t = target(i);
+            I8 idx = range[i].idx();
+            m_I8[idx] = (t >= 0) ? (I8)range[t].idx() : idx;
+        }
+        return;
+    }
+
+    // range colours as they appear in the image
+    const bool alpha = (fmt == FMT_RGBA8 || fmt == FMT_RGBA8PM);
+    auto rgba = [fmt](PenColour const& pen) -> RGBA8 {
+        return (fmt == FMT_RGBA8PM) ? pen.toRGBA8PM() : pen.toRGBA8();
+    };
+
+    // gather the distinct colours (again, first occurrence wins)
+    std::vector<uint32_t> keys;
+    std::vector<int> from;
+    for (int i = 0; i < n; ++i) {
+        uint32_t key = alpha ? Key(rgba(range[i])) : Key(range[i].toRGBX8());
+        if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+            keys.push_back(key);
+            from.push_back(i);
         }
-        ++dest;
     }
-}
 
+    // Find a table size and multiplier which leave no collisions.
+    // With the table at least twice the number of colours this rarely
+    // takes more than a couple of goes.
+    int bits = 4;
+    while ((1 << bits) < (int)keys.size() * 2) {
+        ++bits;
+    }
+    uint32_t mul = 0x9E3779B1u;    // golden ratio
+    int tries = 0;
+    while (!BuildHash(keys, bits, mul)) {
+        mul = (mul * 1664525u + 1013904223u) | 1;
+        if (++tries % 32 == 0) {
+            ++bits;     // tried plenty - go bigger
+        }
+    }
 
-static void scan_rangedec_keyed_I8_I8(I8 const* src, I8* dest, int w, I8 transparent, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        I8 c = *src++;
-        if( c != transparent) {
-            I8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->idx();
-            }
+    // NOTE: empty slots are left as key 0 -> black, which maps
+    // black to itself, so no extra check is needed when looking up.
+    const int size = 1 << bits;
+    m_RGBX8.assign(size, RGBX8(0, 0, 0));
+    m_RGBA8.assign(size, RGBA8(0, 0, 0, 0));
+    for (size_t k = 0; k < keys.size(); ++k) {
+        uint32_t slot = Slot(keys[k]);
+        int i = from[k];
+        int t = target(i);
+        PenColour const& out = range[(t >= 0) ? t : i];
+        if (alpha) {
+            m_RGBA8[slot] = rgba(out);
+        } else {
+            m_RGBX8[slot] = out.toRGBX8();
         }
-        ++dest;
     }
 }
 
-
-static void scan_rangeinc_keyed_I8_RGBX8(I8 const* src, RGBX8* dest, int w, I8 transparent, std::vector<PenColour> const& range)
+// Try to lay out keys in a table of 2^bits entries, without collisions.
+bool RangeShift::BuildHash(std::vector<uint32_t> const& keys, int bits, uint32_t mul)
 {
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        I8 c = *src++;
-        if( c != transparent) {
-            RGBX8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBX8() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->toRGBX8();
-            }
+    m_Mul = mul;
+    m_Shift = 32 - bits;
+    const int size = 1 << bits;
+    std::vector<bool> used(size, false);
+    m_Keys.assign(size, 0);
+    for (auto key : keys) {
+        uint32_t slot = Slot(key);
+        if (used[slot]) {
+            return false;
         }
-        ++dest;
+        used[slot] = true;
+        m_Keys[slot] = key;
     }
+    return true;
 }
 
 
-static void scan_rangedec_keyed_I8_RGBX8(I8 const* src, RGBX8* dest, int w, I8 transparent, std::vector<PenColour> const& range)
+//----
+// range inc/dec, using a src img as key.
+
+static void scan_rangeshift_keyed_I8_I8(I8 const* src, I8* dest, int w, I8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        I8 c = *src++;
-        if( c != transparent) {
-            RGBX8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBX8() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->toRGBX8();
-            }
-        }
-        ++dest;
+        I8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
-
-static void scan_rangeinc_keyed_I8_RGBA8(I8 const* src, RGBA8* dest, int w, I8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_I8_RGBX8(I8 const* src, RGBX8* dest, int w, I8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        I8 c = *src++;
-        if( c != transparent) {
-            RGBA8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->toRGBA8();
-            }
-        }
-        ++dest;
+        RGBX8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
-
-static void scan_rangedec_keyed_I8_RGBA8(I8 const* src, RGBA8* dest, int w, I8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_I8_RGBA8(I8 const* src, RGBA8* dest, int w, I8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        I8 c = *src++;
-        if( c != transparent) {
-            RGBA8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->toRGBA8();
-            }
-        }
-        ++dest;
+        RGBA8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
@@ -129,12 +142,10 @@ static void scan_rangedec_keyed_I8_RGBA8(I8 const* src, RGBA8* dest, int w, I8 t
 static void blit_rangeshift_keyed_I8(Img const& srcimg, Box const& srcbox,
     Img& destimg, Box& destbox,
     PenColour const& transparentPen,
-    std::vector<PenColour> const& range,
-    int direction)
+    RangeShift const& shift)
 {
     assert(srcimg.Fmt() == FMT_I8);
     assert(transparentPen.IdxValid());
-    assert(!range.empty());
 
     Box srcclipped(srcbox);
     clip_blit(srcimg.Bounds(), srcclipped, destimg.Bounds(), destbox);
@@ -146,46 +157,24 @@ static void blit_rangeshift_keyed_I8(Img const& srcimg, Box const& srcbox,
     for (y = 0; y < destbox.h; ++y)
     {
         I8 const* src = srcimg.PtrConst_I8(srcclipped.x + 0, srcclipped.y + y);
-        if (direction > 0) {
-            // Increment along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangeinc_keyed_I8_I8(src, destimg.Ptr_I8(x0, y0 + y),
-                        w, transparentPen.idx(), range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangeinc_keyed_I8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
-                        w, transparentPen.idx(), range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangeinc_keyed_I8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
-                        w, transparentPen.idx(), range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
-        } else {
-            // Decrement along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangedec_keyed_I8_I8(src, destimg.Ptr_I8(x0, y0 + y),
-                        w, transparentPen.idx(), range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangedec_keyed_I8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
-                        w, transparentPen.idx(), range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangedec_keyed_I8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
-                        w, transparentPen.idx(), range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
+        switch(destimg.Fmt())
+        {
+            case FMT_I8:
+                scan_rangeshift_keyed_I8_I8(src, destimg.Ptr_I8(x0, y0 + y),
+                    w, transparentPen.idx(), shift);
+                break;
+            case FMT_RGBX8:
+                scan_rangeshift_keyed_I8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
+                    w, transparentPen.idx(), shift);
+                break;
+            case FMT_RGBA8:
+            case FMT_RGBA8PM:
+                scan_rangeshift_keyed_I8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
+                    w, transparentPen.idx(), shift);
+                break;
+            default:
+                assert(false);
+                break;
         }
     }
 }
@@ -193,119 +182,30 @@ static void blit_rangeshift_keyed_I8(Img const& srcimg, Box const& srcbox,
 
 // RGBX8 -> ...
 
-static void scan_rangeinc_keyed_RGBX8_I8(RGBX8 const* src, I8* dest, int w, RGBX8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_RGBX8_I8(RGBX8 const* src, I8* dest, int w, RGBX8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        RGBX8 c = *src++;
-        if( c != transparent) {
-            I8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->idx();
-            }
-        }
-        ++dest;
+        I8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
-
-static void scan_rangedec_keyed_RGBX8_I8(RGBX8 const* src, I8* dest, int w, RGBX8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_RGBX8_RGBX8(RGBX8 const* src, RGBX8* dest, int w, RGBX8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        RGBX8 c = *src++;
-        if( c != transparent) {
-            I8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->idx();
-            }
-        }
-        ++dest;
+        RGBX8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
-
-static void scan_rangeinc_keyed_RGBX8_RGBX8(RGBX8 const* src, RGBX8* dest, int w, RGBX8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_RGBX8_RGBA8(RGBX8 const* src, RGBA8* dest, int w, RGBX8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        RGBX8 c = *src++;
-        if( c != transparent) {
-            RGBX8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBX8() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->toRGBX8();
-            }
-        }
-        ++dest;
-    }
-}
-
-
-static void scan_rangedec_keyed_RGBX8_RGBX8(RGBX8 const* src, RGBX8* dest, int w, RGBX8 transparent, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        RGBX8 c = *src++;
-        if( c != transparent) {
-            RGBX8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBX8() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->toRGBX8();
-            }
-        }
-        ++dest;
-    }
-}
-
-
-static void scan_rangeinc_keyed_RGBX8_RGBA8(RGBX8 const* src, RGBA8* dest, int w, RGBX8 transparent, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        RGBX8 c = *src++;
-        if( c != transparent) {
-            RGBA8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->toRGBA8();
-            }
-        }
-        ++dest;
-    }
-}
-
-
-static void scan_rangedec_keyed_RGBX8_RGBA8(RGBX8 const* src, RGBA8* dest, int w, RGBX8 transparent, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        RGBX8 c = *src++;
-        if( c != transparent) {
-            RGBA8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->toRGBA8();
-            }
-        }
-        ++dest;
+        RGBA8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
@@ -313,11 +213,9 @@ static void scan_rangedec_keyed_RGBX8_RGBA8(RGBX8 const* src, RGBA8* dest, int w
 static void blit_rangeshift_keyed_RGBX8(Img const& srcimg, Box const& srcbox,
     Img& destimg, Box& destbox,
     PenColour const& transparentPen,
-    std::vector<PenColour> const& range,
-    int direction)
+    RangeShift const& shift)
 {
     assert(srcimg.Fmt() == FMT_RGBX8);
-    assert(!range.empty());
 
     Box srcclipped(srcbox);
     clip_blit(srcimg.Bounds(), srcclipped, destimg.Bounds(), destbox);
@@ -329,46 +227,24 @@ static void blit_rangeshift_keyed_RGBX8(Img const& srcimg, Box const& srcbox,
     for (y = 0; y < destbox.h; ++y)
     {
         RGBX8 const* src = srcimg.PtrConst_RGBX8(srcclipped.x + 0, srcclipped.y + y);
-        if (direction > 0) {
-            // Increment along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangeinc_keyed_RGBX8_I8(src, destimg.Ptr_I8(x0, y0 + y),
-                        w, transparentPen.toRGBX8(), range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangeinc_keyed_RGBX8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
-                        w, transparentPen.toRGBX8(), range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangeinc_keyed_RGBX8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
-                        w, transparentPen.toRGBX8(), range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
-        } else {
-            // Decrement along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangedec_keyed_RGBX8_I8(src, destimg.Ptr_I8(x0, y0 + y),
-                        w, transparentPen.toRGBX8(), range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangedec_keyed_RGBX8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
-                        w, transparentPen.toRGBX8(), range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangedec_keyed_RGBX8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
-                        w, transparentPen.toRGBX8(), range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
+        switch(destimg.Fmt())
+        {
+            case FMT_I8:
+                scan_rangeshift_keyed_RGBX8_I8(src, destimg.Ptr_I8(x0, y0 + y),
+                    w, transparentPen.toRGBX8(), shift);
+                break;
+            case FMT_RGBX8:
+                scan_rangeshift_keyed_RGBX8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
+                    w, transparentPen.toRGBX8(), shift);
+                break;
+            case FMT_RGBA8:
+            case FMT_RGBA8PM:
+                scan_rangeshift_keyed_RGBX8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
+                    w, transparentPen.toRGBX8(), shift);
+                break;
+            default:
+                assert(false);
+                break;
         }
     }
 }
@@ -376,130 +252,39 @@ static void blit_rangeshift_keyed_RGBX8(Img const& srcimg, Box const& srcbox,
 
 // RGBA8 -> ...
 
-static void scan_rangeinc_keyed_RGBA8_I8(RGBA8 const* src, I8* dest, int w, RGBA8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_RGBA8_I8(RGBA8 const* src, I8* dest, int w, RGBA8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        RGBA8 c = *src++;
-        if( c != transparent) {
-            I8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->idx();
-            }
-        }
-        ++dest;
+        I8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
-
-static void scan_rangedec_keyed_RGBA8_I8(RGBA8 const* src, I8* dest, int w, RGBA8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_RGBA8_RGBX8(RGBA8 const* src, RGBX8* dest, int w, RGBA8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        RGBA8 c = *src++;
-        if( c != transparent) {
-            I8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->idx();
-            }
-        }
-        ++dest;
+        RGBX8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
-
-static void scan_rangeinc_keyed_RGBA8_RGBX8(RGBA8 const* src, RGBX8* dest, int w, RGBA8 transparent, std::vector<PenColour> const& range)
+static void scan_rangeshift_keyed_RGBA8_RGBA8(RGBA8 const* src, RGBA8* dest, int w, RGBA8 transparent, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
     for( x=0; x<w; ++x ) {
-        RGBA8 c = *src++;
-        if( c != transparent) {
-            RGBX8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBX8() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->toRGBX8();
-            }
-        }
-        ++dest;
-    }
-}
-
-
-static void scan_rangedec_keyed_RGBA8_RGBX8(RGBA8 const* src, RGBX8* dest, int w, RGBA8 transparent, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        RGBA8 c = *src++;
-        if( c != transparent) {
-            RGBX8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBX8() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->toRGBX8();
-            }
-        }
-        ++dest;
-    }
-}
-
-
-static void scan_rangeinc_keyed_RGBA8_RGBA8(RGBA8 const* src, RGBA8* dest, int w, RGBA8 transparent, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        RGBA8 c = *src++;
-        if( c != transparent) {
-            RGBA8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-            if (it < range.end()-1) {
-                *dest = (it+1)->toRGBA8();
-            }
-        }
-        ++dest;
-    }
-}
-
-
-static void scan_rangedec_keyed_RGBA8_RGBA8(RGBA8 const* src, RGBA8* dest, int w, RGBA8 transparent, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        RGBA8 c = *src++;
-        if( c != transparent) {
-            RGBA8 pix = *dest;
-            auto it = std::find_if(range.begin(), range.end(),
-                [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-
-            if (it != range.end() && it > range.begin()) {
-                *dest = (it-1)->toRGBA8();
-            }
-        }
-        ++dest;
+        RGBA8 pix = dest[x];
+        dest[x] = (src[x] != transparent) ? shift.Shift(pix) : pix;
     }
 }
 
 static void blit_rangeshift_keyed_RGBA8(Img const& srcimg, Box const& srcbox,
     Img& destimg, Box& destbox,
     PenColour const& transparentPen,
-    std::vector<PenColour> const& range,
-    int direction)
+    RangeShift const& shift)
 {
     assert(srcimg.Fmt() == FMT_RGBA8);
-    assert(!range.empty());
 
     Box srcclipped(srcbox);
     clip_blit(srcimg.Bounds(), srcclipped, destimg.Bounds(), destbox);
@@ -511,46 +296,24 @@ static void blit_rangeshift_keyed_RGBA8(Img const& srcimg, Box const& srcbox,
     for (y = 0; y < destbox.h; ++y)
     {
         RGBA8 const* src = srcimg.PtrConst_RGBA8(srcclipped.x + 0, srcclipped.y + y);
-        if (direction > 0) {
-            // Increment along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangeinc_keyed_RGBA8_I8(src, destimg.Ptr_I8(x0, y0 + y),
-                        w, transparentPen.toRGBA8(), range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangeinc_keyed_RGBA8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
-                        w, transparentPen.toRGBA8(), range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangeinc_keyed_RGBA8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
-                        w, transparentPen.toRGBA8(), range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
-        } else {
-            // Decrement along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangedec_keyed_RGBA8_I8(src, destimg.Ptr_I8(x0, y0 + y),
-                        w, transparentPen.toRGBA8(), range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangedec_keyed_RGBA8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
-                        w, transparentPen.toRGBA8(), range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangedec_keyed_RGBA8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
-                        w, transparentPen.toRGBA8(), range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
+        switch(destimg.Fmt())
+        {
+            case FMT_I8:
+                scan_rangeshift_keyed_RGBA8_I8(src, destimg.Ptr_I8(x0, y0 + y),
+                    w, transparentPen.toRGBA8(), shift);
+                break;
+            case FMT_RGBX8:
+                scan_rangeshift_keyed_RGBA8_RGBX8(src, destimg.Ptr_RGBX8(x0, y0 + y),
+                    w, transparentPen.toRGBA8(), shift);
+                break;
+            case FMT_RGBA8:
+            case FMT_RGBA8PM:
+                scan_rangeshift_keyed_RGBA8_RGBA8(src, destimg.Ptr_RGBA8(x0, y0 + y),
+                    w, transparentPen.toRGBA8(), shift);
+                break;
+            default:
+                assert(false);
+                break;
         }
     }
 }
@@ -561,133 +324,87 @@ static void blit_rangeshift_keyed_RGBA8(Img const& srcimg, Box const& srcbox,
 void BlitRangeShiftKeyed(Img const& srcimg, Box const& srcbox,
     Img& destimg, Box& destbox,
     PenColour const& transparentPen,
-    std::vector<PenColour> const& range,
-    int direction)
+    RangeShift const& shift)
 {
-    if (range.empty()) {
+    if (shift.Empty()) {
         destbox.w = 0;
         destbox.h = 0;
         return;
     }
+    // (the indexed table works on I8 and packed pixels alike)
+    assert(shift.Fmt() == destimg.Fmt() ||
+        (FmtIsIndexed(shift.Fmt()) && FmtIsIndexed(destimg.Fmt())));
+    if (FmtIsPacked(destimg.Fmt())) {
+        Box area(destbox.x, destbox.y, srcbox.w, srcbox.h);
+        WithUnpacked(destimg, area, destbox, [&](Img& tmp, Box& tmpbox) {
+            BlitRangeShiftKeyed(srcimg, srcbox, tmp, tmpbox, transparentPen, shift);
+        });
+        return;
+    }
     switch(srcimg.Fmt()) {
         case FMT_I8:
-            blit_rangeshift_keyed_I8(srcimg, srcbox, destimg, destbox, transparentPen, range, direction);
+            blit_rangeshift_keyed_I8(srcimg, srcbox, destimg, destbox, transparentPen, shift);
             break;
         case FMT_RGBX8:
-            blit_rangeshift_keyed_RGBX8(srcimg, srcbox, destimg, destbox, transparentPen, range, direction);
+            blit_rangeshift_keyed_RGBX8(srcimg, srcbox, destimg, destbox, transparentPen, shift);
             break;
         case FMT_RGBA8:
-            blit_rangeshift_keyed_RGBA8(srcimg, srcbox, destimg, destbox, transparentPen, range, direction);
+            blit_rangeshift_keyed_RGBA8(srcimg, srcbox, destimg, destbox, transparentPen, shift);
+            break;
+        default:
+            assert(false);
             break;
     }
 }
 
-
-//-------
-// Range inc/dec for solid regions (no keying)
-
-
-static void scan_rangeinc_keyed_I8(I8* dest, int w, std::vector<PenColour> const& range)
+void BlitRangeShiftKeyed(Img const& srcimg, Box const& srcbox,
+    Img& destimg, Box& destbox,
+    PenColour const& transparentPen,
+    std::vector<PenColour> const& range,
+    int direction)
 {
-    assert(!range.empty());
-    int x;
-    for( x=0; x<w; ++x ) {
-        I8 pix = *dest;
-        auto it = std::find_if(range.begin(), range.end(),
-            [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
-        if (it < range.end()-1) {
-            *dest = (it+1)->idx();
-        }
-        ++dest;
-    }
+    RangeShift shift(range, direction, destimg.Fmt());
+    BlitRangeShiftKeyed(srcimg, srcbox, destimg, destbox, transparentPen, shift);
 }
 
-static void scan_rangedec_keyed_I8(I8* dest, int w, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for (x=0; x < w; ++x) {
-        I8 pix = *dest;
-        auto it = std::find_if(range.begin(), range.end(),
-            [pix](PenColour const& pen) -> bool { return pen.idx() == pix;});
 
-        if (it != range.end() && it > range.begin()) {
-            *dest = (it-1)->idx();
-        }
-        ++dest;
-    }
-}
+//-------
+// Range inc/dec for solid regions (no keying)
 
-static void scan_rangeinc_keyed_RGBX8(RGBX8* dest, int w, std::vector<PenColour> const& range)
-{
-    assert(!range.empty());
-    int x;
-    for (x = 0; x < w; ++x) {
-        RGBX8 pix = *dest;
-        auto it = std::find_if(range.begin(), range.end(),
-            [pix](PenColour const& pen) -> bool {return pen.toRGBX8() == pix;});
-        if (it < range.end()-1) {
-            *dest = (it+1)->toRGBX8();
-        }
-        ++dest;
-    }
-}
 
-static void scan_rangedec_keyed_RGBX8(RGBX8* dest, int w, std::vector<PenColour> const& range)
+static void scan_rangeshift_I8(I8* dest, int w, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
-    for (x = 0; x < w; ++x) {
-        RGBX8 pix = *dest;
-        auto it = std::find_if(range.begin(), range.end(),
-            [pix](PenColour const& pen) -> bool { return pen.toRGBX8() == pix;});
-
-        if (it != range.end() && it > range.begin()) {
-            *dest = (it-1)->toRGBX8();
-        }
-        ++dest;
+    for (x=0; x < w; ++x) {
+        dest[x] = shift.Shift(dest[x]);
     }
 }
 
-static void scan_rangeinc_keyed_RGBA8(RGBA8* dest, int w, std::vector<PenColour> const& range)
+static void scan_rangeshift_RGBX8(RGBX8* dest, int w, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
-    for (x = 0; x < w; ++x) {
-        RGBA8 pix = *dest;
-        auto it = std::find_if(range.begin(), range.end(),
-            [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-        if (it < range.end()-1) {
-            *dest = (it+1)->toRGBA8();
-        }
-        ++dest;
+    for (x=0; x < w; ++x) {
+        dest[x] = shift.Shift(dest[x]);
     }
 }
 
-static void scan_rangedec_keyed_RGBA8(RGBA8* dest, int w, std::vector<PenColour> const& range)
+static void scan_rangeshift_RGBA8(RGBA8* dest, int w, RangeShift const& shift)
 {
-    assert(!range.empty());
     int x;
-    for (x = 0; x < w; ++x) {
-        RGBA8 pix = *dest;
-        auto it = std::find_if(range.begin(), range.end(),
-            [pix](PenColour const& pen) -> bool { return pen.toRGBA8() == pix;});
-
-        if (it != range.end() && it > range.begin()) {
-            *dest = (it-1)->toRGBA8();
-        }
-        ++dest;
+    for (x=0; x < w; ++x) {
+        dest[x] = shift.Shift(dest[x]);
     }
 }
 
 
-void DrawRectRangeShift(Img& destimg, Box& rect, std::vector<PenColour> const& range, int direction)
+void DrawRectRangeShift(Img& destimg, Box& rect, RangeShift const& shift)
 {
-    if (range.empty()) {
+    if (shift.Empty()) {
         rect.w = 0;
         rect.h = 0;
         return;
     }
+    assert(shift.Fmt() == destimg.Fmt());
 
     rect.ClipAgainst(destimg.Bounds());
 
@@ -697,41 +414,35 @@ void DrawRectRangeShift(Img& destimg, Box& rect, std::vector<PenColour> const& r
     int y;
     for (y = 0; y < rect.h; ++y)
     {
-        if (direction > 0) {
-            // Increment along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangeinc_keyed_I8(destimg.Ptr_I8(x0, y0 + y), w, range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangeinc_keyed_RGBX8(destimg.Ptr_RGBX8(x0, y0 + y), w, range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangeinc_keyed_RGBA8(destimg.Ptr_RGBA8(x0, y0 + y), w, range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
-        } else {
-            // Decrement along range.
-            switch(destimg.Fmt())
-            {
-                case FMT_I8:
-                    scan_rangedec_keyed_I8(destimg.Ptr_I8(x0, y0 + y), w, range);
-                    break;
-                case FMT_RGBX8:
-                    scan_rangedec_keyed_RGBX8(destimg.Ptr_RGBX8(x0, y0 + y), w, range);
-                    break;
-                case FMT_RGBA8:
-                    scan_rangedec_keyed_RGBA8(destimg.Ptr_RGBA8(x0, y0 + y), w, range);
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
+        switch(destimg.Fmt())
+        {
+            case FMT_I8:
+                scan_rangeshift_I8(destimg.Ptr_I8(x0, y0 + y), w, shift);
+                break;
+            case FMT_RGBX8:
+                scan_rangeshift_RGBX8(destimg.Ptr_RGBX8(x0, y0 + y), w, shift);
+                break;
+            case FMT_RGBA8:
+            case FMT_RGBA8PM:
+                scan_rangeshift_RGBA8(destimg.Ptr_RGBA8(x0, y0 + y), w, shift);
+                break;
+            case FMT_I4:
+            case FMT_I2:
+            case FMT_I1:
+                for (int x = 0; x < w; ++x) {
+                    destimg.SetIndex(x0 + x, y0 + y, shift.Shift(destimg.GetIndex(x0 + x, y0 + y)));
+                }
+                break;
+            default:
+                assert(false);
+                break;
         }
     }
 }
 
+void DrawRectRangeShift(Img& destimg, Box& rect, std::vector<PenColour> const& range, int direction)
+{
+    RangeShift shift(range, direction, destimg.Fmt());
+    DrawRectRangeShift(destimg, rect, shift);
+}
+
@@ -2,6 +2,7 @@
 #define BLIT_RANGE_H_INCLUDED
 
 #include "colours.h"
+#include <cstdint>
 #include <vector>
 
 class Img;
@@ -9,15 +10,68 @@ struct Box;
 class Point;
 struct Palette;
 
+// Lookup table for shifting pixels one step up or down a colour range.
+// Building it costs a little, so make one per stroke rather than per blit.
+// It's built for a specific destination format.
+//
+// Indexed pixels (I8 or packed) use a straight 256-entry table. RGB pixels use a small
+// hash table, sized so that the range colours don't collide, so a lookup
+// is just a multiply, a shift and a compare.
+class RangeShift
+{
+public:
+    RangeShift(std::vector<PenColour> const& range, int direction, PixelFormat fmt);
+
+    bool Empty() const { return m_Empty; }
+    PixelFormat Fmt() const { return m_Fmt; }
+
+    I8 Shift(I8 pix) const { return m_I8[pix]; }
+    RGBX8 Shift(RGBX8 pix) const {
+        uint32_t key = Key(pix);
+        uint32_t slot = Slot(key);
+        return (m_Keys[slot] == key) ? m_RGBX8[slot] : pix;
+    }
+    RGBA8 Shift(RGBA8 pix) const {
+        uint32_t key = Key(pix);
+        uint32_t slot = Slot(key);
+        return (m_Keys[slot] == key) ? m_RGBA8[slot] : pix;
+    }
+
+private:
+    static uint32_t Key(RGBX8 c) { return (c.r << 16) | (c.g << 8) | c.b; }
+    static uint32_t Key(RGBA8 c) { return ((uint32_t)c.a << 24) | (c.r << 16) | (c.g << 8) | c.b; }
+    uint32_t Slot(uint32_t key) const { return (key * m_Mul) >> m_Shift; }
+    bool BuildHash(std::vector<uint32_t> const& keys, int bits, uint32_t mul);
+
+    PixelFormat m_Fmt;
+    bool m_Empty;
+
+    // FMT_I8 and the packed formats
+    I8 m_I8[256];
+
+    // FMT_RGBX8/FMT_RGBA8/FMT_RGBA8PM (colours premultiplied for the latter)
+    uint32_t m_Mul;
+    int m_Shift;
+    std::vector<uint32_t> m_Keys;
+    std::vector<RGBX8> m_RGBX8;
+    std::vector<RGBA8> m_RGBA8;
+};
+
 // use srcimg as a mask to shift pixels in destimg up or down a colour range.
 void BlitRangeShiftKeyed(Img const& srcimg, Box const& srcbox,
     Img& destimg, Box& destbox,
     PenColour const& transparentcolour,
-    std::vector<PenColour> const& range,
-    int direction);
+    RangeShift const& shift);
 
 // rect will be clipped to destimg
+void DrawRectRangeShift(Img& destimg, Box& rect, RangeShift const& shift);
+
+// Convenience versions, which build the lookup table each time.
+void BlitRangeShiftKeyed(Img const& srcimg, Box const& srcbox,
+    Img& destimg, Box& destbox,
+    PenColour const& transparentcolour,
+    std::vector<PenColour> const& range,
+    int direction);
 void DrawRectRangeShift(Img& destimg, Box& rect, std::vector<PenColour> const& range, int direction);
 
 #endif // BLIT_RANGE_H_INCLUDED
-
@@ -1,8 +1,11 @@
 #include "blit_zoom.h"
+#include "blend.h"
 #include "blit.h"
 #include "img.h"
 #include "palette.h"
 
+#include <vector>
+
 
 // TODO: should probably kill most of these. Only needed because there's no
 // real integration between tools and view rendering.
@@ -64,6 +67,26 @@ static void scan_zoom_keyed_RGBA8_RGBX8(RGBA8 const* src, RGBX8* dest, int w, in
     }
 }
 
+static void scan_zoom_keyed_RGBA8PM_RGBX8(RGBA8 const* src, RGBX8* dest, int w, int xzoom)
+{
+    int n=0;
+    int x;
+    for( x=0; x<w; ++x )
+    {
+        RGBA8 c = *src;
+        if( c.a>0 ) {
+            c = Unpremultiply(c);
+            *dest = RGBX8(c.r, c.g, c.b);
+        }
+        ++dest;
+        if( ++n >= xzoom )  // on to next src pixel?
+        {
+            ++src;
+            n=0;
+        }
+    }
+}
+
 void BlitZoomKeyed(
     Img const& srcimg, Box const& srcbox,
     Palette const& srcpalette,
@@ -104,6 +127,13 @@ void BlitZoomKeyed(
                     transparentcolour.rgb(),
                     xzoom );
             break;
+        case FMT_RGBA8PM:
+            scan_zoom_keyed_RGBA8PM_RGBX8(
+                srcimg.PtrConst_RGBA8(srcclipped.XMin()+0, srcclipped.YMin()+y/yzoom),
+                    dest,
+                    destclipped.W(),
+                    xzoom );
+            break;
         default:
             scan_zoom_keyed_RGBA8_RGBX8(
                 srcimg.PtrConst_RGBA8(srcclipped.XMin()+0, srcclipped.YMin()+y/yzoom),
@@ -217,6 +247,7 @@ void BlitZoomMatteKeyed(
                 mattecolour.rgb() );
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:   // (keyed on alpha alone)
             scan_zoom_matte_keyed_RGBA8_RGBX8(
                 srcimg.PtrConst_RGBA8(srcclipped.XMin()+0, srcclipped.YMin()+y/yzoom),
                 dest,
@@ -284,6 +315,23 @@ static void scan_zoom_I8_RGBA8(I8 const* src, Palette const& pal, RGBA8* dest, i
     }
 }
 
+static void scan_zoom_I8_RGBA8PM(I8 const* src, Palette const& pal, RGBA8* dest, int w, int xzoom)
+{
+    int n=0;
+    int x;
+    RGBA8 c = Premultiply(pal.GetColour(*src));
+    for( x=0; x<w; ++x )
+    {
+        *dest++ = c;
+        if( ++n >= xzoom )
+        {
+            ++src;
+            c = Premultiply(pal.GetColour(*src));
+            n=0;
+        }
+    }
+}
+
 
 void BlitZoomI8(
     Img const& srcimg, Box const& srcbox,
@@ -330,6 +378,14 @@ void BlitZoomI8(
                 destclipped.W(),
                 xzoom );
             break;
+        case FMT_RGBA8PM:
+            scan_zoom_I8_RGBA8PM(
+                src,
+                pal,
+                destimg.Ptr_RGBA8( destclipped.XMin() + 0, destclipped.YMin() + y ),
+                destclipped.W(),
+                xzoom );
+            break;
         default:
             assert(false);
             break;
@@ -406,6 +462,7 @@ void BlitZoomRGBX8(
                 xzoom );
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:   // (opaque, so the same either way)
             scan_zoom_RGBX8_RGBA8(
                 src,
                 destimg.Ptr_RGBA8( destclipped.XMin() + 0, destclipped.YMin() + y ),
@@ -426,7 +483,7 @@ void BlitZoomRGBX8(
 static void scan_zoom_RGBA8_RGBX8(RGBA8 const* src, RGBX8* dest, int w, int xzoom)
 {
     int x;
-    for( x=0; x<w; ++x )
+    for( x=0; x<w; x+=xzoom )
     {
         RGBA8 foo = *src++;
         RGBX8 c(foo.r, foo.g, foo.b);
@@ -439,7 +496,7 @@ static void scan_zoom_RGBA8_RGBX8(RGBA8 const* src, RGBX8* dest, int w, int xzoo
 static void scan_zoom_RGBA8_RGBA8(RGBA8 const* src, RGBA8* dest, int w, int xzoom)
 {
     int x;
-    for( x=0; x<w; ++x )
+    for( x=0; x<w; x+=xzoom )
     {
         RGBA8 c = *src++;
         int n;
@@ -455,7 +512,7 @@ void BlitZoomRGBA8(
     int xzoom,
     int yzoom )
 {
-    assert( srcimg.Fmt()==FMT_RGBA8);
+    assert( srcimg.Fmt()==FMT_RGBA8 || srcimg.Fmt()==FMT_RGBA8PM);
     assert( srcimg.Bounds().Contains( srcbox ) );
     assert( xzoom >= 1 );
     assert( yzoom >= 1 );
@@ -464,10 +521,26 @@ void BlitZoomRGBA8(
     Box srcclipped( srcbox );
     clip_blit( srcimg.Bounds(), srcclipped, destimg.Bounds(), destclipped, xzoom, yzoom );
 
+    // rows are converted if src and dest disagree about premultiplication
+    // (RGBX8 dest takes straight colours)
+    bool srcPM = (srcimg.Fmt()==FMT_RGBA8PM);
+    bool destPM = (destimg.Fmt()==FMT_RGBA8PM);
+    std::vector<RGBA8> tmp;
+    if (srcPM != destPM) {
+        tmp.resize(srcclipped.W());
+    }
+
     int y;
     for( y=0; y<destclipped.H(); ++y )
     {
         RGBA8 const* src = srcimg.PtrConst_RGBA8( srcclipped.XMin()+0, srcclipped.YMin()+y/yzoom );
+        if (srcPM && !destPM) {
+            UnpremultiplySpan(src, tmp.data(), srcclipped.W());
+            src = tmp.data();
+        } else if (!srcPM && destPM) {
+            PremultiplySpan(src, tmp.data(), srcclipped.W());
+            src = tmp.data();
+        }
         switch(destimg.Fmt())
         {
         case FMT_I8:
@@ -481,6 +554,7 @@ void BlitZoomRGBA8(
                 xzoom );
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:
             scan_zoom_RGBA8_RGBA8(
                 src,
                 destimg.Ptr_RGBA8( destclipped.XMin() + 0, destclipped.YMin() + y ),
@@ -512,6 +586,7 @@ void BlitZoom(
             BlitZoomRGBX8(srcimg,srcbox,destimg,destbox,xzoom,yzoom);
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:
             BlitZoomRGBA8(srcimg,srcbox,destimg,destbox,xzoom,yzoom);
             break;
         default:
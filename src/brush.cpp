@@ -1,24 +1,114 @@
 #include "brush.h"
 
+#include <atomic>
+
+// Runs of the same colour shorter than this are just lumped in with
+// their neighbours (filling isn't any quicker than copying for them).
+static const int MIN_SOLID_RUN = 4;
+
+static std::atomic<unsigned int> nextGeneration(1);
+
 
 
 Brush::Brush( BrushStyle style, int w, int h, uint8_t const* initial, PenColour transparent ) :
     Img( FMT_I8, w,h,initial ),
     m_Style(style),
+    m_Generation(0),
     m_Handle( w/2, h/2 ),
     m_Transparent(transparent)
 {
+    CalcRuns();
 }
 
 Brush::Brush( BrushStyle style, Img const& src, Box const& area, PenColour transparent ) :
     Img( src,area ),
     m_Style(style),
+    m_Generation(0),
     m_Handle( area.w/2, area.h/2 ),
     m_Transparent(transparent)
 {
+    CalcRuns();
 }
 
 Brush::~Brush()
 {
 }
 
+void Brush::XFlip()
+{
+    Img::XFlip();
+    CalcRuns();
+}
+
+void Brush::YFlip()
+{
+    Img::YFlip();
+    CalcRuns();
+}
+
+// Same keying rules as the blits.
+static bool isOpaque(Img const& img, int x, int y, PenColour const& transparent)
+{
+    switch (img.Fmt()) {
+        case FMT_I8:
+            return *img.PtrConst_I8(x, y) != transparent.idx();
+        case FMT_RGBX8:
+            return *img.PtrConst_RGBX8(x, y) != transparent.toRGBX8();
+        case FMT_RGBA8:
+            return img.PtrConst_RGBA8(x, y)->a > 0;
+        default:
+            assert(false);
+            return false;
+    }
+}
+
+static bool samePixel(Img const& img, int x0, int x1, int y)
+{
+    switch (img.Fmt()) {
+        case FMT_I8:
+            return *img.PtrConst_I8(x0, y) == *img.PtrConst_I8(x1, y);
+        case FMT_RGBX8:
+            return *img.PtrConst_RGBX8(x0, y) == *img.PtrConst_RGBX8(x1, y);
+        case FMT_RGBA8:
+            return *img.PtrConst_RGBA8(x0, y) == *img.PtrConst_RGBA8(x1, y);
+        default:
+            assert(false);
+            return false;
+    }
+}
+
+// (called whenever the pixels change, so bumps the generation too)
+void Brush::CalcRuns()
+{
+    m_Generation = nextGeneration++;
+    m_Runs.clear();
+    m_RowStart.resize(H() + 1);
+    for (int y = 0; y < H(); ++y) {
+        m_RowStart[y] = (int)m_Runs.size();
+        int x = 0;
+        while (x < W()) {
+            if (!isOpaque(*this, x, y, m_Transparent)) {
+                ++x;
+                continue;
+            }
+            // find extent of same-coloured pixels
+            int end = x + 1;
+            while (end < W() && isOpaque(*this, end, y, m_Transparent) && samePixel(*this, x, end, y)) {
+                ++end;
+            }
+            bool solid = (end - x) >= MIN_SOLID_RUN;
+            // extend the previous run if we can
+            if ((int)m_Runs.size() > m_RowStart[y]) {
+                Run& prev = m_Runs.back();
+                if (prev.x + prev.len == x && !prev.solid && !solid) {
+                    prev.len += end - x;
+                    x = end;
+                    continue;
+                }
+            }
+            m_Runs.push_back(Run{x, end - x, solid});
+            x = end;
+        }
+    }
+    m_RowStart[H()] = (int)m_Runs.size();
+}
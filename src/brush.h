@@ -4,12 +4,22 @@
 #include "img.h"
 #include "palette.h"
 
+#include <vector>
+
 
 enum BrushStyle { MASK, FULLCOLOUR };
 
 class Brush : public Img        // TODO: UGH. no no no.
 {
 public:
+    // A horizontal run of opaque pixels.
+    // Solid runs are all the same colour.
+    struct Run {
+        int x;
+        int len;
+        bool solid;
+    };
+
     Brush( BrushStyle style, int w, int h, uint8_t const* initial, PenColour transparent );
 
     // copy from an image
@@ -28,12 +38,35 @@ public:
     void SetPalette( Palette const& pal )
         { m_Palette = pal; }
 
+    // The opaque runs on row y (count is set to the number of them).
+    // Calculated up front, so stamping the brush can skip transparent
+    // pixels altogether.
+    Run const* Runs( int y, int& count ) const
+        { count = m_RowStart[y+1] - m_RowStart[y]; return m_Runs.data() + m_RowStart[y]; }
+
+    // A number which changes whenever the brush is created or modified
+    // (never reused, unlike the brush's address), so anything derived from
+    // a brush can tell if it's out of date.
+    unsigned int Generation() const { return m_Generation; }
+
+    // (recalculate the runs after flipping)
+    virtual void XFlip() override;
+    virtual void YFlip() override;
+
 private:
+    void CalcRuns();
+
+
     BrushStyle m_Style;
+    unsigned int m_Generation;
     Point m_Handle;
     PenColour m_Transparent;
 
     Palette m_Palette;
+
+    // runs for row y are m_Runs[m_RowStart[y]] to m_Runs[m_RowStart[y+1]]
+    std::vector<Run> m_Runs;
+    std::vector<int> m_RowStart;
 };
 
 
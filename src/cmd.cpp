@@ -2,9 +2,12 @@
 #include "layer.h"
 #include "blit.h"
 #include "draw.h"
+#include "histogram.h"
+#include "jobs.h"
 #include "sheet.h"
 #include "project.h"
 #include <assert.h>
+#include <algorithm>
 #include <cstdio>
 #include <utility>
 
@@ -15,33 +18,48 @@ Cmd_Draw::Cmd_Draw(Project& proj, NodePath const& target, int frame, Box const&
     m_Img(undoimg, affected),
     m_Affected( affected )
 {
+    // the drawing's already been done - bring the colour usage up to date
+    Histogram* usage = proj.ResolveLayer(m_Target).CachedColourUsage(m_Frame);
+    if (usage) {
+        usage->Remove(undoimg, m_Affected);
+        usage->Add(proj.GetImgConst(m_Target, m_Frame), m_Affected);
+    }
 }
 
 void Cmd_Draw::Do()
 {
     assert( State() == NOT_DONE );
-    Box dirty( m_Affected );
-    Img& targImg = Proj().GetImg(m_Target, m_Frame);
-    BlitSwap(m_Img, m_Img.Bounds(), targImg, dirty);
-    Proj().NotifyDamage(m_Target, m_Frame, dirty);
+    Swap();
     SetState(DONE);
 }
 
 void Cmd_Draw::Undo()
 {
     assert( State() == DONE );
+    Swap();
+    SetState( NOT_DONE );
+}
+
+void Cmd_Draw::Swap()
+{
     Box dirty( m_Affected );
     Img& targImg = Proj().GetImg(m_Target, m_Frame);
-    BlitSwap( m_Img, m_Img.Bounds(), targImg, dirty );
+    Histogram* usage = Proj().ResolveLayer(m_Target).CachedColourUsage(m_Frame);
+    if (usage) {
+        usage->Remove(targImg, m_Affected);
+    }
+    BlitSwap(m_Img, m_Img.Bounds(), targImg, dirty);
+    if (usage) {
+        usage->Add(targImg, m_Affected);
+    }
     Proj().NotifyDamage(m_Target, m_Frame, dirty);
-    SetState( NOT_DONE );
 }
 
 
 Cmd_ResizeFrames::Cmd_ResizeFrames(Project& proj, NodePath const& targ,
     int firstFrame,
     int numFrames,
-    Box const& newArea, PenColour const& fillPen) :
+    Box const& newArea, PenColour const& fillPen, Job* job) :
     Cmd(proj, NOT_DONE),
     mTarg(targ),
     mFirstFrame(firstFrame),
@@ -50,16 +68,20 @@ Cmd_ResizeFrames::Cmd_ResizeFrames(Project& proj, NodePath const& targ,
     Layer& l = proj.ResolveLayer(mTarg);
 
     // populate frameswap with the resized frames
+    std::vector<Frame const*> srcFrames;
     if (mFirstFrame == SPARE_FRAME) {
         assert(mNumFrames == 1);
         assert(l.mSpare);
-        mFrameSwap.push_back(Resize(l.mSpare, newArea, fillPen));
+        srcFrames.push_back(l.mSpare);
     } else {
         for (int i = mFirstFrame; i < mFirstFrame + mNumFrames; ++i) {
-            Frame const* src = l.mFrames[i];
-            mFrameSwap.push_back(Resize(src, newArea, fillPen));
+            srcFrames.push_back(l.mFrames[i]);
         }
     }
+    mFrameSwap.resize(srcFrames.size(), nullptr);
+    JobPool::Shared().ParallelFor((int)srcFrames.size(), [&](int i) {
+        mFrameSwap[i] = Resize(srcFrames[i], newArea, fillPen);
+    }, job);
 }
 
 Frame* Cmd_ResizeFrames::Resize(Frame const* src,
@@ -93,6 +115,7 @@ void Cmd_ResizeFrames::Swap()
         for (int i = 0; i < mNumFrames; ++i) {
             std::swap(l.mFrames[mFirstFrame + i], mFrameSwap[i]);
         }
+        l.InvalidateFrameTimes();
     }
     Proj().NotifyFramesBlatted(mTarg, mFirstFrame, mNumFrames);
 }
@@ -111,6 +134,73 @@ void Cmd_ResizeFrames::Undo()
 
 
 
+Cmd_ScaleFrames::Cmd_ScaleFrames(Project& proj, NodePath const& targ,
+    int firstFrame,
+    int numFrames,
+    ScaleMethod method,
+    Job* job) :
+    Cmd(proj, NOT_DONE),
+    mTarg(targ),
+    mFirstFrame(firstFrame),
+    mNumFrames(numFrames)
+{
+    Layer& l = proj.ResolveLayer(mTarg);
+
+    // populate frameswap with the scaled frames
+    std::vector<Frame const*> srcFrames;
+    if (mFirstFrame == SPARE_FRAME) {
+        assert(mNumFrames == 1);
+        assert(l.mSpare);
+        srcFrames.push_back(l.mSpare);
+    } else {
+        for (int i = mFirstFrame; i < mFirstFrame + mNumFrames; ++i) {
+            srcFrames.push_back(l.mFrames[i]);
+        }
+    }
+    mFrameSwap.resize(srcFrames.size(), nullptr);
+    JobPool::Shared().ParallelFor((int)srcFrames.size(), [&](int i) {
+        Frame const* src = srcFrames[i];
+        Frame* dest = new Frame(*src);
+        dest->mImg = DoScale(*src->mImg, method);
+        mFrameSwap[i] = dest;
+    }, job);
+}
+
+Cmd_ScaleFrames::~Cmd_ScaleFrames()
+{
+    for (auto frame : mFrameSwap) {
+        delete frame;
+    }
+}
+
+void Cmd_ScaleFrames::Swap()
+{
+    Layer& l = Proj().ResolveLayer(mTarg);
+    if (mFirstFrame == SPARE_FRAME) {
+        std::swap(l.mSpare, mFrameSwap[0]);
+    } else {
+        for (int i = 0; i < mNumFrames; ++i) {
+            std::swap(l.mFrames[mFirstFrame + i], mFrameSwap[i]);
+        }
+        l.InvalidateFrameTimes();
+    }
+    Proj().NotifyFramesBlatted(mTarg, mFirstFrame, mNumFrames);
+}
+
+void Cmd_ScaleFrames::Do()
+{
+    Swap();
+    SetState(DONE);
+}
+
+void Cmd_ScaleFrames::Undo()
+{
+    Swap();
+    SetState(NOT_DONE);
+}
+
+
+
 Cmd_InsertFrames::Cmd_InsertFrames(Project& proj, NodePath const& target, int pos, int numFrames) :
     Cmd(proj,NOT_DONE),
     m_Target(target),
@@ -148,6 +238,7 @@ void Cmd_InsertFrames::Do()
 
     l.mFrames.insert( l.mFrames.begin() + m_Pos,
         newFrames.begin(), newFrames.end());
+    l.InvalidateFrameTimes();
 
     Proj().NotifyFramesAdded(m_Target, m_Pos, m_NumFrames);
     SetState( DONE );
@@ -163,6 +254,7 @@ void Cmd_InsertFrames::Undo()
         delete *it;
     }
     l.mFrames.erase(start, end);
+    l.InvalidateFrameTimes();
 
     Proj().NotifyFramesRemoved(m_Target, m_Pos, m_NumFrames);
     SetState(NOT_DONE);
@@ -200,6 +292,7 @@ void Cmd_DeleteFrames::Do()
         m_FrameSwap.push_back(*it);
     }
     l.mFrames.erase(start, end);
+    l.InvalidateFrameTimes();
 
     Proj().NotifyFramesRemoved(m_Target, m_Pos, m_NumFrames);
     SetState(DONE);
@@ -213,6 +306,7 @@ void Cmd_DeleteFrames::Undo()
     l.mFrames.insert( l.mFrames.begin() + m_Pos,
         m_FrameSwap.begin(), m_FrameSwap.end());
     m_FrameSwap.clear();
+    l.InvalidateFrameTimes();
 
     Proj().NotifyFramesAdded(m_Target, m_Pos, m_NumFrames);
     SetState(NOT_DONE);
@@ -222,7 +316,7 @@ void Cmd_DeleteFrames::Undo()
 
 //-----------
 //
-Cmd_ToSpriteSheet::Cmd_ToSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid) :
+Cmd_ToSpriteSheet::Cmd_ToSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid, Job* job) :
     Cmd(proj,NOT_DONE),
     mTarg(targ),
     mGridSwap(grid)
@@ -230,7 +324,7 @@ Cmd_ToSpriteSheet::Cmd_ToSpriteSheet(Project& proj, NodePath const& targ, Sprite
     Layer& l = Proj().ResolveLayer(mTarg);
     assert(grid.numFrames == l.mFrames.size());
 
-    Img* sheet = FramesToSpriteSheet(l.mFrames, grid);
+    Img* sheet = FramesToSpriteSheet(l.mFrames, grid, job);
     mFrameSwap.push_back(new Frame(sheet,0));
 }
 
@@ -248,6 +342,7 @@ void Cmd_ToSpriteSheet::Swap()
     int delta = (int)mFrameSwap.size() - (int)l.mFrames.size();
     int blatcount = std::min(mFrameSwap.size(), l.mFrames.size());
     std::swap(l.mFrames, mFrameSwap);
+    l.InvalidateFrameTimes();
     std::swap(Proj().mSettings.SpriteSheetGrid, mGridSwap);
 
     if (delta < 0) {
@@ -274,7 +369,7 @@ void Cmd_ToSpriteSheet::Undo()
 
 //-----------
 //
-Cmd_FromSpriteSheet::Cmd_FromSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid) :
+Cmd_FromSpriteSheet::Cmd_FromSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid, Job* job) :
     Cmd(proj,NOT_DONE),
     mTarg(targ),
     mGridSwap(grid)
@@ -285,7 +380,7 @@ Cmd_FromSpriteSheet::Cmd_FromSpriteSheet(Project& proj, NodePath const& targ, Sp
     Img const& src = *(l.mFrames[0]->mImg);
 
     std::vector<Img*> cells;
-    FramesFromSpriteSheet(src, grid, cells);
+    FramesFromSpriteSheet(src, grid, cells, job);
     for (auto img : cells) {
         mFrameSwap.push_back(new Frame(img, 0));
     }
@@ -305,6 +400,7 @@ void Cmd_FromSpriteSheet::Swap()
     int delta = (int)mFrameSwap.size() - (int)l.mFrames.size();
     int blatcount = std::min(mFrameSwap.size(), l.mFrames.size());
     std::swap(l.mFrames, mFrameSwap);
+    l.InvalidateFrameTimes();
     std::swap(Proj().mSettings.SpriteSheetGrid, mGridSwap);
 
     if (delta < 0) {
@@ -415,7 +511,12 @@ Cmd_PaletteReplace::Cmd_PaletteReplace(Project& proj, NodePath const& target, in
     mPalette(newPalette),
     mRanges(proj.Ranges(target, frame))
 {
-    mRanges.UpdateAll(newPalette);
+    // A packed layer can only hold the colours which fit.
+    PixelFormat fmt = proj.ResolveLayer(target).Fmt();
+    if (FmtIsPacked(fmt)) {
+        mPalette.SetNumColours(std::min(mPalette.NumColours(), 1 << FmtBits(fmt)));
+    }
+    mRanges.UpdateAll(mPalette);
 }
 
 Cmd_PaletteReplace::~Cmd_PaletteReplace()
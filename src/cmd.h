@@ -6,13 +6,19 @@
 #include "point.h"
 #include "img.h"
 #include "brush.h"
+#include "scale2x.h"
 #include "sheet.h"
 
 #include <vector>
 
 class Project;
 class Cmd_PaletteModify;
+class Job;
 
+// Cmds which do a lot of work up front (eg resizing every frame) take an
+// optional Job. The work is spread over the JobPool, and if the Job gets
+// cancelled the Cmd is left half-built - it should just be deleted rather
+// than passed to AddCmd().
 class Cmd
 {
 public:
@@ -52,6 +58,7 @@ public:
     virtual void Do();
     virtual void Undo();
 private:
+    void Swap();
     NodePath m_Target;
     int m_Frame;
     Img m_Img;
@@ -66,7 +73,7 @@ class Cmd_ResizeFrames : public Cmd
 public:
     Cmd_ResizeFrames(Project& proj, NodePath const& targ,
         int firstFrame, int numFrames,
-        Box const& new_area, PenColour const& fillPen);
+        Box const& new_area, PenColour const& fillPen, Job* job = nullptr);
     virtual ~Cmd_ResizeFrames();
     virtual void Do();
     virtual void Undo();
@@ -81,6 +88,24 @@ private:
 };
 
 
+// Scale up frames using one of the pixel-art upscalers.
+class Cmd_ScaleFrames : public Cmd
+{
+public:
+    Cmd_ScaleFrames(Project& proj, NodePath const& targ,
+        int firstFrame, int numFrames, ScaleMethod method, Job* job = nullptr);
+    virtual ~Cmd_ScaleFrames();
+    virtual void Do();
+    virtual void Undo();
+private:
+    void Swap();
+    NodePath mTarg;
+    std::vector<Frame*> mFrameSwap;
+    int mFirstFrame;
+    int mNumFrames;
+};
+
+
 // Add frames to a layer.
 class Cmd_InsertFrames : public Cmd
 {
@@ -115,7 +140,7 @@ private:
 class Cmd_ToSpriteSheet : public Cmd
 {
 public:
-    Cmd_ToSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid);
+    Cmd_ToSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid, Job* job = nullptr);
     virtual ~Cmd_ToSpriteSheet();
     virtual void Do();
     virtual void Undo();
@@ -129,7 +154,7 @@ private:
 class Cmd_FromSpriteSheet : public Cmd
 {
 public:
-    Cmd_FromSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid);
+    Cmd_FromSpriteSheet(Project& proj, NodePath const& targ, SpriteGrid const& grid, Job* job = nullptr);
     virtual ~Cmd_FromSpriteSheet();
     virtual void Do();
     virtual void Undo();
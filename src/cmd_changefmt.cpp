@@ -1,8 +1,11 @@
 #include "cmd_changefmt.h"
+#include "histogram.h"
 #include "img_convert.h"
 #include "project.h"
 #include "quantise.h"
 
+#include <algorithm>
+
 Cmd_ChangeFmt::Cmd_ChangeFmt(Project& proj, NodePath const& target, PixelFormat newFmt, int nColours) :
     Cmd(proj,NOT_DONE),
     m_Target(target),
@@ -21,7 +24,20 @@ Cmd_ChangeFmt::Cmd_ChangeFmt(Project& proj, NodePath const& target, PixelFormat
         // TODO: for global palette, need to take all frames into consideration!!!
         // TODO: also SPARE_FRAME!!!
         std::vector<Colour> quantised;
-        CalculatePalette(*srcLayer.mFrames[0]->mImg, quantised, nColours, &srcLayer.mPalette);
+        // Use the colour usage if it's exact, otherwise scan the image
+        // (a sampled histogram could drop colours, and an image with
+        // nColours or fewer should convert exactly). Only indexed layers
+        // get a histogram built here - they're cheap and always exact. An
+        // RGB one would stay cached on the frame, for no gain.
+        Histogram const* usage = srcLayer.CachedColourUsage(0);
+        if (!usage && FmtIsIndexed(srcLayer.Fmt())) {
+            usage = &srcLayer.ColourUsage(0);
+        }
+        if (usage && usage->Exact()) {
+            CalculatePalette(*usage, quantised, nColours, &srcLayer.mPalette);
+        } else {
+            CalculatePalette(*srcLayer.mFrames[0]->mImg, quantised, nColours, &srcLayer.mPalette);
+        }
 
         m_Other->mPalette.SetNumColours(nColours);
         for (int i=0; i<(int)quantised.size(); ++i) {
@@ -30,6 +46,10 @@ Cmd_ChangeFmt::Cmd_ChangeFmt(Project& proj, NodePath const& target, PixelFormat
     } else {
         // Keep the existing palette.
         m_Other->mPalette = srcLayer.mPalette;
+        if (FmtIsPacked(newFmt)) {
+            // ...or as much of it as fits
+            m_Other->mPalette.SetNumColours(std::min(srcLayer.mPalette.NumColours(), 1 << FmtBits(newFmt)));
+        }
     }
 
     // populate frameswap with the converted frames
@@ -78,44 +98,8 @@ void Cmd_ChangeFmt::Undo()
 Frame* Cmd_ChangeFmt::ConvertFrame(Frame const* srcFrame, PixelFormat newFmt,
     Palette const& srcPalette, Palette const& destPalette) const
 {
-    Img const& srcImg = *srcFrame->mImg;
-    Img* destImg = nullptr;
-    switch (srcImg.Fmt()) {
-    case FMT_I8:
-        if (newFmt == FMT_I8) {
-            destImg = new Img(srcImg);
-            RemapI8(*destImg, srcPalette, destPalette);
-        } else if (newFmt == FMT_RGBX8) {
-            destImg = ConvertI8toRGBX8(srcImg, srcPalette);
-        } else if (newFmt == FMT_RGBA8) {
-            destImg = ConvertI8toRGBA8(srcImg, srcPalette);
-        }
-        break;
-    case FMT_RGBX8:
-        if(newFmt == FMT_I8) {
-            destImg = ConvertRGBX8toI8(srcImg, destPalette);
-        } else if (newFmt == FMT_RGBX8) {
-            destImg = new Img(srcImg);
-            RemapRGBX8(*destImg, destPalette);
-        } else if (newFmt == FMT_RGBA8) {
-            destImg = ConvertRGBX8toRGBA8(srcImg);
-        }
-        break;
-    case FMT_RGBA8:
-        if(newFmt == FMT_I8) {
-            destImg = ConvertRGBA8toI8(srcImg, destPalette);
-        } else if (newFmt == FMT_RGBX8) {
-            destImg = ConvertRGBA8toRGBX8(srcImg);
-        } else if (newFmt == FMT_RGBA8) {
-            destImg = new Img(srcImg);
-            RemapRGBA8(*destImg, destPalette);
-        }
-        break;
-    }
-    assert(destImg);
-
     Frame* destFrame = new Frame();
     destFrame->mDuration = srcFrame->mDuration;
-    destFrame->mImg = destImg;
+    destFrame->mImg = ConvertImg(*srcFrame->mImg, newFmt, srcPalette, destPalette);
     return destFrame;
 }
@@ -0,0 +1,172 @@
+#include "cmd_optimisepalette.h"
+#include "histogram.h"
+#include "img_convert.h"
+#include "jobs.h"
+#include "project.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+
+// Work out the optimised palette, and the lut to map old indices to it.
+// Returns the number of entries freed.
+static int buildOptimised(Palette const& pal, std::vector<bool> const& used,
+    Cmd_OptimisePalette::SortOrder sort, Palette& out, I8* lut)
+{
+    const int n = std::min(pal.NColours, 256);
+
+    // merge duplicates into the first used entry with that colour.
+    std::vector<int> canon(256, 0);
+    std::map<Colour, int> firsts;
+    for (int i = 0; i < n; ++i) {
+        if (!used[i]) {
+            continue;
+        }
+        auto it = firsts.find(pal.Colours[i]);
+        if (it == firsts.end()) {
+            firsts[pal.Colours[i]] = i;
+            canon[i] = i;
+        } else {
+            canon[i] = it->second;
+        }
+    }
+
+    // the survivors, in their new order (index 0 stays put)
+    std::vector<int> keep;
+    for (int i = 1; i < n; ++i) {
+        if (used[i] && canon[i] == i) {
+            keep.push_back(i);
+        }
+    }
+    if (sort == Cmd_OptimisePalette::SORT_HUE) {
+        // greys first (darkest to lightest), then by hue
+        auto key = [&](int i) {
+            float h, s, v;
+            RGBf rgb(pal.Colours[i]);
+            RGBToHSV(rgb.r, rgb.g, rgb.b, h, s, v);
+            return std::make_tuple(s > 0.0f, s > 0.0f ? h : 0.0f, v);
+        };
+        std::stable_sort(keep.begin(), keep.end(), [&](int a, int b) {
+            return key(a) < key(b);
+        });
+    } else if (sort == Cmd_OptimisePalette::SORT_LUMA) {
+        auto luma = [&](int i) {
+            Colour const& c = pal.Colours[i];
+            return 299 * c.r + 587 * c.g + 114 * c.b;
+        };
+        std::stable_sort(keep.begin(), keep.end(), [&](int a, int b) {
+            return luma(a) < luma(b);
+        });
+    }
+    keep.insert(keep.begin(), 0);
+
+    // build the new palette (freed entries at the end are set to black)
+    out = Palette(pal.NColours);
+    std::vector<int> newPos(256, 0);
+    for (int j = 0; j < (int)keep.size(); ++j) {
+        newPos[keep[j]] = j;
+        out.Colours[j] = pal.Colours[keep[j]];
+    }
+    for (int j = (int)keep.size(); j < out.NColours; ++j) {
+        out.Colours[j] = Colour(0, 0, 0);
+    }
+
+    // unused entries aren't referenced, so can go anywhere.
+    for (int i = 0; i < 256; ++i) {
+        lut[i] = (I8)((i < n && used[i]) ? newPos[canon[i]] : 0);
+    }
+    return n - (int)keep.size();
+}
+
+
+Cmd_OptimisePalette::Cmd_OptimisePalette(Project& proj, NodePath const& target, SortOrder sort, Job* job) :
+    Cmd(proj, NOT_DONE),
+    m_Target(target),
+    m_Ranges(proj.Ranges(target, 0)),
+    m_NumFreed(0)
+{
+    Layer& l = proj.ResolveLayer(m_Target);
+    assert(l.Fmt() == FMT_I8);
+
+    // which entries are in use?
+    std::vector<int> counts;
+    l.IndexUsage(counts);
+    std::vector<bool> used(256, false);
+    for (int i = 0; i < 256; ++i) {
+        used[i] = counts[i] > 0;
+    }
+    if (l.mSpare) {
+        Histogram const& spare = l.ColourUsage(SPARE_FRAME);
+        for (int i = 0; i < 256; ++i) {
+            used[i] = used[i] || spare.IndexCount(i) > 0;
+        }
+    }
+    std::vector<Box> ranges;
+    l.mRanges.FindRanges(ranges);
+    for (auto const& r : ranges) {
+        std::vector<PenColour> pens;
+        l.mRanges.FetchPens(r, pens);
+        for (auto const& pen : pens) {
+            if (pen.IdxValid() && pen.idx() < 256) {
+                used[pen.idx()] = true;
+            }
+        }
+    }
+    used[0] = true;
+
+    I8 lut[256];
+    m_NumFreed = buildOptimised(l.mPalette, used, sort, m_Palette, lut);
+    m_Ranges.RemapIndices(lut, m_Palette);
+
+    // remap all the frames through the lut.
+    int numFrames = (int)l.mFrames.size();
+    m_Imgs.resize(numFrames + (l.mSpare ? 1 : 0), nullptr);
+    m_Usage.resize(m_Imgs.size(), nullptr);
+    JobPool::Shared().ParallelFor((int)m_Imgs.size(), [&](int i) {
+        Frame const* f = (i < numFrames) ? l.mFrames[i] : l.mSpare;
+        Img* img = new Img(*f->mImg);
+        ApplyIndexLUT(*img, lut);
+        m_Imgs[i] = img;
+    }, job);
+}
+
+Cmd_OptimisePalette::~Cmd_OptimisePalette()
+{
+    for (auto img : m_Imgs) {
+        delete img;
+    }
+    for (auto h : m_Usage) {
+        delete h;
+    }
+}
+
+void Cmd_OptimisePalette::Swap()
+{
+    Layer& l = Proj().ResolveLayer(m_Target);
+    int numFrames = (int)l.mFrames.size();
+    assert((int)m_Imgs.size() == numFrames + (l.mSpare ? 1 : 0));
+    for (int i = 0; i < (int)m_Imgs.size(); ++i) {
+        Frame* f = (i < numFrames) ? l.mFrames[i] : l.mSpare;
+        std::swap(f->mImg, m_Imgs[i]);
+        std::swap(f->mUsage, m_Usage[i]);
+    }
+    std::swap(l.mPalette, m_Palette);
+    std::swap(l.mRanges, m_Ranges);
+
+    Proj().NotifyPaletteReplaced(m_Target, 0);
+    Proj().NotifyRangesBlatted(m_Target, 0);
+    Proj().NotifyFramesBlatted(m_Target, 0, numFrames);
+}
+
+void Cmd_OptimisePalette::Do()
+{
+    Swap();
+    SetState(DONE);
+}
+
+void Cmd_OptimisePalette::Undo()
+{
+    Swap();
+    SetState(NOT_DONE);
+}
@@ -0,0 +1,42 @@
+#ifndef CMD_OPTIMISEPALETTE_H
+#define CMD_OPTIMISEPALETTE_H
+
+#include "cmd.h"
+
+#include <vector>
+
+class Histogram;
+class Job;
+
+// Tidy up the palette of an indexed layer: duplicate entries are merged,
+// unused ones dropped, and the survivors packed at the start of the
+// palette (optionally sorted). Every frame (including the spare), and the
+// ranges, are rewritten to match.
+//
+// An entry counts as used if any pixel uses it, or it's in a range.
+// Index 0 is always kept in place, as it's usually the background.
+class Cmd_OptimisePalette : public Cmd
+{
+public:
+    enum SortOrder { SORT_NONE, SORT_HUE, SORT_LUMA };
+
+    Cmd_OptimisePalette(Project& proj, NodePath const& target, SortOrder sort, Job* job = nullptr);
+    virtual ~Cmd_OptimisePalette();
+    virtual void Do();
+    virtual void Undo();
+
+    // How many palette entries were freed up.
+    int NumFreed() const { return m_NumFreed; }
+
+private:
+    void Swap();
+    NodePath m_Target;
+    Palette m_Palette;
+    RangeGrid m_Ranges;
+    // frame images (spare frame last, if any), and their cached usage.
+    std::vector<Img*> m_Imgs;
+    std::vector<Histogram*> m_Usage;
+    int m_NumFreed;
+};
+
+#endif // CMD_OPTIMISEPALETTE_H
@@ -1,9 +1,12 @@
 #include "cmd_remap.h"
 #include "img_convert.h"
+#include "jobs.h"
 #include "project.h"
 //#include "quantise.h"
 
-Cmd_Remap::Cmd_Remap(Project& proj, NodePath const& target, PixelFormat newFmt, Palette const& destPalette) :
+#include <algorithm>
+
+Cmd_Remap::Cmd_Remap(Project& proj, NodePath const& target, PixelFormat newFmt, Palette const& destPalette, Job* job) :
     Cmd(proj,NOT_DONE),
     m_Target(target),
     m_Other(nullptr)
@@ -15,20 +18,28 @@ Cmd_Remap::Cmd_Remap(Project& proj, NodePath const& target, PixelFormat newFmt,
     m_Other->mFPS = srcLayer.mFPS;
     // TODO: handle palette policies.
     m_Other->mPalette = destPalette;
+    if (FmtIsPacked(newFmt)) {
+        // a packed layer can only hold the colours which fit
+        m_Other->mPalette.SetNumColours(std::min(destPalette.NumColours(), 1 << FmtBits(newFmt)));
+    }
     m_Other->mRanges = srcLayer.mRanges;
     m_Other->mRanges.Remap(m_Other->mPalette);
 
     // populate frameswap with the converted frames
     // TODO: handle palette policies.
     Palette const& srcPalette = srcLayer.mPalette;
-    for (auto srcFrame : srcLayer.mFrames) {
-        Frame* destFrame = ConvertFrame(srcFrame, newFmt, srcPalette, destPalette);
-        m_Other->mFrames.push_back(destFrame);
-    }
-    // May also have SPARE_FRAME.
-    if (srcLayer.mSpare) {
-        m_Other->mSpare = ConvertFrame(srcLayer.mSpare, newFmt, srcPalette, destPalette);
-    }
+    Palette const& newPalette = m_Other->mPalette;
+    std::vector<Frame*>& destFrames = m_Other->mFrames;
+    destFrames.resize(srcLayer.mFrames.size(), nullptr);
+    // May also have SPARE_FRAME (done as the last task).
+    int numTasks = (int)destFrames.size() + (srcLayer.mSpare ? 1 : 0);
+    JobPool::Shared().ParallelFor(numTasks, [&](int i) {
+        if (i < (int)destFrames.size()) {
+            destFrames[i] = ConvertFrame(srcLayer.mFrames[i], newFmt, srcPalette, newPalette);
+        } else {
+            m_Other->mSpare = ConvertFrame(srcLayer.mSpare, newFmt, srcPalette, newPalette);
+        }
+    }, job);
 }
 
 
@@ -64,44 +75,8 @@ void Cmd_Remap::Undo()
 Frame* Cmd_Remap::ConvertFrame(Frame const* srcFrame, PixelFormat newFmt,
     Palette const& srcPalette, Palette const& destPalette) const
 {
-    Img const& srcImg = *srcFrame->mImg;
-    Img* destImg = nullptr;
-    switch (srcImg.Fmt()) {
-    case FMT_I8:
-        if (newFmt == FMT_I8) {
-            destImg = new Img(srcImg);
-            RemapI8(*destImg, srcPalette, destPalette);
-        } else if (newFmt == FMT_RGBX8) {
-            destImg = ConvertI8toRGBX8(srcImg, srcPalette);
-        } else if (newFmt == FMT_RGBA8) {
-            destImg = ConvertI8toRGBA8(srcImg, srcPalette);
-        }
-        break;
-    case FMT_RGBX8:
-        if(newFmt == FMT_I8) {
-            destImg = ConvertRGBX8toI8(srcImg, destPalette);
-        } else if (newFmt == FMT_RGBX8) {
-            destImg = new Img(srcImg);
-            RemapRGBX8(*destImg, destPalette);
-        } else if (newFmt == FMT_RGBA8) {
-            destImg = ConvertRGBX8toRGBA8(srcImg);
-        }
-        break;
-    case FMT_RGBA8:
-        if(newFmt == FMT_I8) {
-            destImg = ConvertRGBA8toI8(srcImg, destPalette);
-        } else if (newFmt == FMT_RGBX8) {
-            destImg = ConvertRGBA8toRGBX8(srcImg);
-        } else if (newFmt == FMT_RGBA8) {
-            destImg = new Img(srcImg);
-            RemapRGBA8(*destImg, destPalette);
-        }
-        break;
-    }
-    assert(destImg);
-
     Frame* destFrame = new Frame();
     destFrame->mDuration = srcFrame->mDuration;
-    destFrame->mImg = destImg;
+    destFrame->mImg = ConvertImg(*srcFrame->mImg, newFmt, srcPalette, destPalette);
     return destFrame;
 }
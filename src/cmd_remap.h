@@ -3,13 +3,14 @@
 
 #include "cmd.h"
 
+class Job;
 class Layer;
 
 // Change format of a layer, using the given palette.
 class Cmd_Remap : public Cmd
 {
 public:
-    Cmd_Remap(Project& proj, NodePath const& target, PixelFormat newFmt, Palette const& destPalette);
+    Cmd_Remap(Project& proj, NodePath const& target, PixelFormat newFmt, Palette const& destPalette, Job* job = nullptr);
     virtual ~Cmd_Remap();
     virtual void Do();
     virtual void Undo();
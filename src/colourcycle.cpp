@@ -0,0 +1,98 @@
+#include "colourcycle.h"
+#include "ranges.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+float CycleRates::Get(Box const& range) const
+{
+    for (auto const& r : ranges) {
+        if (r.first == range) {
+            return r.second;
+        }
+    }
+    return defaultRate;
+}
+
+void CycleRates::Set(Box const& range, float rate)
+{
+    for (auto& r : ranges) {
+        if (r.first == range) {
+            r.second = rate;
+            return;
+        }
+    }
+    ranges.push_back(std::make_pair(range, rate));
+}
+
+
+ColourCycler::ColourCycler() :
+    m_Shown(false)
+{
+}
+
+void ColourCycler::Update(Palette const& pal, RangeGrid const& ranges,
+    CycleRates const& rates, double t, IndexOccupancy::Mask& changed)
+{
+    if (m_Shown) {
+        m_Prev = m_Display;
+    } else {
+        m_Prev = pal;
+    }
+    m_Display = pal;
+
+    // (ranges are cheap to find, and this way edits to them show up
+    // straight away)
+    std::vector<Box> found;
+    ranges.FindRanges(found);
+    std::vector<PenColour> pens;
+    std::vector<int> indices;
+    for (auto const& range : found) {
+        ranges.FetchPens(range, pens);
+        indices.clear();
+        for (auto const& pen : pens) {
+            if (pen.IdxValid() && pen.idx() < pal.NumColours()) {
+                indices.push_back(pen.idx());
+            }
+        }
+        const int n = (int)indices.size();
+        if (n < 2) {
+            continue;
+        }
+        long step = (long)std::floor(t * rates.Get(range));
+        int shift = (int)(((step % n) + n) % n);
+        if (shift == 0) {
+            continue;
+        }
+        for (int j = 0; j < n; ++j) {
+            int from = (j - shift + n) % n;
+            m_Display.SetColour(indices[j], pal.GetColour(indices[from]));
+        }
+    }
+
+    Diff(m_Prev, changed);
+    m_Shown = true;
+}
+
+void ColourCycler::Stop(Palette const& pal, IndexOccupancy::Mask& changed)
+{
+    if (!m_Shown) {
+        return;
+    }
+    m_Prev = m_Display;
+    m_Display = pal;
+    Diff(m_Prev, changed);
+    m_Shown = false;
+}
+
+// Mark the entries of m_Display which differ from prev.
+void ColourCycler::Diff(Palette const& prev, IndexOccupancy::Mask& changed) const
+{
+    const int n = std::max(prev.NumColours(), m_Display.NumColours());
+    for (int i = 0; i < n && i < 256; ++i) {
+        if (prev.GetColour(i) != m_Display.GetColour(i)) {
+            changed.Set(i);
+        }
+    }
+}
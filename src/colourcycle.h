@@ -0,0 +1,62 @@
+#ifndef COLOURCYCLE_H
+#define COLOURCYCLE_H
+
+#include "box.h"
+#include "occupancy.h"
+#include "palette.h"
+
+#include <utility>
+#include <vector>
+
+class RangeGrid;
+
+// Colour cycling speeds, in steps per second (negative cycles backwards).
+// Ranges without their own rate use defaultRate.
+struct CycleRates
+{
+    float defaultRate {8.0f};
+    std::vector<std::pair<Box, float>> ranges;
+
+    float Get(Box const& range) const;
+    void Set(Box const& range, float rate);
+};
+
+
+// ColourCycler works out the palette to show for Amiga-style colour
+// cycling, where the colours of each range are rotated along it over
+// time.
+//
+// It never touches the image (or the layer palette) - it just produces a
+// display palette, and says which entries have changed since the last
+// update, so only the pixels using those need to be redrawn.
+class ColourCycler
+{
+public:
+    ColourCycler();
+
+    // Work out the display palette at time t (seconds since cycling
+    // started), from the layer palette and ranges.
+    // Entries which differ from the previous Update() (or from pal, after
+    // Reset()) are set in changed.
+    void Update(Palette const& pal, RangeGrid const& ranges,
+        CycleRates const& rates, double t, IndexOccupancy::Mask& changed);
+
+    // Back to the layer palette. Entries which were being shown cycled
+    // are set in changed.
+    void Stop(Palette const& pal, IndexOccupancy::Mask& changed);
+
+    // Forget the previous display palette (eg when it's no longer being
+    // shown).
+    void Reset() { m_Shown = false; }
+
+    Palette const& Display() const { return m_Display; }
+
+private:
+    void Diff(Palette const& prev, IndexOccupancy::Mask& changed) const;
+
+    Palette m_Display;
+    Palette m_Prev;
+    bool m_Shown;   // is m_Display what's on screen?
+};
+
+#endif // COLOURCYCLE_H
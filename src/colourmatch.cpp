@@ -0,0 +1,192 @@
+#include "colourmatch.h"
+#include "palette.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+
+// sRGB (0..255) to linear light (0..1)
+static float srgbToLinear(int v)
+{
+    struct Table {
+        float v[256];
+        Table() {
+            for (int i = 0; i < 256; ++i) {
+                float c = (float)i / 255.0f;
+                v[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            }
+        }
+    };
+    static const Table table;
+    return table.v[v];
+}
+
+// First half of the OKLab conversion: linear RGB to (cube-rooted) LMS.
+// Each output increases with each of r,g,b.
+static void linearToLMS(float r, float g, float b, float lms[3])
+{
+    lms[0] = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    lms[1] = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    lms[2] = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+}
+
+// Second half: LMS to Lab (a linear transform).
+static const float LMS_TO_LAB[3][3] = {
+    {0.2104542553f, 0.7936177850f, -0.0040720468f},
+    {1.9779984951f, -2.4285922050f, 0.4505937099f},
+    {0.0259040371f, 0.7827717662f, -0.8086757660f},
+};
+
+
+ColourMatcher::ColourMatcher(Palette const& pal, ColourMetric metric) :
+    m_Metric(metric),
+    m_Cells(1 << (3 * CELL_BITS), -1),
+    m_Last(0, 0, 0, 0),
+    m_LastIdx(-1)
+{
+    assert(pal.NColours > 0);
+    for (int i = 0; i < pal.NColours; ++i) {
+        m_Entries.push_back(ToPt(pal.Colours[i]));
+        m_All.push_back((uint16_t)i);
+    }
+}
+
+ColourMatcher::Pt ColourMatcher::ToPt(Colour const& c) const
+{
+    Pt p;
+    if (m_Metric == METRIC_RGB) {
+        p.x = (float)c.r;
+        p.y = (float)c.g;
+        p.z = (float)c.b;
+        p.alpha = (float)c.a;
+    } else {
+        float lms[3];
+        linearToLMS(srgbToLinear(c.r), srgbToLinear(c.g), srgbToLinear(c.b), lms);
+        p.x = LMS_TO_LAB[0][0] * lms[0] + LMS_TO_LAB[0][1] * lms[1] + LMS_TO_LAB[0][2] * lms[2];
+        p.y = LMS_TO_LAB[1][0] * lms[0] + LMS_TO_LAB[1][1] * lms[1] + LMS_TO_LAB[1][2] * lms[2];
+        p.z = LMS_TO_LAB[2][0] * lms[0] + LMS_TO_LAB[2][1] * lms[1] + LMS_TO_LAB[2][2] * lms[2];
+        p.alpha = (float)c.a / 255.0f;
+    }
+    return p;
+}
+
+// Find the closest of the candidates. Ties go to the lowest index, as
+// with Palette::Closest() (cands are in ascending order).
+int ColourMatcher::Search(Pt const& p, uint16_t const* cands, int n) const
+{
+    int best = -1;
+    float bestDist = std::numeric_limits<float>::max();
+    for (int i = 0; i < n; ++i) {
+        Pt const& e = m_Entries[cands[i]];
+        float dx = e.x - p.x;
+        float dy = e.y - p.y;
+        float dz = e.z - p.z;
+        float da = e.alpha - p.alpha;
+        float dist = dx * dx + dy * dy + dz * dz + da * da;
+        if (dist < bestDist) {
+            best = cands[i];
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+int ColourMatcher::Closest(Colour const& c)
+{
+    if (c == m_Last && m_LastIdx >= 0) {
+        return m_LastIdx;
+    }
+
+    int best;
+    if (c.a == 255) {
+        int cell = ((c.r >> CELL_SHIFT) << (2 * CELL_BITS)) |
+            ((c.g >> CELL_SHIFT) << CELL_BITS) |
+            (c.b >> CELL_SHIFT);
+        int off = m_Cells[cell];
+        if (off < 0) {
+            off = BuildCell(cell);
+        }
+        int n = m_Cands[off];
+        if (n == 1) {
+            best = m_Cands[off + 1];
+        } else {
+            best = Search(ToPt(c), &m_Cands[off + 1], n);
+        }
+    } else {
+        best = Search(ToPt(c), m_All.data(), (int)m_All.size());
+    }
+
+    m_Last = c;
+    m_LastIdx = best;
+    return best;
+}
+
+// Work out which entries could be closest to some (opaque) colour in the
+// cell, and add them to m_Cands.
+// Returns the offset of the new candidate list.
+int ColourMatcher::BuildCell(int cell)
+{
+    const int mask = (1 << CELL_BITS) - 1;
+    const int size = 1 << CELL_SHIFT;
+    Colour lo(((cell >> (2 * CELL_BITS)) & mask) << CELL_SHIFT,
+        ((cell >> CELL_BITS) & mask) << CELL_SHIFT,
+        (cell & mask) << CELL_SHIFT);
+    Colour hi(lo.r + size - 1, lo.g + size - 1, lo.b + size - 1);
+
+    // bounding box of the cell in metric space
+    float bmin[3], bmax[3];
+    if (m_Metric == METRIC_RGB) {
+        bmin[0] = lo.r; bmin[1] = lo.g; bmin[2] = lo.b;
+        bmax[0] = hi.r; bmax[1] = hi.g; bmax[2] = hi.b;
+    } else {
+        // LMS is monotonic in r,g,b, so the corners bound it...
+        float lmsLo[3], lmsHi[3];
+        linearToLMS(srgbToLinear(lo.r), srgbToLinear(lo.g), srgbToLinear(lo.b), lmsLo);
+        linearToLMS(srgbToLinear(hi.r), srgbToLinear(hi.g), srgbToLinear(hi.b), lmsHi);
+        // ...and Lab is linear in LMS, so bound each axis separately.
+        for (int j = 0; j < 3; ++j) {
+            bmin[j] = bmax[j] = 0.0f;
+            for (int k = 0; k < 3; ++k) {
+                float m = LMS_TO_LAB[j][k];
+                bmin[j] += m * ((m >= 0.0f) ? lmsLo[k] : lmsHi[k]);
+                bmax[j] += m * ((m >= 0.0f) ? lmsHi[k] : lmsLo[k]);
+            }
+        }
+    }
+    const float alpha = (m_Metric == METRIC_RGB) ? 255.0f : 1.0f;
+
+    // nearest and furthest distance from each entry to the box
+    const int n = (int)m_Entries.size();
+    std::vector<float> dmin(n);
+    float threshold = std::numeric_limits<float>::max();
+    for (int i = 0; i < n; ++i) {
+        Pt const& e = m_Entries[i];
+        float p[3] = {e.x, e.y, e.z};
+        float da = e.alpha - alpha;
+        float near = da * da;
+        float far = da * da;
+        for (int j = 0; j < 3; ++j) {
+            float d = std::max({bmin[j] - p[j], 0.0f, p[j] - bmax[j]});
+            near += d * d;
+            float f = std::max(fabsf(p[j] - bmin[j]), fabsf(p[j] - bmax[j]));
+            far += f * f;
+        }
+        dmin[i] = near;
+        threshold = std::min(threshold, far);
+    }
+    // (a little slack, so rounding never rules out the real winner)
+    threshold = threshold * 1.0001f + 1e-6f;
+
+    int off = (int)m_Cands.size();
+    m_Cands.push_back(0);
+    for (int i = 0; i < n; ++i) {
+        if (dmin[i] <= threshold) {
+            m_Cands.push_back((uint16_t)i);
+            ++m_Cands[off];
+        }
+    }
+    m_Cells[cell] = off;
+    return off;
+}
@@ -0,0 +1,66 @@
+#ifndef COLOURMATCH_H
+#define COLOURMATCH_H
+
+#include "colours.h"
+
+#include <cstdint>
+#include <vector>
+
+struct Palette;
+
+// How to measure the distance between two colours.
+enum ColourMetric {
+    METRIC_RGB,     // plain euclidean RGBA, same as Palette::Closest()
+    METRIC_OKLAB,   // perceptual (OKLab, plus alpha)
+};
+
+
+// ColourMatcher finds the closest palette entry for lots of colours, eg
+// when converting a whole image to indexed.
+//
+// RGB space is split into 32x32x32 cells. The first time a colour in a
+// cell is looked up, the palette entries which could possibly be the
+// closest to any colour in that cell are worked out and cached. Later
+// lookups only need to check those (usually just one or two), so the
+// answer is exact, but much faster than searching the whole palette.
+//
+// Only opaque colours go through the cell cache. Others are matched by
+// searching the whole palette.
+//
+// Not threadsafe - use one per thread.
+class ColourMatcher
+{
+public:
+    ColourMatcher(Palette const& pal, ColourMetric metric = METRIC_OKLAB);
+
+    // Return the index of the closest palette entry to c.
+    int Closest(Colour const& c);
+
+private:
+    ColourMatcher(ColourMatcher const&);    // disallowed
+
+    enum { CELL_BITS = 5, CELL_SHIFT = 8 - CELL_BITS };
+
+    // a point in metric space (alpha is scaled to suit the metric)
+    struct Pt { float x, y, z, alpha; };
+
+    Pt ToPt(Colour const& c) const;
+    int Search(Pt const& p, uint16_t const* cands, int n) const;
+    int BuildCell(int cell);
+
+    ColourMetric m_Metric;
+    std::vector<Pt> m_Entries;
+    // per cell: offset of its candidate list in m_Cands, or -1 if not
+    // worked out yet.
+    std::vector<int32_t> m_Cells;
+    // candidate lists (count, followed by the palette indices)
+    std::vector<uint16_t> m_Cands;
+    // every entry (for non-opaque colours)
+    std::vector<uint16_t> m_All;
+
+    // the last lookup (images tend to have runs of the same colour)
+    Colour m_Last;
+    int m_LastIdx;
+};
+
+#endif // COLOURMATCH_H
@@ -10,8 +10,41 @@ enum PixelFormat {
     FMT_I8=0,
     FMT_RGBX8,  // rgb only, alpha ignored
     FMT_RGBA8,
+    // Packed indexed formats, with several pixels to a byte (leftmost
+    // pixel in the most significant bits, as on most retro hardware).
+    FMT_I4,     // 16 colours
+    FMT_I2,     // 4 colours
+    FMT_I1,     // 2 colours
+    // As FMT_RGBA8, but with rgb premultiplied by alpha. Compositing and
+    // filtering don't need any divides (but it can't hold quite as many
+    // distinct colours at low alpha).
+    FMT_RGBA8PM,
 };
 
+// Number of bits used for each pixel.
+inline int FmtBits(PixelFormat fmt) {
+    switch (fmt) {
+        case FMT_I8: return 8;
+        case FMT_RGBX8: return 32;
+        case FMT_RGBA8: return 32;
+        case FMT_I4: return 4;
+        case FMT_I2: return 2;
+        case FMT_I1: return 1;
+        case FMT_RGBA8PM: return 32;
+    }
+    return 0;
+}
+
+// Is fmt one of the packed (sub-byte) indexed formats?
+inline bool FmtIsPacked(PixelFormat fmt) {
+    return fmt == FMT_I4 || fmt == FMT_I2 || fmt == FMT_I1;
+}
+
+// Is fmt indexed (I8 or packed)?
+inline bool FmtIsIndexed(PixelFormat fmt) {
+    return fmt == FMT_I8 || FmtIsPacked(fmt);
+}
+
 enum PenID {
     PEN_FG=0,
     PEN_BG=1,
@@ -53,26 +86,90 @@ inline bool operator==(const RGBA8& a, const RGBA8& b){ return a.r==b.r && a.g==
 inline bool operator!=(const RGBA8& a, const RGBA8& b){return !operator==(a,b);}
 
 
+// x/255, rounded to nearest, without a divide.
+// Exact for x in [0, 65662], which covers any weighted sum of 8-bit
+// channels whose weights add up to 255.
+inline unsigned Div255(unsigned x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// src over an opaque dest.
 inline RGBX8 Blend(RGBA8 src, RGBX8 dest)
 {
-    uint8_t t = src.a;
-    uint8_t inv = 255-src.a;
+    unsigned t = src.a;
+    unsigned inv = 255-src.a;
     return RGBX8(
-        (dest.r*inv + src.r*t)/255,
-        (dest.g*inv + src.g*t)/255,
-        (dest.b*inv + src.b*t)/255 );
+        Div255(dest.r*inv + src.r*t),
+        Div255(dest.g*inv + src.g*t),
+        Div255(dest.b*inv + src.b*t) );
 }
 
+// src over dest, with dest alpha taken into account (straight, not
+// premultiplied, alpha). The span versions in blend.h give identical
+// results.
 inline RGBA8 Blend(RGBA8 src, RGBA8 dest)
 {
-    uint8_t t = src.a;
-    uint8_t inv = 255-src.a;
+    if (src.a == 0) {
+        return dest;
+    }
+    if (src.a == 255 || dest.a == 0) {
+        return src;
+    }
+    // weights, scaled by 255*255
+    unsigned ws = src.a*255;
+    unsigned wd = dest.a*(255-src.a);
+    unsigned sum = ws + wd;
     return RGBA8(
-        (dest.r*inv + src.r*t)/255,
-        (dest.g*inv + src.g*t)/255,
-        (dest.b*inv + src.b*t)/255,
-        (dest.a*inv + src.a*t)/255 );
+        (src.r*ws + dest.r*wd + sum/2) / sum,
+        (src.g*ws + dest.g*wd + sum/2) / sum,
+        (src.b*ws + dest.b*wd + sum/2) / sum,
+        Div255(sum) );
+}
+
+// Convert between straight and premultiplied alpha.
+// Premultiplying is lossy at low alpha, so unpremultiplying is left for
+// the boundaries (saving, picking colours etc).
+inline RGBA8 Premultiply(RGBA8 c)
+{
+    return RGBA8(Div255(c.r*c.a), Div255(c.g*c.a), Div255(c.b*c.a), c.a);
 }
+
+inline RGBA8 Unpremultiply(RGBA8 c)
+{
+    if (c.a == 0) {
+        return RGBA8(0, 0, 0, 0);
+    }
+    unsigned half = c.a/2;
+    return RGBA8(
+        (c.r*255 + half) / c.a,
+        (c.g*255 + half) / c.a,
+        (c.b*255 + half) / c.a,
+        c.a );
+}
+
+// premultiplied src over opaque dest.
+inline RGBX8 BlendPM(RGBA8 src, RGBX8 dest)
+{
+    unsigned inv = 255-src.a;
+    return RGBX8(
+        src.r + Div255(dest.r*inv),
+        src.g + Div255(dest.g*inv),
+        src.b + Div255(dest.b*inv) );
+}
+
+// src over dest, both premultiplied. Just a multiply-add per channel.
+inline RGBA8 BlendPM(RGBA8 src, RGBA8 dest)
+{
+    unsigned inv = 255-src.a;
+    return RGBA8(
+        src.r + Div255(dest.r*inv),
+        src.g + Div255(dest.g*inv),
+        src.b + Div255(dest.b*inv),
+        src.a + Div255(dest.a*inv) );
+}
+
 /*
 inline RGBX8 Lerp(RGBX8 a, RGBX8 b, uint8_t t) {
     uint8_t inv = 255-t;
@@ -186,6 +283,7 @@ public:
     Colour rgb() const {return m_rgb; }
     RGBX8 toRGBX8() const {return m_rgb; }
     RGBA8 toRGBA8() const {return m_rgb; }
+    RGBA8 toRGBA8PM() const {return Premultiply(m_rgb); }
     int idx() const {assert(IdxValid()); return m_idx;}
 
     bool IdxValid() const {return m_idx >= 0;}
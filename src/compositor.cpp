@@ -0,0 +1,606 @@
+#include "compositor.h"
+#include "blend.h"
+#include "img.h"
+#include "palette.h"
+#include "project.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+
+// Helper to divide, rounding towards -infinity.
+static int floorDiv(int a, int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// Shrink a box (in full-size coords) to cover the same area at a
+// reduced level.
+static Box shrinkBox(Box const& b, int level)
+{
+    if (level == 0 || b.Empty()) {
+        return b;
+    }
+    int x0 = b.XMin() >> level;
+    int y0 = b.YMin() >> level;
+    int x1 = b.XMax() >> level;
+    int y1 = b.YMax() >> level;
+    return Box(x0, y0, (x1 - x0) + 1, (y1 - y0) + 1);
+}
+
+static void clearImg(Img& img)
+{
+    memset(img.Ptr(0, 0), 0, img.Pitch() * img.H());
+}
+
+
+// A layer found while walking the project tree.
+struct FoundLayer {
+    NodePath path;
+    Layer const* layer;
+    Point pos;      // absolute position
+};
+
+// Walk the tree in paint order (first child is bottom-most), collecting
+// all the layers along with their absolute positions.
+static void collectLayers(BaseNode const* n, NodePath& path, Point pos, std::vector<FoundLayer>& out)
+{
+    pos += n->mOffset;
+    Layer const* l = n->ToLayerConst();
+    if (l) {
+        out.push_back({path, l, pos});
+        return;
+    }
+    for (int i = 0; i < (int)n->mChildren.size(); ++i) {
+        path.path.push_back(i);
+        collectLayers(n->mChildren[i], path, pos, out);
+        path.path.pop_back();
+    }
+}
+
+
+Compositor::Compositor(Project const& proj) :
+    m_Proj(proj),
+    m_Frame(0),
+    m_Level(0),
+    m_OnionCount(0),
+    m_OnionCache(proj),
+    m_Valid(false),
+    m_Bound(0, 0, 0, 0),
+    m_Grid(0, 0, 0, 0),
+    m_Cols(0),
+    m_Rows(0),
+    m_DisplayPalette(nullptr)
+{
+}
+
+Compositor::~Compositor()
+{
+    FreeTiles();
+    DropMips(NodePath(), 0, 0);
+}
+
+void Compositor::SetFocus(NodePath const& focus, int frame)
+{
+    m_Focus = focus;
+    m_Frame = frame;
+    Reset();
+}
+
+void Compositor::SetLevel(int level)
+{
+    assert(level >= 0);
+    m_Level = level;
+    Reset();
+}
+
+void Compositor::SetOnionSkins(int n)
+{
+    m_OnionCount = n;
+    Reset();
+}
+
+void Compositor::Reset()
+{
+    FreeTiles();
+    m_Valid = false;
+}
+
+void Compositor::FramesBlatted(NodePath const& target, int first, int count)
+{
+    if (target == m_Focus) {
+        m_OnionCache.Drop(first, count);
+    }
+    DropMips(target, first, count);
+    Reset();
+}
+
+void Compositor::FramesShuffled(NodePath const& target)
+{
+    if (target == m_Focus) {
+        // frame numbers have changed
+        m_OnionCache.Clear();
+    }
+    DropMips(target, -1, 0);
+    Reset();
+}
+
+// Discard mip pyramids (and occupancy maps) for target frames
+// [first, first+count).
+// count=0 means all frames, and an empty target means all layers.
+void Compositor::DropMips(NodePath const& target, int first, int count)
+{
+    auto dropping = [&](MipKey const& key) -> bool {
+        bool drop = target.IsEmpty() || target.path == key.first;
+        int frame = key.second;
+        if (count > 0 && (frame < first || frame >= first + count)) {
+            drop = false;
+        }
+        return drop;
+    };
+    auto it = m_Mips.begin();
+    while (it != m_Mips.end()) {
+        if (dropping(it->first)) {
+            delete it->second;
+            it = m_Mips.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    auto occ = m_Occupancy.begin();
+    while (occ != m_Occupancy.end()) {
+        if (dropping(occ->first)) {
+            delete occ->second;
+            occ = m_Occupancy.erase(occ);
+        } else {
+            ++occ;
+        }
+    }
+}
+
+// Fetch the image of a layer frame, at the current level.
+Img const& Compositor::SourceImg(NodePath const& path, int frame)
+{
+    Img const& img = m_Proj.GetImgConst(path, frame);
+    if (m_Level == 0) {
+        return img;
+    }
+    MipPyramid*& mip = m_Mips[MipKey(path.path, frame)];
+    if (!mip) {
+        mip = new MipPyramid();
+    }
+    return mip->Level(img, m_Level);
+}
+
+void Compositor::FreeTiles()
+{
+    for (auto& t : m_Tiles) {
+        delete t.under;
+        delete t.over;
+        delete t.final;
+    }
+    m_Tiles.clear();
+}
+
+// Work out which layers (and frames) are involved, and set up the tile grid.
+void Compositor::Rethink()
+{
+    FreeTiles();
+    m_Under.clear();
+    m_Over.clear();
+    m_Onions.clear();
+
+    std::vector<FoundLayer> found;
+    NodePath path;
+    collectLayers(m_Proj.mRoot, path, Point(0, 0), found);
+
+    auto it = std::find_if(found.begin(), found.end(),
+        [this](FoundLayer const& f) -> bool { return f.path == m_Focus; });
+    assert(it != found.end());
+    size_t focusIdx = it - found.begin();
+    Point focusPos = it->pos;
+
+    m_FocusSrc = {m_Focus, m_Frame, Point(0, 0)};
+    m_Bound = SourceImg(m_Focus, m_Frame).Bounds();
+
+    // onion skins (not for the spare frame, or when reduced)
+    m_OnionCache.SetLayer(m_Focus);
+    if (m_OnionCount > 0 && m_Frame != SPARE_FRAME && m_Level == 0) {
+        int nframes = it->layer->NumFrames();
+        for (int d = m_OnionCount; d >= 1; --d) {
+            int fade = (255 * (m_OnionCount + 1 - d)) / m_OnionCount;
+            for (int dir = -1; dir <= 1; dir += 2) {
+                int f = m_Frame + d * dir;
+                if (f < 0 || f >= nframes) {
+                    continue;
+                }
+                m_Onions.push_back({f, dir, fade});
+                m_Bound.Merge(it->layer->GetImgConst(f).Bounds());
+            }
+        }
+        // keep some slack, so scrubbing back and forth reuses tinted frames
+        m_OnionCache.Prune(m_Frame - 2 * m_OnionCount, m_Frame + 2 * m_OnionCount);
+    }
+
+    for (size_t i = 0; i < found.size(); ++i) {
+        FoundLayer const& f = found[i];
+        if (i == focusIdx || f.layer->NumFrames() == 0) {
+            continue;
+        }
+        // The spare frame only exists on the focus layer, so show it
+        // on its own.
+        if (m_Frame == SPARE_FRAME) {
+            continue;
+        }
+        Point pos = f.pos - focusPos;
+        Source src = {f.path, std::min(m_Frame, f.layer->NumFrames() - 1),
+            Point(pos.x >> m_Level, pos.y >> m_Level)};
+        Box b = SourceImg(src.path, src.frame).Bounds();
+        b.Translate(src.pos);
+        m_Bound.Merge(b);
+        if (i < focusIdx) {
+            m_Under.push_back(src);
+        } else {
+            m_Over.push_back(src);
+        }
+    }
+
+    // round out to whole tiles
+    const int T = TILE_SIZE;
+    int x0 = floorDiv(m_Bound.XMin(), T);
+    int y0 = floorDiv(m_Bound.YMin(), T);
+    int x1 = floorDiv(m_Bound.XMax(), T) + 1;
+    int y1 = floorDiv(m_Bound.YMax(), T) + 1;
+    m_Grid = Box(x0 * T, y0 * T, (x1 - x0) * T, (y1 - y0) * T);
+    m_Cols = x1 - x0;
+    m_Rows = y1 - y0;
+    m_Tiles.resize(m_Cols * m_Rows);
+
+    m_Valid = true;
+}
+
+Box const& Compositor::Bound()
+{
+    if (!m_Valid) {
+        Rethink();
+    }
+    return m_Bound;
+}
+
+Compositor::Source const* Compositor::FindSource(NodePath const& target) const
+{
+    for (auto const& src : m_Under) {
+        if (src.path == target) {
+            return &src;
+        }
+    }
+    for (auto const& src : m_Over) {
+        if (src.path == target) {
+            return &src;
+        }
+    }
+    return nullptr;
+}
+
+Box Compositor::Damage(NodePath const& target, int frame, Box const& dmg)
+{
+    if (!m_Valid) {
+        Rethink();
+    }
+    // keep any cached copies up to date, even if they're not shown
+    auto mip = m_Mips.find(MipKey(target.path, frame));
+    if (mip != m_Mips.end()) {
+        mip->second->Damage(dmg);
+    }
+    auto occ = m_Occupancy.find(MipKey(target.path, frame));
+    if (occ != m_Occupancy.end()) {
+        occ->second->Damage(dmg);
+    }
+    Box area = shrinkBox(dmg, m_Level);
+    if (target == m_Focus) {
+        m_OnionCache.Damage(frame, dmg);
+        if (frame != m_Frame) {
+            auto it = std::find_if(m_Onions.begin(), m_Onions.end(),
+                [frame](Onion const& o) -> bool { return o.frame == frame; });
+            if (it == m_Onions.end()) {
+                return Box(0, 0, 0, 0);
+            }
+        }
+        Invalidate(area, false, false);
+    } else {
+        Source const* src = FindSource(target);
+        if (!src || src->frame != frame) {
+            return Box(0, 0, 0, 0);
+        }
+        area.Translate(src->pos);
+        bool under = (src < m_Under.data() + m_Under.size()) && (src >= m_Under.data());
+        Invalidate(area, under, !under);
+    }
+    area.ClipAgainst(m_Bound);
+    return area;
+}
+
+Box Compositor::DamageLayer(NodePath const& target)
+{
+    if (!m_Valid) {
+        Rethink();
+    }
+    if (target == m_Focus) {
+        // onion skins too
+        m_OnionCache.Clear();
+        Invalidate(m_Bound, false, false);
+        return m_Bound;
+    }
+    Source const* src = FindSource(target);
+    if (!src) {
+        return Box(0, 0, 0, 0);
+    }
+    Box area = SourceImg(src->path, src->frame).Bounds();
+    area.Translate(src->pos);
+    bool under = (src < m_Under.data() + m_Under.size()) && (src >= m_Under.data());
+    Invalidate(area, under, !under);
+    return area;
+}
+
+void Compositor::SetDisplayPalette(NodePath const& target, Palette const* pal)
+{
+    m_DisplayTarget = target;
+    m_DisplayPalette = pal;
+}
+
+void Compositor::DamageIndex(NodePath const& target, int index, std::vector<Box>& out)
+{
+    IndexOccupancy::Mask indices;
+    indices.Set(index);
+    DamageIndices(target, indices, out);
+}
+
+void Compositor::DamageIndices(NodePath const& target, IndexOccupancy::Mask const& indices, std::vector<Box>& out)
+{
+    if (!indices.Any()) {
+        return;
+    }
+    if (!m_Valid) {
+        Rethink();
+    }
+    Source const* src;
+    bool under = false;
+    if (target == m_Focus) {
+        if (!m_Onions.empty()) {
+            // onion skins show other frames too - just redo the lot
+            out.push_back(DamageLayer(target));
+            return;
+        }
+        src = &m_FocusSrc;
+    } else {
+        src = FindSource(target);
+        if (!src) {
+            return;
+        }
+        under = (src < m_Under.data() + m_Under.size()) && (src >= m_Under.data());
+    }
+
+    // The palette only affects indexed images.
+    // (Reduced images are looked up at full size - the mips only use
+    // indices from the full-size image, so we might redraw a little more
+    // than needed, but never less).
+    Img const& img = m_Proj.GetImgConst(src->path, src->frame);
+    if (!FmtIsIndexed(img.Fmt())) {
+        return;
+    }
+    IndexOccupancy*& occ = m_Occupancy[MipKey(src->path.path, src->frame)];
+    if (!occ) {
+        occ = new IndexOccupancy();
+    }
+    std::vector<Box> found;
+    occ->Find(img, indices, found);
+    for (auto const& b : found) {
+        Box area = shrinkBox(b, m_Level);
+        area.Translate(src->pos);
+        if (src == &m_FocusSrc) {
+            Invalidate(area, false, false);
+        } else {
+            Invalidate(area, under, !under);
+        }
+        area.ClipAgainst(m_Bound);
+        if (!area.Empty()) {
+            out.push_back(area);
+        }
+    }
+}
+
+// Mark all the tiles touching area (focus coords) as dirty.
+void Compositor::Invalidate(Box const& area, bool under, bool over)
+{
+    Box b(area);
+    b.ClipAgainst(m_Grid);
+    if (b.Empty()) {
+        return;
+    }
+    const int T = TILE_SIZE;
+    int c0 = (b.XMin() - m_Grid.x) / T;
+    int c1 = (b.XMax() - m_Grid.x) / T;
+    int r0 = (b.YMin() - m_Grid.y) / T;
+    int r1 = (b.YMax() - m_Grid.y) / T;
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            Tile& t = m_Tiles[r * m_Cols + c];
+            t.underDirty |= under;
+            t.overDirty |= over;
+            t.finalDirty = true;
+        }
+    }
+}
+
+
+RGBA8 const* Compositor::Span(int x, int y, int& count)
+{
+    static const RGBA8 transparent[TILE_SIZE] = {};
+    if (!m_Valid) {
+        Rethink();
+    }
+    const int T = TILE_SIZE;
+    if (!m_Grid.Contains(Point(x, y))) {
+        count = T;
+        if (y >= m_Grid.YMin() && y <= m_Grid.YMax() && x < m_Grid.x) {
+            count = std::min(T, m_Grid.x - x);
+        }
+        return transparent;
+    }
+    int gx = x - m_Grid.x;
+    int gy = y - m_Grid.y;
+    Tile& t = Fetch(gx / T, gy / T);
+    count = T - (gx % T);
+    return t.final->PtrConst_RGBA8(gx % T, gy % T);
+}
+
+
+// Return the tile, bringing it up to date if needed.
+Compositor::Tile& Compositor::Fetch(int col, int row)
+{
+    assert(col >= 0 && col < m_Cols);
+    assert(row >= 0 && row < m_Rows);
+    Tile& t = m_Tiles[row * m_Cols + col];
+    if (!t.finalDirty) {
+        return t;
+    }
+
+    const int T = TILE_SIZE;
+    Box area(m_Grid.x + col * T, m_Grid.y + row * T, T, T);
+
+    if (!m_Under.empty() && t.underDirty) {
+        if (!t.under) {
+            t.under = new Img(FMT_RGBA8PM, T, T);
+        }
+        Flatten(m_Under, *t.under, area);
+        t.underDirty = false;
+    }
+    if (!m_Over.empty() && t.overDirty) {
+        if (!t.over) {
+            t.over = new Img(FMT_RGBA8PM, T, T);
+        }
+        Flatten(m_Over, *t.over, area);
+        t.overDirty = false;
+    }
+
+    if (!t.final) {
+        t.final = new Img(FMT_RGBA8PM, T, T);
+    }
+    Img& final = *t.final;
+    if (t.under) {
+        memcpy(final.Ptr(0, 0), t.under->PtrConst(0, 0), final.Pitch() * T);
+    } else {
+        clearImg(final);
+    }
+    Composite(m_FocusSrc, final, area);
+    for (auto const& onion : m_Onions) {
+        CompositeOnion(onion, final, area);
+    }
+    if (t.over) {
+        for (int y = 0; y < T; ++y) {
+            RGBA8 const* src = t.over->PtrConst_RGBA8(0, y);
+            BlendSpanPM(src, final.Ptr_RGBA8(0, y), T);
+        }
+    }
+    t.finalDirty = false;
+    return t;
+}
+
+// Composite a list of layers into dest, which covers area.
+void Compositor::Flatten(std::vector<Source> const& srcs, Img& dest, Box const& area)
+{
+    clearImg(dest);
+    for (auto const& src : srcs) {
+        Composite(src, dest, area);
+    }
+}
+
+// Composite a single layer onto dest, which covers area.
+void Compositor::Composite(Source const& src, Img& dest, Box const& area)
+{
+    Img const& img = SourceImg(src.path, src.frame);
+    Box b(src.pos, img.W(), img.H());
+    b.ClipAgainst(area);
+    if (b.Empty()) {
+        return;
+    }
+
+    switch (img.Fmt()) {
+    case FMT_I8:
+    case FMT_I4:
+    case FMT_I2:
+    case FMT_I1:
+        {
+            Palette const& pal = (m_DisplayPalette && src.path == m_DisplayTarget) ?
+                *m_DisplayPalette : m_Proj.PaletteConst(src.path, src.frame);
+            RGBA8 lut[256];
+            for (int i = 0; i < 256; ++i) {
+                lut[i] = Premultiply(pal.GetColour(i));
+            }
+            for (int y = b.YMin(); y <= b.YMax(); ++y) {
+                RGBA8* d = dest.Ptr_RGBA8(b.x - area.x, y - area.y);
+                if (img.Fmt() == FMT_I8) {
+                    I8 const* s = img.PtrConst_I8(b.x - src.pos.x, y - src.pos.y);
+                    for (int x = 0; x < b.w; ++x) {
+                        d[x] = BlendPM(lut[s[x]], d[x]);
+                    }
+                } else {
+                    for (int x = 0; x < b.w; ++x) {
+                        d[x] = BlendPM(lut[img.GetIndex(b.x - src.pos.x + x, y - src.pos.y)], d[x]);
+                    }
+                }
+            }
+        }
+        break;
+    case FMT_RGBX8:
+        for (int y = b.YMin(); y <= b.YMax(); ++y) {
+            RGBX8 const* s = img.PtrConst_RGBX8(b.x - src.pos.x, y - src.pos.y);
+            RGBA8* d = dest.Ptr_RGBA8(b.x - area.x, y - area.y);
+            for (int x = 0; x < b.w; ++x) {
+                d[x] = RGBA8(s[x]);
+            }
+        }
+        break;
+    case FMT_RGBA8:
+        for (int y = b.YMin(); y <= b.YMax(); ++y) {
+            RGBA8 const* s = img.PtrConst_RGBA8(b.x - src.pos.x, y - src.pos.y);
+            RGBA8* d = dest.Ptr_RGBA8(b.x - area.x, y - area.y);
+            for (int x = 0; x < b.w; ++x) {
+                d[x] = BlendPM(Premultiply(s[x]), d[x]);
+            }
+        }
+        break;
+    case FMT_RGBA8PM:
+        for (int y = b.YMin(); y <= b.YMax(); ++y) {
+            RGBA8 const* s = img.PtrConst_RGBA8(b.x - src.pos.x, y - src.pos.y);
+            BlendSpanPM(s, dest.Ptr_RGBA8(b.x - area.x, y - area.y), b.w);
+        }
+        break;
+    default:
+        assert(false);
+        break;
+    }
+}
+
+// Blend an onion skin over dest, which covers area.
+void Compositor::CompositeOnion(Onion const& onion, Img& dest, Box const& area)
+{
+    Img const& img = m_OnionCache.Fetch(onion.frame, onion.dir);
+    Box b(img.Bounds());
+    b.ClipAgainst(area);
+    if (b.Empty()) {
+        return;
+    }
+    for (int y = b.YMin(); y <= b.YMax(); ++y) {
+        RGBA8 const* s = img.PtrConst_RGBA8(b.x, y);
+        RGBA8* d = dest.Ptr_RGBA8(b.x - area.x, y - area.y);
+        for (int x = 0; x < b.w; ++x) {
+            // (premultiplied, so fading scales all four channels)
+            RGBA8 c = s[x];
+            c = RGBA8(Div255(c.r * onion.fade), Div255(c.g * onion.fade),
+                Div255(c.b * onion.fade), Div255(c.a * onion.fade));
+            d[x] = BlendPM(c, d[x]);
+        }
+    }
+}
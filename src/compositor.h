@@ -0,0 +1,172 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include "box.h"
+#include "colours.h"
+#include "layer.h"
+#include "mipmap.h"
+#include "occupancy.h"
+#include "onionskin.h"
+#include "point.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+class Img;
+class Project;
+struct Palette;
+
+// Compositor flattens the layers of a project into a grid of
+// cached premultiplied RGBA8 tiles (FMT_RGBA8PM), ready for an EditView to
+// zoom onto its canvas. Whatever the layer formats, everything is blended
+// premultiplied, so each layer costs a multiply-add per channel.
+//
+// Everything is built around a focus (layer and frame), and the composite
+// is in the coordinate space of the focused image.
+// The layers below and above the focus are flattened into their own tiles,
+// so a change to the focused layer only requires blending three tiles
+// together, no matter how many layers the project has.
+//
+// Damage marks the tiles it touches as dirty, and dirty tiles are rebuilt
+// lazily, when they are next fetched.
+//
+// Optionally, onion skins of the neighbouring frames of the focused layer
+// are blended over the focus.
+//
+// The composite can also be built at a reduced size, for zooming out.
+// At level n, each composite pixel covers 2^n x 2^n focus pixels, and all
+// coordinates in and out (except for damage) are in that reduced space.
+// The reduced images come from mip pyramids kept for each layer frame.
+class Compositor
+{
+public:
+    enum { TILE_SIZE = 64 };
+
+    Compositor(Project const& proj);
+    ~Compositor();
+
+    // Set the layer & frame the composite is built around.
+    // Throws away all the cached tiles.
+    void SetFocus(NodePath const& focus, int frame);
+
+    // Set the reduction level (0=full size, 1=half size etc).
+    void SetLevel(int level);
+    int Level() const { return m_Level; }
+
+    // Show n onion-skinned frames either side of the focus frame (0=off).
+    // (not shown when reduced).
+    void SetOnionSkins(int n);
+    int NumOnionSkins() const { return m_OnionCount; }
+
+    // Throw away all the cached tiles, and rethink the layers involved.
+    void Reset();
+
+    // Frames of a layer have been replaced.
+    void FramesBlatted(NodePath const& target, int first, int count);
+    // Frames have been added to or removed from a layer.
+    void FramesShuffled(NodePath const& target);
+
+    // Mark an area of a layer/frame as needing to be recomposited.
+    // dmg is in layer coords, at full size.
+    // Returns the affected area in composite coords (empty if the change
+    // doesn't show up in this composite).
+    Box Damage(NodePath const& target, int frame, Box const& dmg);
+
+    // Mark all of a layer as needing to be recomposited, whatever frame is
+    // shown (eg when its palette is changed).
+    // Returns the affected area in composite coords.
+    Box DamageLayer(NodePath const& target);
+
+    // A single palette entry of a layer has changed.
+    // Only the tiles which use that index are marked as needing to be
+    // recomposited. Their areas (in composite coords) are added to out.
+    void DamageIndex(NodePath const& target, int index, std::vector<Box>& out);
+    // As DamageIndex(), for a set of palette entries.
+    void DamageIndices(NodePath const& target, IndexOccupancy::Mask const& indices, std::vector<Box>& out);
+
+    // Show target using pal instead of its own palette (eg for colour
+    // cycling), or pass null to go back to normal. pal must stay valid
+    // until replaced. Nothing is redrawn - use DamageIndices() for the
+    // entries which differ.
+    void SetDisplayPalette(NodePath const& target, Palette const* pal);
+
+    // Fetch composited pixels at (x,y) (in composite coords).
+    // Returns a pointer to the pixel and sets count to the number of
+    // contiguous pixels which can be read from it (always at least 1).
+    // The pixels are premultiplied. Anything outside the layers is fully
+    // transparent.
+    RGBA8 const* Span(int x, int y, int& count);
+
+    // The area covered by all the visible layers (in composite coords).
+    Box const& Bound();
+
+private:
+    Compositor(Compositor const&);   // disallowed
+
+    // A layer which contributes to the composite.
+    struct Source {
+        NodePath path;
+        int frame;      // which of the layers frames to show
+        Point pos;      // layer position, relative to the focus image
+                        // (in composite coords)
+    };
+
+    // A neighbouring frame of the focus, to draw as an onion skin.
+    struct Onion {
+        int frame;
+        int dir;        // -1=before focus, +1=after
+        int fade;       // 0..255
+    };
+
+    struct Tile {
+        Img* under {nullptr};   // layers below the focus (null if none)
+        Img* over {nullptr};    // layers above the focus (null if none)
+        Img* final {nullptr};   // the finished composite
+        bool underDirty {true};
+        bool overDirty {true};
+        bool finalDirty {true};
+    };
+
+    void Rethink();
+    void FreeTiles();
+    void Invalidate(Box const& area, bool under, bool over);
+    Tile& Fetch(int col, int row);
+    void Flatten(std::vector<Source> const& srcs, Img& dest, Box const& area);
+    void Composite(Source const& src, Img& dest, Box const& area);
+    Img const& SourceImg(NodePath const& path, int frame);
+    void DropMips(NodePath const& target, int first, int count);
+    void CompositeOnion(Onion const& onion, Img& dest, Box const& area);
+    Source const* FindSource(NodePath const& target) const;
+
+    Project const& m_Proj;
+    NodePath m_Focus;
+    int m_Frame;
+    int m_Level;
+    int m_OnionCount;
+    OnionSkins m_OnionCache;
+
+    bool m_Valid;   // set once the sources and tile grid are worked out
+    std::vector<Source> m_Under;    // bottom-most first
+    Source m_FocusSrc;
+    std::vector<Onion> m_Onions;    // furthest first
+    std::vector<Source> m_Over;     // bottom-most first
+
+    Box m_Bound;    // union of all the sources
+    Box m_Grid;     // m_Bound, rounded out to whole tiles
+    int m_Cols;
+    int m_Rows;
+    std::vector<Tile> m_Tiles;
+
+    // palette to use instead of the layer one (see SetDisplayPalette())
+    NodePath m_DisplayTarget;
+    Palette const* m_DisplayPalette;
+
+    // mip pyramids, by layer path & frame (created as needed)
+    typedef std::pair<std::vector<int>, int> MipKey;
+    std::map<MipKey, MipPyramid*> m_Mips;
+    // which indices are used where, for indexed layer frames (same keys)
+    std::map<MipKey, IndexOccupancy*> m_Occupancy;
+};
+
+#endif // COMPOSITOR_H
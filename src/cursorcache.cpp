@@ -0,0 +1,149 @@
+#include "cursorcache.h"
+#include "brush.h"
+#include "img.h"
+#include "palette.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+CursorCache::CursorCache() :
+    m_Valid(false),
+    m_BrushGeneration(0),
+    m_Palette(nullptr),
+    m_XZoom(1),
+    m_YZoom(1),
+    m_Shrink(0),
+    m_Matte(false),
+    m_MatteColour(0, 0, 0),
+    m_Img(nullptr)
+{
+}
+
+CursorCache::~CursorCache()
+{
+    delete m_Img;
+}
+
+// Look up brush pixel (x,y) as it'll be shown.
+// Returns false if it's transparent.
+static bool brushPixel(Brush const& brush, Palette const& pal, PenColour const& transparent,
+    int x, int y, RGBX8& c)
+{
+    switch (brush.Fmt()) {
+    case FMT_I8:
+        {
+            I8 i = *brush.PtrConst_I8(x, y);
+            c = pal.GetColour(i);
+            return (i != transparent.idx());
+        }
+    case FMT_RGBX8:
+        c = *brush.PtrConst_RGBX8(x, y);
+        return (c != transparent.toRGBX8());
+    case FMT_RGBA8:
+        {
+            RGBA8 src = *brush.PtrConst_RGBA8(x, y);
+            c = RGBX8(src.r, src.g, src.b);
+            return (src.a > 0);
+        }
+    default:
+        assert(false);
+        return false;
+    }
+}
+
+void CursorCache::Build(Brush const& brush, Palette const& pal, int xzoom, int yzoom,
+    int shrink, bool matte, RGBX8 mattecolour)
+{
+    // when shrunk, each (step x step) block of brush pixels becomes one
+    // cursor pixel, opaque if any of the block is (so thin brushes don't
+    // vanish)
+    const int step = 1 << shrink;
+    const int w = (brush.W() + step - 1) >> shrink;
+    const int h = (brush.H() + step - 1) >> shrink;
+    PenColour transparent = brush.TransparentColour();
+
+    delete m_Img;
+    m_Img = new Img(FMT_RGBX8, w * xzoom, h);
+    m_Spans.clear();
+    m_RowStart.resize(h + 1);
+
+    for (int y = 0; y < h; ++y) {
+        m_RowStart[y] = (int)m_Spans.size();
+        RGBX8* dest = m_Img->Ptr_RGBX8(0, y);
+        bool inSpan = false;
+        const int by1 = std::min((y + 1) << shrink, brush.H());
+        for (int x = 0; x < w; ++x) {
+            const int bx1 = std::min((x + 1) << shrink, brush.W());
+            RGBX8 c;
+            bool opaque = false;
+            for (int by = y << shrink; by < by1 && !opaque; ++by) {
+                for (int bx = x << shrink; bx < bx1 && !opaque; ++bx) {
+                    opaque = brushPixel(brush, pal, transparent, bx, by, c);
+                }
+            }
+            if (matte) {
+                c = mattecolour;
+            }
+            std::fill(dest + x * xzoom, dest + (x + 1) * xzoom, c);
+
+            if (opaque) {
+                if (inSpan) {
+                    m_Spans.back().len += xzoom;
+                } else {
+                    m_Spans.push_back(Span{x * xzoom, xzoom});
+                    inSpan = true;
+                }
+            } else {
+                inSpan = false;
+            }
+        }
+    }
+    m_RowStart[h] = (int)m_Spans.size();
+
+    m_BrushGeneration = brush.Generation();
+    m_Palette = &pal;
+    m_XZoom = xzoom;
+    m_YZoom = yzoom;
+    m_Shrink = shrink;
+    m_Matte = matte;
+    m_MatteColour = mattecolour;
+    m_Valid = true;
+}
+
+void CursorCache::Draw(Brush const& brush, Palette const& pal, int xzoom, int yzoom,
+    int shrink, bool matte, PenColour const& mattecolour,
+    Img& canvas, Point const& pos)
+{
+    assert(canvas.Fmt() == FMT_RGBX8);
+    assert(xzoom >= 1 && yzoom >= 1 && shrink >= 0);
+
+    RGBX8 mc = matte ? mattecolour.toRGBX8() : RGBX8(0, 0, 0);
+    if (!m_Valid || m_BrushGeneration != brush.Generation() || m_Palette != &pal ||
+        m_XZoom != xzoom || m_YZoom != yzoom || m_Shrink != shrink ||
+        m_Matte != matte ||
+        (matte && m_MatteColour != mc)) {
+        Build(brush, pal, xzoom, yzoom, shrink, matte, mc);
+    }
+
+    Box area(pos, m_Img->W(), m_Img->H() * yzoom);
+    area.ClipAgainst(canvas.Bounds());
+    if (area.Empty()) {
+        return;
+    }
+    const int xmin = area.XMin() - pos.x;
+    const int xmax = xmin + area.w;     // exclusive
+    for (int y = area.YMin(); y <= area.YMax(); ++y) {
+        int row = (y - pos.y) / yzoom;
+        RGBX8 const* src = m_Img->PtrConst_RGBX8(0, row);
+        RGBX8* dest = canvas.Ptr_RGBX8(area.XMin(), y);
+        for (int i = m_RowStart[row]; i < m_RowStart[row + 1]; ++i) {
+            Span const& s = m_Spans[i];
+            int x0 = std::max(s.x, xmin);
+            int x1 = std::min(s.x + s.len, xmax);
+            if (x0 < x1) {
+                std::copy(src + x0, src + x1, dest + (x0 - xmin));
+            }
+        }
+    }
+}
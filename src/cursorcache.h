@@ -0,0 +1,66 @@
+#ifndef CURSORCACHE_H
+#define CURSORCACHE_H
+
+#include "colours.h"
+#include "point.h"
+
+#include <vector>
+
+class Brush;
+class Img;
+struct Palette;
+
+// CursorCache holds a zoomed, palette-resolved copy of a brush, along
+// with a list of its opaque spans, so drawing the brush as a tool cursor
+// is just a masked copy.
+//
+// It's rebuilt whenever the brush, zoom, palette or matte colour differ
+// from the last call. The brush is recognised by its Generation(), but the
+// palette is compared by address, so Invalidate() must be called when it is
+// modified in place.
+class CursorCache
+{
+public:
+    CursorCache();
+    ~CursorCache();
+
+    void Invalidate() { m_Valid = false; }
+
+    // Draw brush onto canvas (which must be RGBX8), zoomed, with its
+    // top-left corner at pos. Transparent brush pixels are skipped.
+    // shrink is the view's zoom-out level (the brush is halved that many
+    // times, to match the mip level the view shows).
+    // If matte is set, all the opaque pixels use mattecolour, otherwise
+    // they use the brush colours (looked up in pal for indexed brushes).
+    void Draw(Brush const& brush, Palette const& pal, int xzoom, int yzoom,
+        int shrink, bool matte, PenColour const& mattecolour,
+        Img& canvas, Point const& pos);
+
+private:
+    CursorCache(CursorCache const&);    // disallowed
+
+    struct Span {
+        int x;      // in zoomed coords
+        int len;
+    };
+
+    void Build(Brush const& brush, Palette const& pal, int xzoom, int yzoom,
+        int shrink, bool matte, RGBX8 mattecolour);
+
+    bool m_Valid;
+    unsigned int m_BrushGeneration;
+    Palette const* m_Palette;
+    int m_XZoom;
+    int m_YZoom;
+    int m_Shrink;
+    bool m_Matte;
+    RGBX8 m_MatteColour;
+
+    // One row per (shrunk) brush row (the zoomed rows are all the same).
+    Img* m_Img;
+    // spans for brush row y are m_Spans[m_RowStart[y]..m_RowStart[y+1]]
+    std::vector<Span> m_Spans;
+    std::vector<int> m_RowStart;
+};
+
+#endif // CURSORCACHE_H
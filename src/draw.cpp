@@ -1,5 +1,6 @@
 #include "draw.h"
 #include "img.h"
+#include "img_convert.h"
 #include "palette.h"
 
 #include <algorithm>    // for min,max
@@ -28,6 +29,21 @@ void FloodFill( Img& img, Point const& start, PenColour const& newcolour, Box& d
         case FMT_RGBA8:
             FloodFill_RGBA8(img,start,newcolour.rgb(),damage);
             break;
+        case FMT_RGBA8PM:
+            FloodFill_RGBA8(img,start,newcolour.toRGBA8PM(),damage);
+            break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            {
+                // fill an unpacked copy (with the index masked first, as
+                // it will be when packed again)
+                I8 idx = (I8)(newcolour.idx() & ((1 << img.BitsPerPixel()) - 1));
+                WithUnpacked(img, img.Bounds(), damage, [&](Img& tmp, Box& tmpdamage) {
+                    FloodFill_I8(tmp, start, idx, tmpdamage);
+                });
+            }
+            break;
         default:
             assert(false);
             break;
@@ -156,7 +172,7 @@ static void FloodFill_RGBX8( Img& img, Point const& start, RGBX8 newcolour, Box&
 // TODO: should fill across differing alpha value?
 static void FloodFill_RGBA8( Img& img, Point const& start, RGBA8 newcolour, Box& damage )
 {
-    assert(img.Fmt()==FMT_RGBA8);
+    assert(img.Fmt()==FMT_RGBA8 || img.Fmt()==FMT_RGBA8PM);
 
     damage.SetEmpty();
     RGBA8 oldcolour = img.Get_RGBA8(start);
@@ -351,6 +367,50 @@ void WalkFilledEllipse(int xc, int yc, int r1, int r2,
 	} while (y > 0);
 }
 
+static void collectPoint_cb(int x, int y, void* user)
+{
+    std::vector<Point>* out = (std::vector<Point>*)user;
+    out->push_back(Point(x, y));
+}
+
+void LinePoints(int x0, int y0, int x1, int y1, std::vector<Point>& out)
+{
+    WalkLine(x0, y0, x1, y1, collectPoint_cb, &out);
+}
+
+void EllipsePoints(int xc, int yc, int r1, int r2, std::vector<Point>& out)
+{
+    // the walk visits the quadrants in turn, and hits some points more
+    // than once (where the quadrants meet).
+    size_t first = out.size();
+    WalkEllipse(xc, yc, r1, r2, collectPoint_cb, &out);
+    auto begin = out.begin() + first;
+    std::sort(begin, out.end(), [](Point const& a, Point const& b) {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+    });
+    out.erase(std::unique(begin, out.end()), out.end());
+}
+
+static void collectSpan_cb(int x0, int x1, int y, void* user)
+{
+    std::vector<Box>* out = (std::vector<Box>*)user;
+    out->push_back(Box(x0, y, x1 - x0, 1));
+}
+
+void FilledEllipseSpans(int xc, int yc, int r1, int r2, std::vector<Box>& out)
+{
+    // the walk revisits rows with growing spans - just keep the widest.
+    std::vector<Box> spans;
+    WalkFilledEllipse(xc, yc, r1, r2, collectSpan_cb, &spans);
+    std::sort(spans.begin(), spans.end(), [](Box const& a, Box const& b) {
+        return a.y < b.y || (a.y == b.y && a.w > b.w);
+    });
+    auto last = std::unique(spans.begin(), spans.end(), [](Box const& a, Box const& b) {
+        return a.y == b.y;
+    });
+    out.insert(out.end(), spans.begin(), last);
+}
+
 
 void RectFill(Img& destimg, Box& destbox, PenColour const& pen )
 {
@@ -380,14 +440,20 @@ void RectFill(Img& destimg, Box& destbox, PenColour const& pen )
             }
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:
             {
-                RGBA8 c = pen.rgb();
+                RGBA8 c = (destimg.Fmt() == FMT_RGBA8PM) ? pen.toRGBA8PM() : pen.toRGBA8();
                 RGBA8* dest = destimg.Ptr_RGBA8( destbox.x+0, destbox.y+y );
                 int x;
                 for (x=0; x<destbox.w; ++x)
                     *dest++ = c;
             }
             break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            destimg.HLine(pen, destbox.x, destbox.x + destbox.w, destbox.y+y);
+            break;
         default:
             assert(false);
             break;
@@ -3,6 +3,8 @@
 
 #include "colours.h"
 
+#include <vector>
+
 class Img;
 struct Box;
 class Point;
@@ -23,5 +25,14 @@ void WalkEllipse(int xc, int yc, int r1, int r2,
 void WalkFilledEllipse(int xc, int yc, int r1, int r2,
     void (*drawhline)(int x0, int x1, int y, void* user ), void* userdata );
 
+// As above, but collecting the results (appended to out) so they can be
+// drawn in one batch.
+// LinePoints() returns the points in order from (x0,y0) to (x1,y1).
+// EllipsePoints() returns each point once, sorted by row.
+// FilledEllipseSpans() returns one single-row box per row.
+void LinePoints(int x0, int y0, int x1, int y1, std::vector<Point>& out);
+void EllipsePoints(int xc, int yc, int r1, int r2, std::vector<Point>& out);
+void FilledEllipseSpans(int xc, int yc, int r1, int r2, std::vector<Box>& out);
+
 #endif // DRAW_H
 
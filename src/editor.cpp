@@ -5,6 +5,7 @@
 #include "project.h"
 #include "app.h"
 #include "cmd.h"
+#include "strokequeue.h"
 
 #include <cassert>
 #include <stdint.h>
@@ -14,12 +15,16 @@
 Editor::Editor(Project* proj) :
     m_Project(proj),
     m_Tool(nullptr),
+    m_Strokes(nullptr),
     m_Mode(DrawMode::DM_NORMAL),
     m_Brush(0),
     m_GridActive(false),
+    m_OnionSkins(0),
+    m_Cycling(false),
     m_CurrRange(0,0,0,0)
 {
     m_Tool = new PencilTool(*this);
+    m_Strokes = new StrokeQueue(*m_Project, [this]() { OnStrokeDrawn(); });
     m_Project->AddListener(this);
 
     // assume we'll want pen colours from the first layer...
@@ -34,6 +39,7 @@ Editor::Editor(Project* proj) :
 
 Editor::~Editor()
 {
+    delete m_Strokes;
     m_Project->RemoveListener(this);
     DiscardUndoAndRedos();
 
@@ -46,6 +52,7 @@ Editor::~Editor()
 
 void Editor::UseTool( int tooltype, bool notifygui )
 {
+    FinishStrokes();
     HideToolCursor();
 
     delete m_Tool;
@@ -109,10 +116,26 @@ void Editor::SetBrush( int n )
 {
     HideToolCursor();
     m_Brush = n;
+    InvalidateCursorCaches();
     OnBrushChanged();
     ShowToolCursor();
 }
 
+void Editor::BrushModified()
+{
+    HideToolCursor();
+    InvalidateCursorCaches();
+    OnBrushChanged();
+    ShowToolCursor();
+}
+
+void Editor::InvalidateCursorCaches()
+{
+    for (auto v : m_Views) {
+        v->InvalidateCursorCache();
+    }
+}
+
 void Editor::ShowToolCursor()
 {
     if( !m_Tool )
@@ -135,6 +158,66 @@ void Editor::HideToolCursor()
     }
 }
 
+void Editor::QueueStroke( EditView& view, Point const& pos )
+{
+    m_Strokes->Push(*m_Tool, view, pos);
+}
+
+void Editor::FinishStrokes()
+{
+    m_Strokes->Flush();
+    DeliverStrokes();
+}
+
+void Editor::DeliverStrokes()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_Project->Mutex());
+    m_Project->DeliverDeferredDamage();
+}
+
+void Editor::SetOnionSkins( int n )
+{
+    m_OnionSkins = n;
+    for (auto v : m_Views) {
+        v->SetOnionSkins(n);
+    }
+}
+
+void Editor::SetCycling( bool on )
+{
+    if (on == m_Cycling) {
+        return;
+    }
+    m_Cycling = on;
+    if (on) {
+        m_CycleStart = std::chrono::steady_clock::now();
+        CycleColours();
+    } else {
+        for (auto v : m_Views) {
+            v->CycleColours(-1.0);
+        }
+    }
+}
+
+void Editor::CycleColours()
+{
+    if (!m_Cycling) {
+        return;
+    }
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - m_CycleStart;
+    for (auto v : m_Views) {
+        v->CycleColours(t.count());
+    }
+}
+
+void Editor::SetRetroMode( RetroMode const& mode )
+{
+    Proj().mSettings.Retro = mode;
+    for (auto v : m_Views) {
+        v->RetroModeChanged();
+    }
+}
+
 void Editor::GridSnap( Point& p )
 {
     if( !GridActive() )
@@ -153,12 +236,14 @@ void Editor::GridSnap( Point& p )
 void Editor::SetFGPen( PenColour const& pen )
 {
     m_FGPen=pen;
+    InvalidateCursorCaches();
     OnPenChanged();
 }
 
 void Editor::SetBGPen( PenColour const& pen )
 {
     m_BGPen = pen;
+    InvalidateCursorCaches();
     OnPenChanged();
 }
 
@@ -169,6 +254,8 @@ void Editor::SetBGPen( PenColour const& pen )
 void Editor::AddCmd( Cmd* cmd )
 {
     const int maxundos = 128;
+    FinishStrokes();
+    std::lock_guard<std::recursive_mutex> lock(m_Project->Mutex());
 
     m_UndoStack.push_back( cmd );
     if( cmd->State() == Cmd::NOT_DONE )
@@ -201,6 +288,8 @@ void Editor::Undo()
     {
         return;
     }
+    FinishStrokes();
+    std::lock_guard<std::recursive_mutex> lock(m_Project->Mutex());
 //    HideToolCursor();
 
     Cmd* cmd = m_UndoStack.back();
@@ -216,6 +305,8 @@ void Editor::Redo()
 {
     if( m_RedoStack.empty() )
         return;
+    FinishStrokes();
+    std::lock_guard<std::recursive_mutex> lock(m_Project->Mutex());
 //    HideToolCursor();
     Cmd* cmd = m_RedoStack.back();
     m_RedoStack.pop_back();
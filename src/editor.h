@@ -5,10 +5,13 @@ class EditView;
 class Brush;
 class Tool;
 class Cmd;
+class StrokeQueue;
 
+#include "colourcycle.h"
 #include "project.h"
 #include "projectlistener.h"
 #include "mousestyle.h"
+#include <chrono>
 #include <set>
 
 
@@ -45,6 +48,25 @@ public:
     // snap p to grid, if active (else left unchanged)
     void GridSnap( Point& p );
 
+    // number of onion-skinned frames shown either side of the current one
+    // (0=off). Applies to all views.
+    int OnionSkins() const              { return m_OnionSkins; }
+    void SetOnionSkins( int n );
+
+    // Colour cycling (display only - see ColourCycler). Applies to all
+    // views. While on, the GUI should call CycleColours() every frame.
+    bool Cycling() const                { return m_Cycling; }
+    void SetCycling( bool on );
+    void CycleColours();
+    CycleRates& Rates()                 { return m_CycleRates; }
+
+    // Retro mode for the project. Views show any cells which break its
+    // attribute rules, using the mode's pixel width while it's active.
+    // Like the grid, it's a display setting - it doesn't touch the image
+    // data, so it isn't a Cmd.
+    RetroMode const& Retro() const      { return Proj().Settings().Retro; }
+    void SetRetroMode( RetroMode const& mode );
+
     void UseTool( int tooltype, bool notifygui=true );
     int CurrentToolType() const { return m_CurrentToolType; }
     Tool& CurrentTool() { return *m_Tool; }
@@ -66,12 +88,18 @@ public:
     void SetBrush( int n );
     int GetBrush() const { return m_Brush; }
     Brush& CurrentBrush();
+    // call after modifying the current brush in place (eg flipping it)
+    void BrushModified();
 
     // stuff for the GUI to implement
     virtual void GUIShowError( const char* msg ) = 0;
     virtual void UpdateMouseInfo( Point const& ) =0;
     virtual void SetMouseStyle( MouseStyle ) {} // see note in ~Editor()
     virtual void OnUndoRedoChanged() {}
+    // Called on the stroke worker thread when it has drawn something.
+    // The GUI should arrange for DeliverStrokes() to be called (on the GUI
+    // thread) soon after.
+    virtual void OnStrokeDrawn() {}
 
     // the project that this editor owns
     Project& Proj() const { return *m_Project; }
@@ -86,6 +114,15 @@ public:
     void ShowToolCursor();
     void HideToolCursor();
 
+    // Strokes (see StrokeQueue). Moves for tools which are Stroking() are
+    // queued up and drawn on a worker thread.
+    void QueueStroke( EditView& view, Point const& pos );
+    // Wait for any queued moves to be drawn, and deliver the damage.
+    // (GUI thread only)
+    void FinishStrokes();
+    // Deliver damage from strokes drawn so far (GUI thread only)
+    void DeliverStrokes();
+
 	// Add a cmd to the undo stack.
 	// cmd->Do() will be called.
 	// Ownership of cmd passes to Project.
@@ -127,12 +164,18 @@ private:
 
     Tool* m_Tool;
     int m_CurrentToolType;
+    StrokeQueue* m_Strokes;
 
     DrawMode m_Mode;
 
     int m_Brush; // StdBrush index, or -1 for custombrush
 
     bool m_GridActive;
+    int m_OnionSkins;
+
+    bool m_Cycling;
+    std::chrono::steady_clock::time_point m_CycleStart;
+    CycleRates m_CycleRates;
 
     PenColour m_FGPen;
     PenColour m_BGPen;
@@ -144,6 +187,7 @@ private:
 	std::list< Cmd* > m_RedoStack;
 
     void DiscardUndoAndRedos();
+    void InvalidateCursorCaches();
 };
 
 
@@ -1,6 +1,9 @@
 #include "editview.h"
 #include "editor.h"
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <cassert>
 
 
@@ -8,18 +11,28 @@ EditView::EditView(Editor& editor, NodePath const& focus, int frame, int w, int
     m_Editor(editor),
     m_PrevPos(-1,-1),
     m_Canvas( new Img(FMT_RGBX8,w,h ) ),
+    m_Front( new Img(FMT_RGBX8,w,h ) ),
+    m_Clean( new Img(FMT_RGBX8,w,h ) ),
     m_ViewBox(0,0,w,h),
     m_Focus(focus),
     m_Frame(frame),
+    m_Compositor(editor.Proj()),
+    m_Playback(nullptr),
+    m_PlaybackOrigin(0,0),
     m_Zoom(4),
+    m_Shrink(0),
     m_Offset(0,0),
     m_Panning(false),
-    m_PanAnchor(0,0)
+    m_PanAnchor(0,0),
+    m_Clash(nullptr)
 {
-    m_XZoom = m_Zoom*editor.Proj().Settings().PixW;
-    m_YZoom = m_Zoom*editor.Proj().Settings().PixH;
+    CalcZoom();
+    m_Compositor.SetFocus(m_Focus, m_Frame);
+    m_Compositor.SetOnionSkins(editor.OnionSkins());
+    RethinkClash();
     CenterView();
     DrawView(m_ViewBox);
+    m_Front->Copy(*m_Canvas);
     Proj().AddListener( this );
     editor.AddView( this );
 }
@@ -27,8 +40,13 @@ EditView::EditView(Editor& editor, NodePath const& focus, int frame, int w, int
 EditView::~EditView()
 {
     Proj().RemoveListener( this );
+    // (queued strokes might refer to us)
+    Ed().FinishStrokes();
     Ed().RemoveView( this );
     delete m_Canvas;
+    delete m_Front;
+    delete m_Clean;
+    delete m_Clash;
 }
 
 void EditView::Resize( int w, int h )
@@ -38,11 +56,23 @@ void EditView::Resize( int w, int h )
         delete m_Canvas;
         m_Canvas = 0;
     }
+    if(m_Front)
+    {
+        delete m_Front;
+        m_Front = 0;
+    }
+    if(m_Clean)
+    {
+        delete m_Clean;
+        m_Clean = 0;
+    }
 
     m_ViewBox.w = w;
     m_ViewBox.h = h;
 
     m_Canvas = new Img( FMT_RGBX8, w,h );
+    m_Front = new Img( FMT_RGBX8, w,h );
+    m_Clean = new Img( FMT_RGBX8, w,h );
     ConfineView();
 
     // if view is wider/taller than image, center it
@@ -52,30 +82,71 @@ void EditView::Resize( int w, int h )
         m_Offset.x = -(v.w - p.w) / 2;
     if( v.h>p.h)
         m_Offset.y = -(v.h - p.h) / 2;
+    AlignOffset();
 
     DrawView(m_ViewBox);
     Redraw(m_ViewBox);
 }
 
+void EditView::Present( std::vector<Box> const& areas )
+{
+    std::swap(m_Canvas, m_Front);
+    for (auto const& area : areas) {
+        Box b(area);
+        b.ClipAgainst(m_ViewBox);
+        if (b.Empty()) {
+            continue;
+        }
+        for (int y = b.YMin(); y <= b.YMax(); ++y) {
+            std::copy(m_Front->PtrConst_RGBX8(b.x, y),
+                m_Front->PtrConst_RGBX8(b.x, y) + b.w,
+                m_Canvas->Ptr_RGBX8(b.x, y));
+        }
+    }
+}
+
 void EditView::SetZoom( int zoom )
 {
-    if(zoom<1)
-        zoom=1;
+    if(zoom<-5)
+        zoom=-5;    // 1/64
     if(zoom>128)
         zoom=128;
     if(zoom == m_Zoom)
         return;
     m_Zoom = zoom;
-    m_XZoom = Proj().Settings().PixW*zoom;
-    m_YZoom = Proj().Settings().PixH*zoom;
+    CalcZoom();
+    m_Compositor.SetLevel(m_Shrink);
     ConfineView();
     DrawView(m_ViewBox);
     Redraw(m_ViewBox);
 }
 
+// work out the scaling for m_Zoom (and the project's pixel ratio)
+void EditView::CalcZoom()
+{
+    // a retro mode dictates its own pixel width (eg C64 multicolour)
+    RetroMode const& retro = Proj().Settings().Retro;
+    int pixW = retro.Active() ? retro.pixW : Proj().Settings().PixW;
+    if (m_Zoom >= 1) {
+        m_Shrink = 0;
+        m_XZoom = pixW*m_Zoom;
+        m_YZoom = Proj().Settings().PixH*m_Zoom;
+    } else {
+        m_Shrink = 1-m_Zoom;
+        m_XZoom = pixW;
+        m_YZoom = Proj().Settings().PixH;
+    }
+}
+
 void EditView::SetFocus(NodePath const& focus)
 {
     m_Focus = focus;
+    m_BrushCursor.Invalidate();
+    // any colour cycling starts afresh on the new layer
+    m_Cycler.Reset();
+    m_Compositor.SetDisplayPalette(NodePath(), nullptr);
+    m_Compositor.SetFocus(m_Focus, m_Frame);
+    RethinkClash();
     ConfineView();
     DrawView(m_ViewBox);
     Redraw(m_ViewBox);
@@ -85,21 +156,119 @@ void EditView::SetFrame(int frame)
 {
     //printf("EditView::SetFrame(%d->%d)\n", m_Frame, frame);
     m_Frame = frame;
+    m_Compositor.SetFocus(m_Focus, m_Frame);
+    m_BrushCursor.Invalidate();
+    RethinkClash();
     ConfineView();
     DrawView(m_ViewBox);
     Redraw(m_ViewBox);
     //printf("end EditView::SetFrame()\n");
 }
 
+void EditView::SetOnionSkins(int n)
+{
+    m_Compositor.SetOnionSkins(n);
+    DrawView(m_ViewBox);
+    Redraw(m_ViewBox);
+}
 
-void EditView::SetOffset( Point const& projpos )
+void EditView::CycleColours(double t)
 {
-    m_Offset = projpos;
+    IndexOccupancy::Mask changed;
+    Palette const& pal = FocusedPaletteConst();
+    if (t < 0.0) {
+        m_Cycler.Stop(pal, changed);
+        m_Compositor.SetDisplayPalette(NodePath(), nullptr);
+    } else {
+        m_Cycler.Update(pal, Proj().Ranges(m_Focus, m_Frame), m_Editor.Rates(), t, changed);
+        m_Compositor.SetDisplayPalette(m_Focus, &m_Cycler.Display());
+    }
+    RedrawIndices(changed);
+}
+
+void EditView::RetroModeChanged()
+{
+    CalcZoom();
+    RethinkClash();
     ConfineView();
     DrawView(m_ViewBox);
     Redraw(m_ViewBox);
 }
 
+// Start tracking attribute clashes from scratch.
+void EditView::RethinkClash()
+{
+    delete m_Clash;
+    m_Clash = nullptr;
+    RetroMode const& mode = Proj().Settings().Retro;
+    if (!mode.Active()) {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(Proj().Mutex());
+    Img const& img = FocusedImgConst();
+    if (!FmtIsIndexed(img.Fmt())) {
+        return;
+    }
+    m_Clash = new AttrClash(mode, img.W(), img.H());
+    m_Clash->Update(img, img.Bounds());
+}
+
+// Hatch over any clashing attribute cells in the clean rendering.
+void EditView::DrawClashes(Box const& viewbox)
+{
+    // (round outward, to catch partly-visible pixels)
+    Box projArea(ViewToProj(viewbox));
+    projArea.Expand(1 << m_Shrink);
+    std::vector<Box> cells;
+    m_Clash->FindClashes(projArea, cells);
+
+    // stripes are anchored to the project, like the checkerboard
+    const int ox = (m_Offset.x >> m_Shrink) * m_XZoom;
+    const int oy = (m_Offset.y >> m_Shrink) * m_YZoom;
+    for (auto const& cell : cells) {
+        Box b(ProjToView(cell));
+        b.ClipAgainst(viewbox);
+        for (int y = b.YMin(); y <= b.YMax(); ++y) {
+            RGBX8* p = m_Clean->Ptr_RGBX8(b.x, y);
+            for (int x = b.XMin(); x <= b.XMax(); ++x, ++p) {
+                if (((x + ox + y + oy) & 7) < 3) {
+                    *p = RGBX8((p->r + 255) / 2, p->g / 2, p->b / 2);
+                }
+            }
+        }
+    }
+}
+
+// Redraw the parts of the focus layer which use any of the given indices.
+void EditView::RedrawIndices(IndexOccupancy::Mask const& indices)
+{
+    std::vector<Box> compdmg;
+    m_Compositor.DamageIndices(m_Focus, indices, compdmg);
+    for (auto const& b : compdmg) {
+        Box area(CompToView(b));
+        Box affected;
+        DrawView(area,&affected);
+        Redraw(affected);
+    }
+}
+
+void EditView::SetPlayback(Img const* img, Point const& origin)
+{
+    assert(!img || img->Fmt() == FMT_RGBA8PM);
+    m_Playback = img;
+    m_PlaybackOrigin = origin;
+    DrawView(m_ViewBox);
+    Redraw(m_ViewBox);
+}
+
+void EditView::SetOffset( Point const& projpos )
+{
+    Point prev = m_Offset;
+    m_Offset = projpos;
+    ConfineView();
+    ScrollView(prev);
+}
+
 // Offsets the view to make sure viewspace point viewp is over
 // projectspace point projp.
 void EditView::AlignView( Point const& viewp, Point const& projp )
@@ -114,6 +283,90 @@ void EditView::AlignView( Point const& viewp, Point const& projp )
 }
 
 
+// Move the contents of a view-sized image by (dx,dy), leaving the
+// newly-exposed strips as they were. dx and dy must be smaller than the
+// image.
+static void shiftImg(Img& img, int dx, int dy)
+{
+    const int w = img.W();
+    const int h = img.H();
+    const int srcx = std::max(0, -dx);
+    const int destx = std::max(0, dx);
+    const size_t nbytes = (w - std::abs(dx)) * sizeof(RGBX8);
+    // (going against the direction of movement, so we don't trample rows
+    // we've yet to read)
+    if (dy > 0) {
+        for (int y = h - 1; y >= dy; --y) {
+            memmove(img.Ptr_RGBX8(destx, y), img.PtrConst_RGBX8(srcx, y - dy), nbytes);
+        }
+    } else {
+        for (int y = 0; y < h + dy; ++y) {
+            memmove(img.Ptr_RGBX8(destx, y), img.PtrConst_RGBX8(srcx, y - dy), nbytes);
+        }
+    }
+}
+
+// Bring the canvas up to date after the offset has changed from prev.
+// Rather than rendering the whole view again, shift the existing canvas
+// contents and just render the strips which have been exposed. The GUI is
+// told to scroll what it's showing, so it only has to repaint the strips
+// too.
+void EditView::ScrollView( Point const& prev )
+{
+    // offsets are always aligned to the shrink factor, so this is exact
+    int dx = ((prev.x - m_Offset.x) >> m_Shrink) * m_XZoom;
+    int dy = ((prev.y - m_Offset.y) >> m_Shrink) * m_YZoom;
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+    const int w = m_ViewBox.w;
+    const int h = m_ViewBox.h;
+    if (std::abs(dx) >= w || std::abs(dy) >= h) {
+        // nothing worth keeping
+        m_CursorDamage.clear();
+        DrawView(m_ViewBox);
+        Redraw(m_ViewBox);
+        return;
+    }
+
+    // Shift all three images, so the front and back canvases stay in sync
+    // (the front is only ever read by the GUI, on this thread).
+    shiftImg(*m_Clean, dx, dy);
+    shiftImg(*m_Canvas, dx, dy);
+    shiftImg(*m_Front, dx, dy);
+    Scrolled(dx, dy);
+
+    // render the newly-exposed L-shaped area
+    std::vector<Box> exposed;
+    int keepy = std::max(0, dy);
+    int keeph = h - std::abs(dy);
+    if (dy > 0) {
+        exposed.push_back(Box(0, 0, w, dy));
+    } else if (dy < 0) {
+        exposed.push_back(Box(0, h + dy, w, -dy));
+    }
+    if (dx > 0) {
+        exposed.push_back(Box(0, keepy, dx, keeph));
+    } else if (dx < 0) {
+        exposed.push_back(Box(w + dx, keepy, -dx, keeph));
+    }
+    for (auto const& b : exposed) {
+        DrawView(b);
+        Redraw(b);
+    }
+
+    // tool cursors got dragged along with everything else, so wipe them
+    for (auto b : m_CursorDamage) {
+        b.Translate(Point(dx, dy));
+        Box clipped;
+        RestoreCanvas(b, &clipped);
+        if (!clipped.Empty()) {
+            Redraw(clipped);
+        }
+    }
+    m_CursorDamage.clear();
+}
+
 // confine the view to keep as much of the image onscreen as possible.
 void EditView::ConfineView()
 {
@@ -169,6 +422,16 @@ void EditView::ConfineView()
             m_Offset.y = (p.y+p.H()) - v.H();
     }
 
+    AlignOffset();
+}
+
+// When shrunk, keep the offset on a whole view pixel, so view and
+// composite coordinates line up.
+void EditView::AlignOffset()
+{
+    int mask = ~((1<<m_Shrink)-1);
+    m_Offset.x &= mask;
+    m_Offset.y &= mask;
 }
 
 void EditView::CenterView()
@@ -177,6 +440,7 @@ void EditView::CenterView()
     Box v = ViewToProj( m_ViewBox );
     m_Offset.x = -(v.w - p.w) / 2;
     m_Offset.y = -(v.h - p.h) / 2;
+    AlignOffset();
 }
 
 void EditView::FocusedRange(std::vector<PenColour>& out) const
@@ -199,10 +463,14 @@ void EditView::OnMouseDown( Point const& viewpos, Button button )
         m_Panning = true;
         return;
     }
+    if( m_Playback )
+        return;
 
     if( Ed().CurrentTool().ObeyGrid() )
         Ed().GridSnap(p);
 
+    Ed().FinishStrokes();
+    std::lock_guard<std::recursive_mutex> lock(Proj().Mutex());
     Ed().HideToolCursor();
     Ed().CurrentTool().OnDown( *this, p, button );
     // NOTE: Tool might have changed!
@@ -223,12 +491,20 @@ void EditView::OnMouseMove( Point const& viewpos )
     if( Ed().CurrentTool().ObeyGrid() )
         Ed().GridSnap(p);
 
-    if( p == m_PrevPos )
+    if( p == m_PrevPos || m_Playback )
         return;
 
     Ed().UpdateMouseInfo( p );
 
+    if( Ed().CurrentTool().Stroking() )
+    {
+        // leave the drawing to the stroke worker
+        Ed().QueueStroke( *this, p );
+        m_PrevPos = p;
+        return;
+    }
 
+    std::lock_guard<std::recursive_mutex> lock(Proj().Mutex());
     Ed().HideToolCursor();
     Ed().CurrentTool().OnMove( *this, p );
     // NOTE: Tool might have changed!
@@ -243,11 +519,16 @@ void EditView::OnMouseUp( Point const & viewpos, Button button )
         m_Panning = false;
         return;
     }
+    if( m_Playback )
+        return;
 
     Point p = ViewToProj( viewpos );
     if( Ed().CurrentTool().ObeyGrid() )
         Ed().GridSnap(p);
 
+    // make sure the whole stroke is drawn before the tool commits it
+    Ed().FinishStrokes();
+    std::lock_guard<std::recursive_mutex> lock(Proj().Mutex());
     Ed().HideToolCursor();
     Ed().CurrentTool().OnUp( *this, p, button );
     // NOTE: Tool might have changed!
@@ -273,7 +554,8 @@ static RGBX8 checker2(int x,int y) {
         return RGBX8(224/2,224/2,224/2);
 }
 
-// Render project to canvas, with zooming.
+// Render project to the clean image (with zooming), and copy it to the
+// canvas.
 void EditView::DrawView( Box const& viewbox, Box* affectedview )
 {
     // note: viewbox can be outside the project boundary
@@ -283,24 +565,30 @@ void EditView::DrawView( Box const& viewbox, Box* affectedview )
     Box vb(viewbox);
     vb.ClipAgainst(m_ViewBox);
 
-    Img const& img = FocusedImgConst();
-    // get project bounds in view coords (unclipped)
-    Box pbox(ProjToView(img.Bounds()));
+    // (the stroke worker might be drawing into the project)
+    std::lock_guard<std::recursive_mutex> lock(Proj().Mutex());
+
+    // get bounds of all the visible layers in view coords (unclipped)
+    Box pbox(CompToView(m_Playback ? PlaybackBound() : m_Compositor.Bound()));
+    Point compoff(m_Offset.x >> m_Shrink, m_Offset.y >> m_Shrink);
+    // checkerboards are anchored to the project rather than the view, so
+    // scrolled parts of the canvas still match freshly-drawn ones.
+    const int cbx = compoff.x * m_XZoom;
+    const int cby = compoff.y * m_YZoom;
 
     // step x,y through view coords of the area to draw
     int y;
-//    int xmin = std::min(pbox.XMin(), vb.XMax()+1);
     int xbegin = std::min(pbox.x, vb.x + vb.w);
     int xend = std::min(pbox.x + pbox.w, vb.x + vb.w);
     for(y=vb.YMin(); y<=vb.YMax(); ++y) {
-        RGBX8* dest = m_Canvas->Ptr_RGBX8(vb.x,y);
+        RGBX8* dest = m_Clean->Ptr_RGBX8(vb.x,y);
         int x=vb.XMin();
 
         // scanline intersects canvas?
         if(y<pbox.YMin() || y>pbox.YMax()) {
             // line is above or below the project
             while(x<=vb.XMax()) {
-                *dest++ = checker2(x,y);
+                *dest++ = checker2(x+cbx,y+cby);
                 ++x;
             }
             continue;
@@ -308,117 +596,160 @@ void EditView::DrawView( Box const& viewbox, Box* affectedview )
 
         // left of project canvas
         while(x<xbegin) {
-            *dest++ = checker2(x,y);
+            *dest++ = checker2(x+cbx,y+cby);
             ++x;
         }
 
         if(x<xend) {
             // on the project canvas
-            Point p( ViewToProj(Point(x,y)) );
-            switch( img.Fmt() ) {
-
-            case FMT_I8:
-                {
-                    Palette const& pal = FocusedPaletteConst();
-                    I8 const* src = img.PtrConst_I8( p.x,p.y );
-                    while(x<xend) {
-                        int cx = x + (m_Offset.x*m_XZoom);
-                        int pixstop = x + (m_XZoom-(cx%m_XZoom));
-                        if(pixstop>xend)
-                            pixstop=xend;
-                        RGBA8 c = pal.GetColour(*src++);
-                        while(x<pixstop)
-                        {
-                            //*dest++ = c;
-                            *dest++ = Blend(c,checker(x,y));
-                            ++x;
-                        }
+            // (in composite coords)
+            Point p( x/m_XZoom + compoff.x, y/m_YZoom + compoff.y );
+            RGBA8 const* src = nullptr;
+            int avail = 0;
+            while(x<xend) {
+                if (avail == 0) {
+                    if (m_Playback) {
+                        src = PlaybackSpan(p.x, p.y, avail);
+                    } else {
+                        src = m_Compositor.Span(p.x, p.y, avail);
                     }
                 }
-                break;
-            case FMT_RGBX8:
-                {
-                    RGBX8 const* src = img.PtrConst_RGBX8( p.x,p.y );
-                    while(x<xend) {
-                        int cx = x + (m_Offset.x*m_XZoom);
-                        int pixstop = x + (m_XZoom-(cx%m_XZoom));
-                        if(pixstop>xend)
-                            pixstop=xend;
-                        RGBX8 c = *src++;
-                        while(x<pixstop) {
-                            *dest++ = c;
-                            ++x;
-                        }
+                int cx = x + (compoff.x*m_XZoom);
+                int pixstop = x + (m_XZoom-(cx%m_XZoom));
+                if(pixstop>xend)
+                    pixstop=xend;
+                RGBA8 c = *src++;
+                --avail;
+                ++p.x;
+                if (c.a == 255) {
+                    RGBX8 opaque(c.r, c.g, c.b);
+                    while(x<pixstop) {
+                        *dest++ = opaque;
+                        ++x;
                     }
-                }
-                break;
-            case FMT_RGBA8:
-                {
-                    RGBA8 const* src = img.PtrConst_RGBA8( p.x,p.y );
-                    while(x<xend) {
-                        int cx = x + (m_Offset.x*m_XZoom);
-                        int pixstop = x + (m_XZoom-(cx%m_XZoom));
-                        if(pixstop>xend)
-                            pixstop=xend;
-                        RGBA8 c = *src++;
-                        while(x<pixstop) {
-                            *dest++ = Blend(c,checker(x,y));
-                            ++x;
-                        }
+                } else {
+                    while(x<pixstop) {
+                        *dest++ = BlendPM(c,checker(x+cbx,y+cby));
+                        ++x;
                     }
                 }
-                break;
-            default:
-                assert(false);
-                break;
             }
         }
         // right of canvas
         while(x < vb.x+vb.w)
         {
-            *dest++ = checker2(x,y);
+            *dest++ = checker2(x+cbx,y+cby);
             ++x;
         }
     }
 
+    if (m_Clash && !m_Playback) {
+        DrawClashes(vb);
+    }
+
+    RestoreCanvas(vb, affectedview);
+}
+
+// Copy the clean project rendering to the canvas (wiping out any tool
+// cursors in the area).
+void EditView::RestoreCanvas( Box const& viewbox, Box* affectedview )
+{
+    Box vb(viewbox);
+    vb.ClipAgainst(m_ViewBox);
+    if (!vb.Empty()) {
+        for (int y = vb.YMin(); y <= vb.YMax(); ++y) {
+            RGBX8 const* src = m_Clean->PtrConst_RGBX8(vb.x, y);
+            std::copy(src, src + vb.w, m_Canvas->Ptr_RGBX8(vb.x, y));
+        }
+    }
     if(affectedview)
         *affectedview = vb;
 }
 
 
+// bounds of the playback image, in composite coords
+Box EditView::PlaybackBound() const
+{
+    Box b(m_PlaybackOrigin, m_Playback->W(), m_Playback->H());
+    if (m_Shrink == 0) {
+        return b;
+    }
+    int x0 = b.XMin() >> m_Shrink;
+    int y0 = b.YMin() >> m_Shrink;
+    int x1 = b.XMax() >> m_Shrink;
+    int y1 = b.YMax() >> m_Shrink;
+    return Box(x0, y0, (x1 - x0) + 1, (y1 - y0) + 1);
+}
+
+// Like Compositor::Span(), but reading from the playback image.
+// (when shrunk, it's just point-sampled)
+RGBA8 const* EditView::PlaybackSpan(int x, int y, int& count) const
+{
+    static const RGBA8 transparent(0,0,0,0);
+    Point p((x << m_Shrink) - m_PlaybackOrigin.x, (y << m_Shrink) - m_PlaybackOrigin.y);
+    count = 1;
+    if (!m_Playback->Bounds().Contains(p)) {
+        return &transparent;
+    }
+    if (m_Shrink == 0) {
+        count = m_Playback->W() - p.x;
+    }
+    return m_Playback->PtrConst_RGBA8(p.x, p.y);
+}
+
+
 // Begin ProjectListener implementation.
 
 // called when project has been modified
 void EditView::OnDamaged(NodePath const& target, int frame, Box const& projdmg)
 {
-    if (m_Frame != frame) {
+    // find out which part of the composite is affected (if any)
+    Box compdmg = m_Compositor.Damage(target, frame, projdmg);
+    if (compdmg.Empty()) {
         return;
     }
-    // TODO: ignore non-visible layers...
-    // TODO: account for onionskinning.
 
     Box viewdirtied;
 
     // just redraw the damaged part of the project...
-    Box area(ProjToView(projdmg));
+    Box area(CompToView(compdmg));
+    if (m_Clash && target == m_Focus && frame == m_Frame) {
+        // ...plus the whole of any attribute cells touched, as their
+        // clash state might have changed.
+        std::lock_guard<std::recursive_mutex> lock(Proj().Mutex());
+        area.Merge(ProjToView(m_Clash->Update(FocusedImgConst(), projdmg)));
+    }
     DrawView(area, &viewdirtied );
 
     // tell the gui to display damaged part
     Redraw(viewdirtied);
 }
 
-void EditView::OnPaletteChanged(NodePath const& target, int frame, int /*index*/, Colour const&/*newColour*/)
+void EditView::OnPaletteChanged(NodePath const& target, int /*frame*/, int index, Colour const&/*newColour*/)
 {
-    OnPaletteReplaced(target, frame);
+    m_BrushCursor.Invalidate();
+    // just redraw the tiles using that colour
+    std::vector<Box> compdmg;
+    m_Compositor.DamageIndex(target, index, compdmg);
+    for (auto const& b : compdmg) {
+        Box area(CompToView(b));
+        Box affected;
+        DrawView(area,&affected);
+        Redraw(affected);
+    }
 }
 
 void EditView::OnPaletteReplaced(NodePath const& target, int frame)
 {
-    if (!Proj().SharesPalette(target, frame, m_Focus, m_Frame)) {
+    if (Proj().SharesPalette(target, frame, m_Focus, m_Frame)) {
+        m_BrushCursor.Invalidate();
+    }
+    // redraw the whole layer, if it's shown (don't need to redraw padding)
+    Box compdmg = m_Compositor.DamageLayer(target);
+    if (compdmg.Empty()) {
         return;
     }
-    // redraw the whole project (don't need to redraw padding)
-    Box area(ProjToView(FocusedImgConst().Bounds()));
+    Box area(CompToView(compdmg));
     Box affected;
     DrawView(area,&affected);
     Redraw(affected);
@@ -430,8 +761,10 @@ void EditView::OnModifiedFlagChanged(bool /*changed*/)
 
 void EditView::OnFramesAdded(NodePath const& target, int /*first*/, int /*count*/)
 {
-    //Layer const& l = Proj().ResolveLayer(target);
-    // TODO: ignore changes on non-visible layers.
+    m_Compositor.FramesShuffled(target);
+    if (target == m_Focus) {
+        RethinkClash();
+    }
 
     // redraw the whole view (including padding)
     Box affected;
@@ -442,12 +775,16 @@ void EditView::OnFramesAdded(NodePath const& target, int /*first*/, int /*count*
 void EditView::OnFramesRemoved(NodePath const& target, int /*first*/, int /*count*/)
 {
     Layer const& l = Proj().ResolveLayer(target);
-    // TODO: ignore changes on non-visible layers.
 
     // make sure we're still pointing at a valid frame.
     if (m_Frame >= (int)l.mFrames.size()) {
         m_Frame = (int)l.mFrames.size()-1;
     }
+    m_Compositor.FramesShuffled(target);
+    m_Compositor.SetFocus(m_Focus, m_Frame);
+    if (target == m_Focus) {
+        RethinkClash();
+    }
 
     // redraw the whole view (including padding)
     Box affected;
@@ -455,8 +792,13 @@ void EditView::OnFramesRemoved(NodePath const& target, int /*first*/, int /*coun
     Redraw(affected);
 }
 
-void EditView::OnFramesBlatted(NodePath const& target, int /*first*/, int /*count*/)
+void EditView::OnFramesBlatted(NodePath const& target, int first, int count)
 {
+    m_Compositor.FramesBlatted(target, first, count);
+    if (target == m_Focus) {
+        RethinkClash();
+    }
+
     // redraw the whole view (including padding)
     Box affected;
     DrawView(m_ViewBox,&affected);
@@ -479,7 +821,7 @@ void EditView::EraseCursor()
     for( it=m_CursorDamage.begin(); it!=itend; ++it )
     {
         Box clipped;
-        DrawView(*it, &clipped );
+        RestoreCanvas(*it, &clipped );
         Redraw( clipped );
     }
 
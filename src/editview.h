@@ -2,6 +2,9 @@
 #define EDITVIEW_H
 
 #include "box.h"
+#include "colourcycle.h"
+#include "compositor.h"
+#include "cursorcache.h"
 #include "project.h"
 #include "projectlistener.h"
 #include "point.h"
@@ -18,6 +21,15 @@ class Editor;
 // Maintains a backing canvas (raw bitmap image) for displaying project
 // and tool cursors. GUI windows can just blit that canvas to screen.
 // Also handles tool interaction.
+//
+// The canvas is double-buffered: the core renders into the back canvas
+// while the GUI displays the front one. The GUI calls Present() with the
+// areas it's been asked to Redraw() to bring the front up to date.
+//
+// The project itself is rendered into a separate, cursor-free image, and
+// copied to the canvas. Tool cursors are drawn over the top of the canvas,
+// so erasing them is just a copy back from the clean image - moving the
+// cursor around never re-renders any of the project.
 class EditView : public ProjectListener
 {
 public:
@@ -36,9 +48,25 @@ public:
 
 	// these will all cause listener RedrawAll request
 	void Resize( int w, int h );
+	// zoom>=1 magnifies, zoom<=0 shrinks (0=1/2, -1=1/4 etc).
 	void SetZoom( int zoom );
     void SetFocus(NodePath const& focus);
     void SetFrame(int frame);
+    void SetOnionSkins(int n);
+    // Show the focus layer colour cycled, as it'd be t seconds after
+    // cycling started (t<0 to stop). Only pixels using the entries which
+    // change are redrawn.
+    void CycleColours(double t);
+
+    // Pick up a change to the project's retro mode (and pixel width).
+    void RetroModeChanged();
+
+    // Show a pre-rendered RGBA8PM image instead of the project (eg for
+    // animation playback). origin is its position in project coords.
+    // The image must stay valid until replaced. Pass null to go back to
+    // showing the project. Tools are disabled during playback.
+    void SetPlayback(Img const* img, Point const& origin);
+    bool InPlayback() const { return m_Playback != nullptr; }
 	void SetOffset( Point const& projpos );	// in project coord (pixels)
     void AlignView( Point const& viewp, Point const& projp );
     void CenterView();
@@ -47,6 +75,8 @@ public:
 	int Zoom() const { return m_Zoom; }
 	int XZoom() const { return m_XZoom; }
 	int YZoom() const { return m_YZoom; }
+	// log2 of the shrink factor when zoomed out (0=not shrunk)
+	int Shrink() const { return m_Shrink; }
     NodePath const& Focus() const {return m_Focus;}
     int Frame() const {return m_Frame;}
 
@@ -55,6 +85,12 @@ public:
 	void OnMouseUp( Point const& viewpos, Button button );
 
 	Img const& CanvasConst() const { return *m_Canvas; }
+	Img const& FrontConst() const { return *m_Front; }
+
+	// Swap the back and front canvases, then copy areas (which must cover
+	// everything drawn since the last Present) back to the new back
+	// canvas, so both are in sync again.
+	void Present( std::vector<Box> const& areas );
 	int Width() const { return m_ViewBox.w; }
 	int Height() const { return m_ViewBox.h; }
 
@@ -85,27 +121,46 @@ public:
 
     void EraseCursor();
 
+    // Cached zoomed brush, for drawing tool cursors.
+    CursorCache& BrushCursor() { return m_BrushCursor; }
+    void InvalidateCursorCache() { m_BrushCursor.Invalidate(); }
+
 
 protected:
     // Needs to be implemented by the GUI layer
     virtual void Redraw( Box const& b ) = 0;
+    // The canvases have been scrolled by (dx,dy) view pixels. The GUI
+    // should move whatever it's showing (and any areas it's yet to
+    // Present()) to match. Newly-exposed areas are passed to Redraw()
+    // afterward.
+    virtual void Scrolled( int dx, int dy ) = 0;
 private:
     Editor& m_Editor;   // the editor this view belongs to
 
     Point m_PrevPos;  // proj coords of last mouse action (-1,-1)=none
 
     // TODO: canvas should probably be held by the gui layer... (editviewwidget)
-	Img* m_Canvas;
+	Img* m_Canvas;  // back (project + tool cursors)
+	Img* m_Front;
+	Img* m_Clean;   // rendered project, without cursors
 	Box m_ViewBox;	// x,y always 0
 
     // current layer & frame being edited
     NodePath m_Focus;
     int m_Frame;
 
+    // all the visible layers, flattened (and cached)
+    Compositor m_Compositor;
+
+    // image to show instead of m_Compositor (or null)
+    Img const* m_Playback;
+    Point m_PlaybackOrigin;
+
 	int m_Zoom;
 	int m_XZoom;
 	int m_YZoom;
-	// In project coords
+	int m_Shrink;
+	// In project coords (a multiple of the shrink factor)
 	Point m_Offset;
 
 
@@ -115,8 +170,27 @@ private:
     // list of view rects affected by cursor drawing
     std::vector<Box> m_CursorDamage;
 
+    CursorCache m_BrushCursor;
+
+    ColourCycler m_Cycler;
+    void RedrawIndices(IndexOccupancy::Mask const& indices);
+
+    // attribute clash tracking for the focused image (null if no retro
+    // mode, or not indexed)
+    AttrClash* m_Clash;
+    void RethinkClash();
+    void DrawClashes(Box const& viewbox);
+
+    void CalcZoom();
+
     void DrawView( Box const& viewbox, Box* affectedview=0  );
+    void RestoreCanvas( Box const& viewbox, Box* affectedview=0 );
+    void ScrollView( Point const& prev );
     void ConfineView();
+    void AlignOffset();
+    Box PlaybackBound() const;
+    RGBA8 const* PlaybackSpan(int x, int y, int& count) const;
+    Box CompToView( Box const& compbox ) const;
 };
 
 
@@ -124,16 +198,16 @@ private:
 inline Point EditView::ViewToProj( Point const& viewpos ) const
 {
 	return Point(
-		viewpos.x/m_XZoom + m_Offset.x,
-		viewpos.y/m_YZoom + m_Offset.y
+		((viewpos.x/m_XZoom) << m_Shrink) + m_Offset.x,
+		((viewpos.y/m_YZoom) << m_Shrink) + m_Offset.y
 		);
 }
 
 inline Point EditView::ProjToView( Point const& projpos ) const
 {
 	return Point(
-		(projpos.x-m_Offset.x)*m_XZoom,
-		(projpos.y-m_Offset.y)*m_YZoom
+		((projpos.x-m_Offset.x) >> m_Shrink)*m_XZoom,
+		((projpos.y-m_Offset.y) >> m_Shrink)*m_YZoom
 		);
 }
 
@@ -141,16 +215,32 @@ inline Box EditView::ViewToProj( Box const& viewbox ) const
 {
     return Box(
         ViewToProj( viewbox.TopLeft() ),
-        viewbox.w/m_XZoom,
-        viewbox.h/m_YZoom );
+        (viewbox.w/m_XZoom) << m_Shrink,
+        (viewbox.h/m_YZoom) << m_Shrink );
 }
 
 inline Box EditView::ProjToView( Box const& projbox ) const
+{
+    if (m_Shrink == 0 || projbox.Empty()) {
+        return Box(
+            ProjToView( projbox.TopLeft() ),
+            projbox.w*m_XZoom,
+            projbox.h*m_YZoom );
+    }
+    // round outward
+    Point tl = ProjToView( projbox.TopLeft() );
+    Point br = ProjToView( Point(projbox.XMax(), projbox.YMax()) );
+    return Box( tl, (br.x - tl.x) + m_XZoom, (br.y - tl.y) + m_YZoom );
+}
+
+// composite coords are project coords, shrunk (and relative to the focus)
+inline Box EditView::CompToView( Box const& compbox ) const
 {
     return Box(
-        ProjToView( projbox.TopLeft() ),
-        projbox.w*m_XZoom,
-        projbox.h*m_YZoom );
+        (compbox.x - (m_Offset.x >> m_Shrink))*m_XZoom,
+        (compbox.y - (m_Offset.y >> m_Shrink))*m_YZoom,
+        compbox.w*m_XZoom,
+        compbox.h*m_YZoom );
 }
 
 
@@ -4,6 +4,7 @@
 #include "file_type.h"
 #include "exception.h"
 #include "img.h"
+#include "img_convert.h"
 #include "layer.h"
 #include "project.h"
 #include "util.h"
@@ -29,7 +30,7 @@ SaveRequirements CheckSave(Stack const& stack, Filetype ft)
         if (l->mFrames.size()>1) {
             isAnimated = true;
         }
-        if (l->Fmt() != FMT_I8) {
+        if (!FmtIsIndexed(l->Fmt())) {
             isIndexed = false;
         }
     }
@@ -54,6 +55,16 @@ void SaveLayer(Layer const& layer, std::string const& filename, ProjSettings con
 
     for (Frame const* frame : layer.mFrames) {
         Img const* img = frame->mImg;
+        // premultiplied alpha is only for internal use - save straight RGBA
+        // (and the packed formats are written as INDEX8)
+        Img* converted = nullptr;
+        if (img->Fmt() == FMT_RGBA8PM) {
+            converted = ConvertRGBA8PMtoRGBA8(*img);
+            img = converted;
+        } else if (FmtIsPacked(img->Fmt())) {
+            converted = ConvertPackedtoI8(*img);
+            img = converted;
+        }
         ImFmt fmt;
         switch (img->Fmt()) {
             // Our internal component ordering is set up to match QImage ARGB.
@@ -117,6 +128,7 @@ void SaveLayer(Layer const& layer, std::string const& filename, ProjSettings con
         }
 
         im_write_rows(writer, img->H(), img->PtrConst(0, 0), img->Pitch());
+        delete converted;
     }
 
     err = im_write_finish(writer);
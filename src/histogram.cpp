@@ -0,0 +1,113 @@
+#include "histogram.h"
+#include "img.h"
+#include "palette.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+// Keep RGB histograms down to roughly this many samples.
+static const int MAX_SAMPLES = 256 * 256;
+
+
+Histogram::Histogram(Img const& img) :
+    m_Fmt(img.Fmt()),
+    m_W(img.W()),
+    m_H(img.H()),
+    m_Step(1)
+{
+    std::fill(m_Index, m_Index + 256, 0);
+    if (!FmtIsIndexed(m_Fmt)) {
+        while ((m_W / m_Step) * (m_H / m_Step) > MAX_SAMPLES) {
+            m_Step *= 2;
+        }
+    }
+    Add(img, img.Bounds());
+}
+
+void Histogram::Count(Img const& img, Box const& area, int delta)
+{
+    assert(img.Fmt() == m_Fmt);
+    assert(img.W() == m_W && img.H() == m_H);
+    Box b(area);
+    b.ClipAgainst(img.Bounds());
+    if (b.Empty()) {
+        return;
+    }
+    switch (m_Fmt) {
+    case FMT_I8:
+        for (int y = b.YMin(); y <= b.YMax(); ++y) {
+            I8 const* p = img.PtrConst_I8(b.x, y);
+            for (int x = 0; x < b.w; ++x) {
+                m_Index[p[x]] += delta;
+            }
+        }
+        break;
+    case FMT_I4:
+    case FMT_I2:
+    case FMT_I1:
+        for (int y = b.YMin(); y <= b.YMax(); ++y) {
+            for (int x = b.XMin(); x <= b.XMax(); ++x) {
+                m_Index[img.GetIndex(x, y)] += delta;
+            }
+        }
+        break;
+    case FMT_RGBX8:
+    case FMT_RGBA8:
+    case FMT_RGBA8PM:
+        {
+            // only the pixels on the sample grid (in frame coords)
+            const int s = m_Step;
+            int x0 = ((b.XMin() + s - 1) / s) * s;
+            int y0 = ((b.YMin() + s - 1) / s) * s;
+            for (int y = y0; y <= b.YMax(); y += s) {
+                for (int x = x0; x <= b.XMax(); x += s) {
+                    RGBA8 c;
+                    if (m_Fmt == FMT_RGBX8) {
+                        c = RGBA8(*img.PtrConst_RGBX8(x, y));
+                    } else if (m_Fmt == FMT_RGBA8PM) {
+                        c = Unpremultiply(*img.PtrConst_RGBA8(x, y));
+                    } else {
+                        c = *img.PtrConst_RGBA8(x, y);
+                    }
+                    auto it = m_Colours.emplace(Key(c), 0).first;
+                    it->second += delta;
+                    if (it->second == 0) {
+                        m_Colours.erase(it);
+                    }
+                }
+            }
+        }
+        break;
+    default:
+        assert(false);
+        break;
+    }
+}
+
+int Histogram::NumUsed() const
+{
+    if (FmtIsIndexed(m_Fmt)) {
+        return (int)std::count_if(m_Index, m_Index + 256, [](int n) { return n > 0; });
+    }
+    return (int)m_Colours.size();
+}
+
+void Histogram::Colours(std::vector<std::pair<Colour, int>>& out, Palette const* pal) const
+{
+    if (FmtIsIndexed(m_Fmt)) {
+        assert(pal);
+        for (int i = 0; i < 256; ++i) {
+            if (m_Index[i] > 0) {
+                out.push_back(std::make_pair(pal->GetColour(i), m_Index[i]));
+            }
+        }
+        return;
+    }
+    const int scale = m_Step * m_Step;
+    for (auto const& e : m_Colours) {
+        uint32_t k = e.first;
+        Colour c((k >> 16) & 0xff, (k >> 8) & 0xff, k & 0xff, (k >> 24) & 0xff);
+        out.push_back(std::make_pair(c, e.second * scale));
+    }
+}
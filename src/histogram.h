@@ -0,0 +1,67 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "box.h"
+#include "colours.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Img;
+struct Palette;
+
+// Histogram counts how often each colour is used in a frame, so things
+// like palette cleanup and quantisation don't have to rescan the pixels.
+//
+// Indexed images have an exact count for each of the 256 indices.
+// RGB images use a hash of colours, sampled on a regular grid (every
+// SampleStep() pixels in each direction) so big images stay cheap.
+//
+// It's built once from the whole image, then kept up to date by
+// removing the old pixels of a changed area and adding the new ones
+// (Cmd_Draw does this). Frames cache one each (see Layer::ColourUsage()).
+class Histogram
+{
+public:
+    explicit Histogram(Img const& img);
+
+    PixelFormat Fmt() const { return m_Fmt; }
+
+    // Add or remove the pixels of area. img must be the whole frame (or
+    // the same size as it, eg an undo backup).
+    void Add(Img const& img, Box const& area) { Count(img, area, 1); }
+    void Remove(Img const& img, Box const& area) { Count(img, area, -1); }
+
+    // Indexed images only: number of pixels using index i.
+    int IndexCount(int i) const { return m_Index[i]; }
+
+    // How many different colours (or indices) are used.
+    // (For RGB images, only the sampled pixels are considered).
+    int NumUsed() const;
+
+    // All the colours used, with (estimated, for RGB) pixel counts.
+    // Indexed images need their palette to look up the colours. Indices
+    // which share a colour are reported separately.
+    void Colours(std::vector<std::pair<Colour, int>>& out, Palette const* pal = nullptr) const;
+
+    int SampleStep() const { return m_Step; }
+    // Is every pixel counted? (false for big RGB images, which are only
+    // sampled - fine for display, but rare colours can be missed).
+    bool Exact() const { return m_Step == 1; }
+
+private:
+    void Count(Img const& img, Box const& area, int delta);
+    static uint32_t Key(RGBA8 c) {
+        return ((uint32_t)c.a << 24) | ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+    }
+
+    PixelFormat m_Fmt;
+    int m_W;
+    int m_H;
+    int m_Step;     // sample spacing (RGB only)
+    int m_Index[256];
+    std::unordered_map<uint32_t, int> m_Colours;    // by Key()
+};
+
+#endif // HISTOGRAM_H
@@ -2,15 +2,94 @@
 #include "palette.h"
 //#include "draw.h"
 #include "blit.h"
+#include "blend.h"
 
 #include <cstring>
 #include <cstdio>
 #include <cassert>
 #include <algorithm>    // for reverse()
 
+
+// Helpers for the packed formats.
+// Pixel x of a packed row lives at bits [x*bits, (x+1)*bits), counting
+// from the msb of the first byte.
+
+// A byte filled with copies of idx.
+// (idx is masked to fit, as on the hardware)
+static uint8_t packedPattern(int bits, I8 idx)
+{
+    idx &= (1 << bits) - 1;
+    uint8_t pat = 0;
+    for (int i = 0; i < 8; i += bits) {
+        pat = (uint8_t)((pat << bits) | idx);
+    }
+    return pat;
+}
+
+// Set bits [begin,end) of row to the matching bits of pattern.
+static void fillBits(uint8_t* row, int begin, int end, uint8_t pattern)
+{
+    uint8_t* p = row + (begin >> 3);
+    uint8_t* last = row + ((end - 1) >> 3);
+    uint8_t headMask = (uint8_t)(0xff >> (begin & 7));
+    uint8_t tailMask = (uint8_t)(0xff << (7 - ((end - 1) & 7)));
+    if (p == last) {
+        uint8_t mask = headMask & tailMask;
+        *p = (uint8_t)((*p & ~mask) | (pattern & mask));
+        return;
+    }
+    *p = (uint8_t)((*p & ~headMask) | (pattern & headMask));
+    ++p;
+    if (last > p) {
+        memset(p, pattern, last - p);
+    }
+    *last = (uint8_t)((*last & ~tailMask) | (pattern & tailMask));
+}
+
+// Table to reverse the order of the pixels within a byte.
+static uint8_t const* packedReverseTable(int bits)
+{
+    struct Tables {
+        uint8_t t[3][256];  // for 1,2,4 bits
+        Tables() {
+            for (int b = 0; b < 3; ++b) {
+                int bits = 1 << b;
+                for (int v = 0; v < 256; ++v) {
+                    uint8_t out = 0;
+                    for (int i = 0; i < 8; i += bits) {
+                        int px = (v >> i) & ((1 << bits) - 1);
+                        out = (uint8_t)(out | (px << (8 - bits - i)));
+                    }
+                    t[b][v] = out;
+                }
+            }
+        }
+    };
+    static const Tables tables;
+    return tables.t[bits == 1 ? 0 : (bits == 2 ? 1 : 2)];
+}
+
+// Mirror the first nbits of a packed row.
+static void reverseBits(uint8_t* row, int nbytes, int nbits, int bits)
+{
+    uint8_t const* rev = packedReverseTable(bits);
+    std::reverse(row, row + nbytes);
+    for (int i = 0; i < nbytes; ++i) {
+        row[i] = rev[row[i]];
+    }
+    // the padding at the end is now at the start - shift it out.
+    int pad = nbytes * 8 - nbits;
+    if (pad > 0) {
+        for (int i = 0; i < nbytes - 1; ++i) {
+            row[i] = (uint8_t)((row[i] << pad) | (row[i + 1] >> (8 - pad)));
+        }
+        row[nbytes - 1] = (uint8_t)(row[nbytes - 1] << pad);
+    }
+}
+
 Img::Img( PixelFormat pixel_format, int w, int h, uint8_t const* initial ) :
     m_Format(pixel_format),
-    m_BytesPerPixel(0),
+    m_BitsPerPixel(0),
     m_BytesPerRow(0),
     m_Bounds(0,0,w,h),
     m_Pixels(0)
@@ -25,7 +104,7 @@ Img::Img( PixelFormat pixel_format, int w, int h, uint8_t const* initial ) :
 
 Img::Img( Img const& other ) :
     m_Format(other.m_Format),
-    m_BytesPerPixel(0),
+    m_BitsPerPixel(0),
     m_BytesPerRow(0),
     m_Bounds(other.m_Bounds),
     m_Pixels(0)
@@ -37,7 +116,7 @@ Img::Img( Img const& other ) :
 
 Img::Img( Img const& other, Box const& otherarea ) :
     m_Format(other.m_Format),
-    m_BytesPerPixel(0),
+    m_BitsPerPixel(0),
     m_BytesPerRow(0),
     m_Bounds(0,0,otherarea.w,otherarea.h),
     m_Pixels(0)
@@ -53,14 +132,10 @@ void Img::init()
 {
     assert(m_Bounds.x==0 && m_Bounds.y==0);
 
-    switch(m_Format)
-    {
-        case FMT_I8: m_BytesPerPixel=1; break;
-        case FMT_RGBX8: m_BytesPerPixel=4; break;
-        case FMT_RGBA8: m_BytesPerPixel=4; break;
-    }
-    assert(m_BytesPerPixel>0);
-    m_BytesPerRow = m_Bounds.w*m_BytesPerPixel;
+    m_BitsPerPixel = FmtBits(m_Format);
+    assert(m_BitsPerPixel>0);
+    // (packed formats round rows up to whole bytes)
+    m_BytesPerRow = (m_Bounds.w*m_BitsPerPixel + 7) / 8;
     m_Pixels = new uint8_t[m_BytesPerRow*m_Bounds.h];
 }
 
@@ -78,31 +153,31 @@ void Img::Copy( Img const& other )
 
 void Img::HLine( PenColour const& pen, int xbegin, int xend, int y)
 {
-    int x;
+    if( xend <= xbegin )
+        return;
     switch(Fmt())
     {
         case FMT_I8:
-            {
-                assert(pen.IdxValid());
-                I8* dest = Ptr_I8(xbegin,y);
-                for( x=xbegin; x<xend; ++x )
-                    *dest++ = pen.idx();
-            }
+            assert(pen.IdxValid());
+            std::fill( Ptr_I8(xbegin,y), Ptr_I8(xbegin,y) + (xend-xbegin), (I8)pen.idx() );
             break;
         case FMT_RGBX8:
-            {
-                RGBX8* dest = Ptr_RGBX8(xbegin,y);
-                for( x=xbegin; x<xend; ++x )
-                    *dest++ = pen.rgb();
-            }
+            std::fill( Ptr_RGBX8(xbegin,y), Ptr_RGBX8(xbegin,y) + (xend-xbegin), pen.toRGBX8() );
             break;
         case FMT_RGBA8:
-            {
-                // XYZZY: blending!
-                RGBA8* dest = Ptr_RGBA8(xbegin,y);
-                for( x=xbegin; x<xend; ++x )
-                    *dest++ = pen.rgb();
-            }
+            // (replaces - see BlendHLine() for compositing)
+            std::fill( Ptr_RGBA8(xbegin,y), Ptr_RGBA8(xbegin,y) + (xend-xbegin), pen.toRGBA8() );
+            break;
+        case FMT_RGBA8PM:
+            std::fill( Ptr_RGBA8(xbegin,y), Ptr_RGBA8(xbegin,y) + (xend-xbegin), pen.toRGBA8PM() );
+            break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            // (indices which don't fit are masked - see packedPattern())
+            assert(pen.IdxValid());
+            fillBits( Ptr(0,y), xbegin*m_BitsPerPixel, xend*m_BitsPerPixel,
+                packedPattern(m_BitsPerPixel, (I8)pen.idx()) );
             break;
         default: assert(false); // not implemented
     }
@@ -119,6 +194,37 @@ void Img::FillBox( PenColour const& pen, Box& b )
 }
 
 
+void Img::BlendHLine( PenColour const& pen, int xbegin, int xend, int y)
+{
+    if( xend <= xbegin )
+        return;
+    switch(Fmt())
+    {
+        case FMT_RGBX8:
+            BlendFill( pen.toRGBA8(), Ptr_RGBX8(xbegin,y), xend-xbegin );
+            break;
+        case FMT_RGBA8:
+            BlendFill( pen.toRGBA8(), Ptr_RGBA8(xbegin,y), xend-xbegin );
+            break;
+        case FMT_RGBA8PM:
+            BlendFillPM( pen.toRGBA8PM(), Ptr_RGBA8(xbegin,y), xend-xbegin );
+            break;
+        default:
+            HLine(pen, xbegin, xend, y);
+            break;
+    }
+}
+
+
+void Img::BlendBox( PenColour const& pen, Box& b )
+{
+    b.ClipAgainst( Bounds() );
+    int y;
+    for( y=b.YMin(); y<=b.YMax(); ++y )
+        BlendHLine(pen,b.XMin(),b.XMax()+1,y);
+}
+
+
 void Img::XFlip()
 {
     int y;
@@ -139,11 +245,17 @@ void Img::XFlip()
             }
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:
             {
                 RGBA8* begin = Ptr_RGBA8(0,y);
                 std::reverse(begin,begin+W());
             }
             break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            reverseBits(Ptr(0,y), m_BytesPerRow, W()*m_BitsPerPixel, m_BitsPerPixel);
+            break;
         default: assert(false); // not implemented
         }
     }
@@ -171,12 +283,22 @@ void Img::YFlip()
             }
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:
             {
                 RGBA8* a = Ptr_RGBA8(0,y);
                 RGBA8* b = Ptr_RGBA8(0,(H()-1)-y);
                 std::swap_ranges(a,a+W(),b);
             }
             break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            {
+                uint8_t* a = Ptr(0,y);
+                uint8_t* b = Ptr(0,(H()-1)-y);
+                std::swap_ranges(a,a+m_BytesPerRow,b);
+            }
+            break;
         default: assert(false); // not implemented
         }
     }
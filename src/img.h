@@ -11,6 +11,12 @@ struct Palette;
 
 
 
+// Img is a block of pixels in one of the PixelFormats.
+//
+// The packed indexed formats (FMT_I4, FMT_I2, FMT_I1) store several
+// pixels in each byte, and every row starts on a byte boundary. There's no
+// per-pixel pointer access for them - use GetIndex()/SetIndex(), or work on
+// whole bytes via Ptr() (which returns the byte holding pixel x).
 class Img
 {
 public:
@@ -22,9 +28,10 @@ public:
     // disallowed (use Copy() instead!)
     Img& operator=( Img const& other );
 
-	~Img()
+	virtual ~Img()
 		{ delete [] m_Pixels; }
     PixelFormat Fmt() const { return m_Format; }
+    int BitsPerPixel() const { return m_BitsPerPixel; }
 	int W() const
 		{ return m_Bounds.w; }
 	int H() const
@@ -40,16 +47,17 @@ public:
 	RGBX8 const* PtrConst_RGBX8( int x, int y ) const
 		{ assert(Fmt()==FMT_RGBX8); return (RGBX8*)PtrConst(x,y); }
 
+    // (FMT_RGBA8PM too - it's up to the caller to know which it's got)
 	RGBA8* Ptr_RGBA8( int x, int y )
-		{ assert(Fmt()==FMT_RGBA8); return (RGBA8*)Ptr(x,y); }
+		{ assert(Fmt()==FMT_RGBA8 || Fmt()==FMT_RGBA8PM); return (RGBA8*)Ptr(x,y); }
 	RGBA8 const* PtrConst_RGBA8( int x, int y ) const
-		{ assert(Fmt()==FMT_RGBA8); return (RGBA8*)PtrConst(x,y); }
+		{ assert(Fmt()==FMT_RGBA8 || Fmt()==FMT_RGBA8PM); return (RGBA8*)PtrConst(x,y); }
 
     // Raw access.
 	uint8_t* Ptr( int x, int y )
-		{ return m_Pixels + (y*m_BytesPerRow) + (x*m_BytesPerPixel); }
+		{ return m_Pixels + (y*m_BytesPerRow) + ((x*m_BitsPerPixel)>>3); }
 	uint8_t const* PtrConst( int x, int y ) const
-		{ return m_Pixels + (y*m_BytesPerRow) + (x*m_BytesPerPixel); }
+		{ return m_Pixels + (y*m_BytesPerRow) + ((x*m_BitsPerPixel)>>3); }
     int Pitch() const
         { return m_BytesPerRow; }
 
@@ -62,10 +70,15 @@ public:
     void Copy( Img const& other );
     // b will return area affected after clipping.
 	void FillBox( PenColour const& pen, Box& b );
+    // As HLine()/FillBox(), but compositing the pen colour over the
+    // existing pixels, using its alpha (indexed formats just replace).
+    void BlendHLine( PenColour const& pen, int xbegin, int xend, int y);
+    void BlendBox( PenColour const& pen, Box& b );
     void OutlineBox( PenColour const& pen, Box& b );
 
-    void XFlip();
-    void YFlip();
+    // (virtual, so Brush can keep its runs up to date)
+    virtual void XFlip();
+    virtual void YFlip();
 
     // helpers to get single pixel
 	RGBX8 Get_RGBX8( const Point& p ) const
@@ -75,12 +88,16 @@ public:
 	I8 Get_I8( const Point& p ) const
 		{ return *PtrConst_I8(p.x,p.y); }
 
+    // Single pixel access for any indexed format (I8 or packed).
+    I8 GetIndex( int x, int y ) const;
+    void SetIndex( int x, int y, I8 idx );
+
 
 protected:
     void init();
 
     PixelFormat m_Format;
-    int m_BytesPerPixel;
+    int m_BitsPerPixel;
     int m_BytesPerRow;
     Box m_Bounds;
 	uint8_t* m_Pixels;
@@ -88,6 +105,32 @@ private:
 };
 
 
+inline I8 Img::GetIndex( int x, int y ) const
+{
+    if (m_Format == FMT_I8) {
+        return *PtrConst_I8(x,y);
+    }
+    assert(FmtIsPacked(m_Format));
+    int shift = 8 - m_BitsPerPixel - ((x*m_BitsPerPixel) & 7);
+    return (I8)((*PtrConst(x,y) >> shift) & ((1<<m_BitsPerPixel)-1));
+}
+
+inline void Img::SetIndex( int x, int y, I8 idx )
+{
+    if (m_Format == FMT_I8) {
+        *Ptr_I8(x,y) = idx;
+        return;
+    }
+    assert(FmtIsPacked(m_Format));
+    // indices which don't fit are masked, as on the hardware
+    idx &= (1<<m_BitsPerPixel)-1;
+    int shift = 8 - m_BitsPerPixel - ((x*m_BitsPerPixel) & 7);
+    uint8_t mask = (uint8_t)(((1<<m_BitsPerPixel)-1) << shift);
+    uint8_t* p = Ptr(x,y);
+    *p = (uint8_t)((*p & ~mask) | (idx << shift));
+}
+
+
 
 #endif // IMG_H
 
@@ -1,34 +1,40 @@
+#include "img_convert.h"
+#include "colourmatch.h"
 #include "colours.h"
+#include "blend.h"
 #include "img.h"
 #include "palette.h"
+#include <algorithm>
 #include <cassert>
 
 
-Img* ConvertRGBA8toI8(Img const& srcImg, Palette const& destPalette) {
+Img* ConvertRGBA8toI8(Img const& srcImg, Palette const& destPalette, ColourMetric metric) {
     assert(srcImg.Fmt() == FMT_RGBA8);
     Img* destImg = new Img(FMT_I8, srcImg.W(), srcImg.H());
+    ColourMatcher matcher(destPalette, metric);
 
     for (int y=0; y<srcImg.H(); ++y) {
         const RGBA8 *src = srcImg.PtrConst_RGBA8(0,y);
         I8 *dest = destImg->Ptr_I8(0,y);
         for (int x=0; x<srcImg.W(); ++x) {
 
-            *dest++ = (I8)destPalette.Closest(Colour(*src));
+            *dest++ = (I8)matcher.Closest(Colour(*src));
             ++src;
         }
     }
     return destImg;
 }
 
-Img* ConvertRGBX8toI8(Img const& srcImg, Palette const& destPalette) {
+Img* ConvertRGBX8toI8(Img const& srcImg, Palette const& destPalette, ColourMetric metric) {
     assert(srcImg.Fmt() == FMT_RGBX8);
     Img* destImg = new Img(FMT_I8, srcImg.W(), srcImg.H());
+    ColourMatcher matcher(destPalette, metric);
 
     for (int y=0; y<srcImg.H(); ++y) {
         const RGBX8 *src = srcImg.PtrConst_RGBX8(0,y);
         I8 *dest = destImg->Ptr_I8(0,y);
         for (int x=0; x<srcImg.W(); ++x) {
-            *dest++ = (I8)destPalette.Closest(Colour(*src));
+            *dest++ = (I8)matcher.Closest(Colour(*src));
             ++src;
         }
     }
@@ -98,42 +104,150 @@ Img* ConvertRGBX8toRGBA8(Img const& srcImg) {
 
 
 
-Img* ConvertI8toI8(Img const& srcImg, Palette const& srcPalette, Palette const& destPalette) {
-    assert(srcImg.Fmt() == FMT_I8);
-    Img* destImg = new Img(FMT_I8, srcImg.W(), srcImg.H());
+Img* ConvertRGBA8toRGBA8PM(Img const& srcImg) {
+    assert(srcImg.Fmt() == FMT_RGBA8);
+    Img* destImg = new Img(FMT_RGBA8PM, srcImg.W(), srcImg.H());
 
     for (int y=0; y<srcImg.H(); ++y) {
-        const I8 *src = srcImg.PtrConst_I8(0,y);
-        I8 *dest = destImg->Ptr_I8(0,y);
-        for (int x=0; x<srcImg.W(); ++x) {
-            Colour c = srcPalette.GetColour((int)*src++);
-            *dest++ = (I8)destPalette.Closest(c);
+        PremultiplySpan(srcImg.PtrConst_RGBA8(0,y), destImg->Ptr_RGBA8(0,y), srcImg.W());
+    }
+    return destImg;
+}
+
+Img* ConvertRGBA8PMtoRGBA8(Img const& srcImg) {
+    assert(srcImg.Fmt() == FMT_RGBA8PM);
+    Img* destImg = new Img(FMT_RGBA8, srcImg.W(), srcImg.H());
+
+    for (int y=0; y<srcImg.H(); ++y) {
+        UnpremultiplySpan(srcImg.PtrConst_RGBA8(0,y), destImg->Ptr_RGBA8(0,y), srcImg.W());
+    }
+    return destImg;
+}
+
+Img* ConvertI8toPacked(Img const& srcImg, PixelFormat destFmt) {
+    assert(srcImg.Fmt() == FMT_I8);
+    assert(FmtIsPacked(destFmt));
+    Img* destImg = new Img(destFmt, srcImg.W(), srcImg.H());
+    PackArea(srcImg, *destImg, Point(0, 0));
+    return destImg;
+}
+
+Img* ConvertPackedtoI8(Img const& srcImg) {
+    assert(FmtIsPacked(srcImg.Fmt()));
+    return UnpackArea(srcImg, srcImg.Bounds());
+}
+
+Img* UnpackArea(Img const& srcImg, Box const& area) {
+    assert(FmtIsPacked(srcImg.Fmt()));
+    assert(srcImg.Bounds().Contains(area) || area.Empty());
+    Img* destImg = new Img(FMT_I8, area.w, area.h);
+    const int bits = srcImg.BitsPerPixel();
+    const uint8_t mask = (uint8_t)((1 << bits) - 1);
+
+    for (int y = 0; y < area.h; ++y) {
+        uint8_t const* src = srcImg.PtrConst(0, area.y + y);
+        I8* dest = destImg->Ptr_I8(0, y);
+        int bit = area.x * bits;
+        for (int x = 0; x < area.w; ++x, bit += bits) {
+            *dest++ = (src[bit >> 3] >> (8 - bits - (bit & 7))) & mask;
         }
     }
     return destImg;
 }
 
+void PackArea(Img const& srcImg, Img& destImg, Point const& destPos) {
+    assert(srcImg.Fmt() == FMT_I8);
+    assert(FmtIsPacked(destImg.Fmt()));
+    Box area(destPos, srcImg.W(), srcImg.H());
+    assert(destImg.Bounds().Contains(area) || area.Empty());
+    const int bits = destImg.BitsPerPixel();
+    const uint8_t mask = (uint8_t)((1 << bits) - 1);
+    const int perByte = 8 / bits;
 
-void RemapI8(Img& img, Palette const& srcPalette, Palette const& destPalette)
+    for (int y = 0; y < area.h; ++y) {
+        I8 const* src = srcImg.PtrConst_I8(0, y);
+        uint8_t* dest = destImg.Ptr(0, area.y + y);
+        int x = 0;
+        int bit = area.x * bits;
+        // odd pixels up to the first whole byte
+        for (; x < area.w && (bit & 7); ++x, bit += bits) {
+            int shift = 8 - bits - (bit & 7);
+            uint8_t& b = dest[bit >> 3];
+            b = (uint8_t)((b & ~(mask << shift)) | ((*src++ & mask) << shift));
+        }
+        // whole bytes
+        for (; x + perByte <= area.w; x += perByte, bit += 8) {
+            uint8_t b = 0;
+            for (int i = 0; i < perByte; ++i) {
+                b = (uint8_t)((b << bits) | (*src++ & mask));
+            }
+            dest[bit >> 3] = b;
+        }
+        // leftovers
+        for (; x < area.w; ++x, bit += bits) {
+            int shift = 8 - bits - (bit & 7);
+            uint8_t& b = dest[bit >> 3];
+            b = (uint8_t)((b & ~(mask << shift)) | ((*src++ & mask) << shift));
+        }
+    }
+}
+
+
+Img* ConvertI8toI8(Img const& srcImg, Palette const& srcPalette, Palette const& destPalette, ColourMetric metric) {
+    assert(srcImg.Fmt() == FMT_I8);
+    Img* destImg = new Img(srcImg);
+    RemapI8(*destImg, srcPalette, destPalette, metric);
+    return destImg;
+}
+
+
+void RemapI8(Img& img, Palette const& srcPalette, Palette const& destPalette, ColourMetric metric)
+{
+    assert(img.Fmt() == FMT_I8);
+    I8 lut[256];
+    BuildRemapLUT(srcPalette, destPalette, lut, metric);
+    ApplyIndexLUT(img, lut);
+}
+
+void BuildRemapLUT(Palette const& srcPalette, Palette const& destPalette, I8* lut, ColourMetric metric)
+{
+    ColourMatcher matcher(destPalette, metric);
+    for (int i = 0; i < 256; ++i) {
+        lut[i] = (I8)matcher.Closest(srcPalette.GetColour(i));
+    }
+}
+
+void ApplyIndexLUT(Img& img, I8 const* lut)
 {
     assert(img.Fmt() == FMT_I8);
+    const int w = img.W();
     for (int y = 0; y < img.H(); ++y) {
         I8* p = img.Ptr_I8(0, y);
-        for (int x = 0; x < img.W(); ++x) {
-            Colour c = srcPalette.GetColour((int)*p);
-            *p = (I8)destPalette.Closest(c);
-            ++p;
+        int x = 0;
+        for (; x + 4 <= w; x += 4) {
+            I8 a = lut[p[x]];
+            I8 b = lut[p[x + 1]];
+            I8 c = lut[p[x + 2]];
+            I8 d = lut[p[x + 3]];
+            p[x] = a;
+            p[x + 1] = b;
+            p[x + 2] = c;
+            p[x + 3] = d;
+        }
+        for (; x < w; ++x) {
+            p[x] = lut[p[x]];
         }
     }
 }
 
-void RemapRGBX8(Img& img, Palette const& destPalette)
+void RemapRGBX8(Img& img, Palette const& destPalette, ColourMetric metric)
 {
     assert(img.Fmt() == FMT_RGBX8);
+    ColourMatcher matcher(destPalette, metric);
     for (int y = 0; y < img.H(); ++y) {
         RGBX8 *p = img.Ptr_RGBX8(0, y);
         for (int x=0; x < img.W(); ++x) {
-            I8 best = (I8)destPalette.Closest(Colour(*p));
+            I8 best = (I8)matcher.Closest(Colour(*p));
             *p = destPalette.GetColour((int)best);
             ++p;
         }
@@ -141,16 +255,104 @@ void RemapRGBX8(Img& img, Palette const& destPalette)
 }
 
 
-void RemapRGBA8(Img& img, Palette const& destPalette)
+void RemapRGBA8(Img& img, Palette const& destPalette, ColourMetric metric)
 {
     assert(img.Fmt() == FMT_RGBA8);
+    ColourMatcher matcher(destPalette, metric);
     for (int y = 0; y < img.H(); ++y) {
         RGBA8 *p = img.Ptr_RGBA8(0, y);
         for (int x=0; x < img.W(); ++x) {
-            I8 best = (I8)destPalette.Closest(Colour(*p));
+            I8 best = (I8)matcher.Closest(Colour(*p));
             *p = destPalette.GetColour((int)best);
             ++p;
         }
     }
 }
 
+
+Img* ConvertImg(Img const& srcImg, PixelFormat newFmt,
+    Palette const& srcPalette, Palette const& destPalette)
+{
+    // The packed formats go via I8.
+    if (FmtIsPacked(srcImg.Fmt())) {
+        Img* unpacked = ConvertPackedtoI8(srcImg);
+        Img* destImg = ConvertImg(*unpacked, newFmt, srcPalette, destPalette);
+        delete unpacked;
+        return destImg;
+    }
+    if (FmtIsPacked(newFmt)) {
+        // only the colours which fit can be used
+        Palette usable(destPalette);
+        usable.SetNumColours(std::min(usable.NumColours(), 1 << FmtBits(newFmt)));
+        Img* unpacked = ConvertImg(srcImg, FMT_I8, srcPalette, usable);
+        Img* destImg = ConvertI8toPacked(*unpacked, newFmt);
+        delete unpacked;
+        return destImg;
+    }
+
+    Img* destImg = nullptr;
+    switch (srcImg.Fmt()) {
+    case FMT_I8:
+        if (newFmt == FMT_I8) {
+            destImg = new Img(srcImg);
+            RemapI8(*destImg, srcPalette, destPalette);
+        } else if (newFmt == FMT_RGBX8) {
+            destImg = ConvertI8toRGBX8(srcImg, srcPalette);
+        } else if (newFmt == FMT_RGBA8) {
+            destImg = ConvertI8toRGBA8(srcImg, srcPalette);
+        } else if (newFmt == FMT_RGBA8PM) {
+            Img* straight = ConvertI8toRGBA8(srcImg, srcPalette);
+            destImg = ConvertRGBA8toRGBA8PM(*straight);
+            delete straight;
+        }
+        break;
+    case FMT_RGBX8:
+        if(newFmt == FMT_I8) {
+            destImg = ConvertRGBX8toI8(srcImg, destPalette);
+        } else if (newFmt == FMT_RGBX8) {
+            destImg = new Img(srcImg);
+            RemapRGBX8(*destImg, destPalette);
+        } else if (newFmt == FMT_RGBA8) {
+            destImg = ConvertRGBX8toRGBA8(srcImg);
+        } else if (newFmt == FMT_RGBA8PM) {
+            Img* straight = ConvertRGBX8toRGBA8(srcImg);
+            destImg = ConvertRGBA8toRGBA8PM(*straight);
+            delete straight;
+        }
+        break;
+    case FMT_RGBA8:
+        if(newFmt == FMT_I8) {
+            destImg = ConvertRGBA8toI8(srcImg, destPalette);
+        } else if (newFmt == FMT_RGBX8) {
+            destImg = ConvertRGBA8toRGBX8(srcImg);
+        } else if (newFmt == FMT_RGBA8) {
+            destImg = new Img(srcImg);
+            RemapRGBA8(*destImg, destPalette);
+        } else if (newFmt == FMT_RGBA8PM) {
+            destImg = ConvertRGBA8toRGBA8PM(srcImg);
+        }
+        break;
+    case FMT_RGBA8PM:
+        {
+            // (via straight RGBA8)
+            Img* straight = ConvertRGBA8PMtoRGBA8(srcImg);
+            if(newFmt == FMT_I8) {
+                destImg = ConvertRGBA8toI8(*straight, destPalette);
+            } else if (newFmt == FMT_RGBX8) {
+                destImg = ConvertRGBA8toRGBX8(*straight);
+            } else if (newFmt == FMT_RGBA8) {
+                destImg = straight;
+                straight = nullptr;
+            } else if (newFmt == FMT_RGBA8PM) {
+                RemapRGBA8(*straight, destPalette);
+                destImg = ConvertRGBA8toRGBA8PM(*straight);
+            }
+            delete straight;
+        }
+        break;
+    default:
+        break;
+    }
+    assert(destImg);
+    return destImg;
+}
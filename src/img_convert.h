@@ -1,14 +1,21 @@
 #ifndef IMG_CONVERT_H
 #define IMG_CONVERT_H
 
-class Img;
+#include "box.h"
+#include "colourmatch.h"
+#include "colours.h"
+#include "img.h"
+
 class Palette;
 
 // Helper functions to convert images into different formats.
 
+// The functions which pick colours from a palette use metric to decide
+// which colour is closest (perceptual by default).
+
 // these two potentially lossy (remaps to destPalette);
-Img* ConvertRGBA8toI8(Img const& srcImg, Palette const& destPalette);
-Img* ConvertRGBX8toI8(Img const& srcImg, Palette const& destPalette);
+Img* ConvertRGBA8toI8(Img const& srcImg, Palette const& destPalette, ColourMetric metric = METRIC_OKLAB);
+Img* ConvertRGBX8toI8(Img const& srcImg, Palette const& destPalette, ColourMetric metric = METRIC_OKLAB);
 
 // these two non-lossy
 Img* ConvertI8toRGBX8(Img const& srcImg, Palette const& srcPalette);
@@ -20,14 +27,66 @@ Img* ConvertRGBX8toRGBA8(Img const& srcImg);
 // this one trashes the alpha channel
 Img* ConvertRGBA8toRGBX8(Img const& srcImg);
 
+// Between straight and premultiplied alpha (FMT_RGBA8 <-> FMT_RGBA8PM).
+// Premultiplying loses some precision at low alpha.
+Img* ConvertRGBA8toRGBA8PM(Img const& srcImg);
+Img* ConvertRGBA8PMtoRGBA8(Img const& srcImg);
+
+// Convert any format to any other, going via I8 for the packed formats.
+// srcPalette is used to read indexed source images, destPalette to pick
+// colours for indexed results (for a packed result, only the colours which
+// fit). Returns a new image.
+Img* ConvertImg(Img const& srcImg, PixelFormat newFmt, Palette const& srcPalette, Palette const& destPalette);
+
+// Pack an I8 image into one of the packed formats (FMT_I4, FMT_I2, FMT_I1).
+// Indices which don't fit are masked (eg 17 becomes 1 in FMT_I4), just as
+// they would be on the hardware.
+Img* ConvertI8toPacked(Img const& srcImg, PixelFormat destFmt);
+
+// Unpack a packed image to I8.
+Img* ConvertPackedtoI8(Img const& srcImg);
+
+// As above, but for part of an image. Code which only knows about I8 uses
+// these to work on packed images (see WithUnpacked()).
+Img* UnpackArea(Img const& srcImg, Box const& area);
+void PackArea(Img const& srcImg, Img& destImg, Point const& destPos);
+
+// Run fn(tmp, tmpbox) on an I8 copy of area of a packed image, then pack
+// the result back into it. tmpbox is box, moved to match the copy; any
+// changes fn makes to it (eg clipping) are passed back out in box.
+template<typename FN>
+void WithUnpacked(Img& packed, Box const& area, Box& box, FN fn)
+{
+    Box clipped(area);
+    clipped.ClipAgainst(packed.Bounds());
+    if (clipped.Empty()) {
+        box = clipped;
+        return;
+    }
+    Img* tmp = UnpackArea(packed, clipped);
+    Point off = clipped.TopLeft();
+    Box tmpbox(box.x - off.x, box.y - off.y, box.w, box.h);
+    fn(*tmp, tmpbox);
+    PackArea(*tmp, packed, off);
+    box = Box(tmpbox.x + off.x, tmpbox.y + off.y, tmpbox.w, tmpbox.h);
+    delete tmp;
+}
+
 // Remap I8 to destPalette.
-void RemapI8(Img& img, Palette const& srcPalette, Palette const& destPalette);
+void RemapI8(Img& img, Palette const& srcPalette, Palette const& destPalette, ColourMetric metric = METRIC_OKLAB);
+
+// Build a 256-entry lookup table mapping each index in srcPalette to the
+// closest one in destPalette (as used by RemapI8()).
+void BuildRemapLUT(Palette const& srcPalette, Palette const& destPalette, I8* lut, ColourMetric metric = METRIC_OKLAB);
+
+// Replace every pixel of an I8 image with lut[pixel].
+void ApplyIndexLUT(Img& img, I8 const* lut);
 
 // Remap an RGBX8 to destPalette (picks the closest colours in destPalette).
-void RemapRGBX8(Img& img, Palette const& destPalette);
+void RemapRGBX8(Img& img, Palette const& destPalette, ColourMetric metric = METRIC_OKLAB);
 
 // Remap an RGBA8 to destPalette (picks the closest colours in destPalette).
-void RemapRGBA8(Img& img, Palette const& destPalette);
+void RemapRGBA8(Img& img, Palette const& destPalette, ColourMetric metric = METRIC_OKLAB);
 
 #endif // IMG_CONVERT_H
 
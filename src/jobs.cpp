@@ -0,0 +1,180 @@
+#include "jobs.h"
+
+#include <cassert>
+#include <chrono>
+
+// set for threads owned by a JobPool
+static thread_local bool onWorkerThread = false;
+
+
+Job::Job() :
+    m_Cancelled(false),
+    m_Done(0),
+    m_Total(0)
+{
+}
+
+
+JobPool::JobPool(int numThreads) :
+    m_Queued(0),
+    m_Quit(false),
+    m_Next(0)
+{
+    if (numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+        if (numThreads <= 0) {
+            numThreads = 1;
+        }
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        m_Queues.push_back(new Queue());
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        m_Workers.push_back(std::thread(&JobPool::Run, this, i));
+    }
+}
+
+JobPool::~JobPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Quit = true;
+    }
+    m_Wake.notify_all();
+    for (auto& t : m_Workers) {
+        t.join();
+    }
+    for (auto q : m_Queues) {
+        assert(q->tasks.empty());
+        delete q;
+    }
+}
+
+// static
+JobPool& JobPool::Shared()
+{
+    static JobPool pool;
+    return pool;
+}
+
+void JobPool::ParallelFor(int count, std::function<void(int)> const& fn, Job* job)
+{
+    if (count <= 0) {
+        return;
+    }
+    if (job) {
+        job->m_Total += count;
+    }
+
+    Batch batch;
+    batch.fn = &fn;
+    batch.job = job;
+    batch.pending = count;
+
+    // deal out the tasks
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (int i = 0; i < count; ++i) {
+            Queue& q = *m_Queues[m_Next];
+            m_Next = (m_Next + 1) % (int)m_Queues.size();
+            std::lock_guard<std::mutex> qlock(q.mutex);
+            q.tasks.push_back(Task{&batch, i});
+        }
+        m_Queued += count;
+    }
+    m_Wake.notify_all();
+
+    bool polling = job && job->m_Poll;
+    if (!polling) {
+        // lend a hand
+        Task task;
+        while (Take(-1, task)) {
+            Execute(task);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    while (batch.pending > 0) {
+        if (polling) {
+            batch.finished.wait_for(lock, std::chrono::milliseconds(50));
+            if (batch.pending > 0) {
+                lock.unlock();
+                job->m_Poll();
+                lock.lock();
+            }
+        } else {
+            batch.finished.wait(lock);
+        }
+    }
+}
+
+// static
+bool JobPool::OnWorkerThread()
+{
+    return onWorkerThread;
+}
+
+void JobPool::Run(int worker)
+{
+    onWorkerThread = true;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Wake.wait(lock, [this] { return m_Quit || m_Queued > 0; });
+            if (m_Quit) {
+                return;
+            }
+        }
+        Task task;
+        while (Take(worker, task)) {
+            Execute(task);
+        }
+    }
+}
+
+// Grab a task - from the back of our own queue if possible, otherwise
+// steal one from the front of someone else's.
+// worker = -1 for threads which aren't part of the pool.
+bool JobPool::Take(int worker, Task& task)
+{
+    const int n = (int)m_Queues.size();
+    if (worker >= 0) {
+        Queue& q = *m_Queues[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+            --m_Queued;
+            return true;
+        }
+    }
+    int start = (worker >= 0) ? worker + 1 : 0;
+    for (int i = 0; i < n; ++i) {
+        Queue& q = *m_Queues[(start + i) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            --m_Queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobPool::Execute(Task const& task)
+{
+    Batch& b = *task.batch;
+    if (!b.job || !b.job->Cancelled()) {
+        (*b.fn)(task.index);
+    }
+    if (b.job) {
+        ++b.job->m_Done;
+    }
+    // (notify with the lock held - the batch lives on the waiter's stack,
+    // and vanishes as soon as it sees pending hit zero)
+    std::lock_guard<std::mutex> lock(b.mutex);
+    if (--b.pending == 0) {
+        b.finished.notify_all();
+    }
+}
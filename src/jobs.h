@@ -0,0 +1,117 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Job tracks the progress of some work being done on the JobPool, and
+// lets it be cancelled.
+//
+// A Job can be passed to several ParallelFor() calls (eg Cmd_Remap does the
+// frames, then the spare frame). Total() grows as work is added.
+//
+// Cancellation just stops any tasks which haven't started yet from being
+// run. ParallelFor() still returns normally, so the caller has to check
+// Cancelled() and throw away its (partial) results.
+class Job
+{
+public:
+    Job();
+
+    // Set a function to be called every so often (on the waiting thread)
+    // while ParallelFor() waits for the tasks to finish. The GUI uses this
+    // to update a progress bar and pick up cancel requests.
+    void SetPoll(std::function<void()> const& poll) { m_Poll = poll; }
+
+    void Cancel() { m_Cancelled = true; }
+    bool Cancelled() const { return m_Cancelled; }
+
+    int Done() const { return m_Done; }
+    int Total() const { return m_Total; }
+
+private:
+    Job(Job const&);    // disallowed
+    friend class JobPool;
+
+    std::function<void()> m_Poll;
+    std::atomic<bool> m_Cancelled;
+    std::atomic<int> m_Done;
+    std::atomic<int> m_Total;
+};
+
+
+// JobPool is a pool of worker threads, for splitting up big chunks of work
+// (eg per-frame processing of a whole animation).
+//
+// Each worker has its own queue. Tasks are dealt out round-robin, and a
+// worker which runs out of tasks steals from the front of the others'
+// queues, so uneven tasks (eg frames of different sizes) still balance out.
+//
+// Tasks must not touch the GUI, or call Project notification functions -
+// they should just build data for a Cmd, which the GUI thread then applies
+// (and notifies about) as usual.
+class JobPool
+{
+public:
+    // numThreads = 0 means one per core.
+    explicit JobPool(int numThreads = 0);
+    ~JobPool();
+
+    // The pool used by Cmds.
+    static JobPool& Shared();
+
+    // Run fn(0)...fn(count-1), spread over the pool, and wait until they've
+    // all finished. Calls can't overlap on the same index, but fn must be
+    // safe to run concurrently for different indices.
+    // If job is set, it is used to report progress, poll and cancel.
+    // Without a poll function, the calling thread helps run the tasks.
+    void ParallelFor(int count, std::function<void(int)> const& fn, Job* job = nullptr);
+
+    // Is the calling thread one of the workers of any JobPool?
+    // Code which might be called from within a task can use this to avoid
+    // splitting its work up again and oversubscribing the cores.
+    static bool OnWorkerThread();
+
+private:
+    JobPool(JobPool const&);    // disallowed
+
+    // all the tasks of a single ParallelFor() call
+    struct Batch {
+        std::function<void(int)> const* fn;
+        Job* job;
+        int pending;                // guarded by mutex
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    struct Task {
+        Batch* batch;
+        int index;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Run(int worker);
+    bool Take(int worker, Task& task);
+    void Execute(Task const& task);
+
+    std::vector<std::thread> m_Workers;
+    std::vector<Queue*> m_Queues;
+
+    // workers sleep on m_Wake until there are tasks queued
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::atomic<int> m_Queued;
+    bool m_Quit;    // guarded by m_Mutex
+    int m_Next;     // next queue to deal a task to (guarded by m_Mutex)
+};
+
+#endif // JOBS_H
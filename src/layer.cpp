@@ -1,6 +1,7 @@
 #include <cassert>
 
 #include "layer.h"
+#include "histogram.h"
 #include "img.h"
 #include "exception.h"
 #include "util.h"
@@ -65,6 +66,7 @@ void Layer::ZapFrames()
         delete mFrames.back();
         mFrames.pop_back();
     }
+    InvalidateFrameTimes();
 }
 
 /*
@@ -98,18 +100,27 @@ Box Layer::Bounds() const
     return bound;
 }
 
-int Layer::FrameIndexClipped(uint64_t t) const
+void Layer::CalcFrameTimes() const
 {
-    assert(!mFrames.empty());
+    if (mFrameTimes.size() == mFrames.size() + 1) {
+        return;     // still valid
+    }
+    mFrameTimes.resize(mFrames.size() + 1);
     uint64_t accum = 0;
-    int idx = 0;
-    for (auto f : mFrames) {
-        accum += f->mDuration;
-        if (t < accum) {
-            break;
-        }
-        ++idx;
+    for (size_t i = 0; i < mFrames.size(); ++i) {
+        mFrameTimes[i] = accum;
+        accum += mFrames[i]->mDuration;
     }
+    mFrameTimes.back() = accum;
+}
+
+int Layer::FrameIndexClipped(uint64_t t) const
+{
+    assert(!mFrames.empty());
+    CalcFrameTimes();
+    // first frame which ends after t
+    auto it = std::upper_bound(mFrameTimes.begin() + 1, mFrameTimes.end(), t);
+    int idx = (int)(it - (mFrameTimes.begin() + 1));
     // clip to last frame.
     if (idx >= (int)mFrames.size()) {
         idx = (int)mFrames.size() - 1;
@@ -120,11 +131,52 @@ int Layer::FrameIndexClipped(uint64_t t) const
 uint64_t Layer::FrameTime(int frame) const
 {
     assert(frame < (int)mFrames.size());
-    uint64_t t = 0;
-    for (int i=0; i<frame; ++i) {
-        t += mFrames[i]->mDuration;
+    if (frame < 0) {
+        return 0;   // SPARE_FRAME
+    }
+    CalcFrameTimes();
+    return mFrameTimes[frame];
+}
+
+uint64_t Layer::TotalTime() const
+{
+    CalcFrameTimes();
+    return mFrameTimes.back();
+}
+
+Frame::~Frame()
+{
+    delete mUsage;
+    delete mImg;
+}
+
+Histogram const& Layer::ColourUsage(int n)
+{
+    Frame* f = (n == SPARE_FRAME) ? mSpare : mFrames[n];
+    assert(f);
+    if (!f->mUsage) {
+        f->mUsage = new Histogram(*f->mImg);
+    }
+    return *f->mUsage;
+}
+
+Histogram* Layer::CachedColourUsage(int n)
+{
+    Frame* f = (n == SPARE_FRAME) ? mSpare : mFrames[n];
+    assert(f);
+    return f->mUsage;
+}
+
+void Layer::IndexUsage(std::vector<int>& counts)
+{
+    assert(FmtIsIndexed(Fmt()));
+    counts.assign(256, 0);
+    for (int n = 0; n < NumFrames(); ++n) {
+        Histogram const& h = ColourUsage(n);
+        for (int i = 0; i < 256; ++i) {
+            counts[i] += h.IndexCount(i);
+        }
     }
-    return t;
 }
 
 void Layer::EnsureSpareFrame(int templateFrame)
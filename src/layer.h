@@ -13,6 +13,7 @@
 #include "ranges.h"
 #include "sheet.h"
 
+class Histogram;
 class Layer;
 class Stack;
 
@@ -137,10 +138,14 @@ public:
     int mDuration;
     // Can have per-frame palette
     // Palette mPalette;
-
-    Frame(Img* img, int duration) : mImg(img), mDuration(duration) {}
-    Frame() : mImg(nullptr), mDuration(0) {}
-    ~Frame() { delete mImg; }
+    // Cached colour usage (null until asked for - see Layer::ColourUsage())
+    Histogram* mUsage;
+
+    Frame(Img* img, int duration) : mImg(img), mDuration(duration), mUsage(nullptr) {}
+    Frame() : mImg(nullptr), mDuration(0), mUsage(nullptr) {}
+    // Copies are usually given a new image, so the usage isn't copied.
+    Frame(Frame const& other) : mImg(other.mImg), mDuration(other.mDuration), mUsage(nullptr) {}
+    ~Frame();
 };
 
 
@@ -184,6 +189,7 @@ public:
         f->mDuration = 1000000/mFPS;
         f->mImg = img;
         mFrames.push_back(f);
+        InvalidateFrameTimes();
     }
     void ZapFrames();
 
@@ -207,6 +213,25 @@ public:
     // Calculate start time of frame (in microseconds).
     uint64_t FrameTime(int frame) const;
 
+    // Running time of the whole animation (in microseconds).
+    uint64_t TotalTime() const;
+
+    // The frame timings are cached, so this must be called after
+    // changing mFrames or any frame's mDuration.
+    void InvalidateFrameTimes() { mFrameTimes.clear(); }
+
+
+    // Colour usage of frame n, built the first time it's asked for.
+    // It's kept up to date by Cmd_Draw, so it reflects the committed
+    // image - it'll be off if built while a tool is part-way through
+    // drawing on the frame.
+    Histogram const& ColourUsage(int n);
+    // The usage of frame n if it's been built, otherwise null (for
+    // keeping it up to date without building it needlessly).
+    Histogram* CachedColourUsage(int n);
+    // Indexed layers only: total pixels using each index, over all frames
+    // (excluding SPARE_FRAME). counts is resized to 256.
+    void IndexUsage(std::vector<int>& counts);
 
     // Make sure SPARE_FRAME, creating it if it doesn't.
     // The dimensions are taken from templateFrame.
@@ -223,6 +248,12 @@ public:
 
     std::string mFilename;
 
+private:
+    void CalcFrameTimes() const;
+
+    // Start time of each frame, plus the total time at the end (so
+    // mFrames.size()+1 entries). Empty when it needs recalculating.
+    mutable std::vector<uint64_t> mFrameTimes;
 };
 
 #endif // LAYER_H
@@ -0,0 +1,213 @@
+#include "mipmap.h"
+#include "img.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+// most common of four indices (ties go to the earliest)
+static inline I8 mode4(I8 a, I8 b, I8 c, I8 d)
+{
+    if (a == b || a == c || a == d) {
+        return a;
+    }
+    if (b == c || b == d) {
+        return b;
+    }
+    if (c == d) {
+        return c;
+    }
+    return a;
+}
+
+static inline RGBX8 avg4(RGBX8 a, RGBX8 b, RGBX8 c, RGBX8 d)
+{
+    return RGBX8(
+        (a.r + b.r + c.r + d.r + 2) / 4,
+        (a.g + b.g + c.g + d.g + 2) / 4,
+        (a.b + b.b + c.b + d.b + 2) / 4);
+}
+
+// premultiplied, so it's a plain average (transparent pixels carry no
+// colour, and so don't darken the result)
+static inline RGBA8 avg4(RGBA8 a, RGBA8 b, RGBA8 c, RGBA8 d)
+{
+    return RGBA8(
+        (a.r + b.r + c.r + d.r + 2) / 4,
+        (a.g + b.g + c.g + d.g + 2) / 4,
+        (a.b + b.b + c.b + d.b + 2) / 4,
+        (a.a + b.a + c.a + d.a + 2) / 4);
+}
+
+
+PixelFormat MipFmt(PixelFormat srcFmt)
+{
+    if (FmtIsPacked(srcFmt)) {
+        return FMT_I8;
+    }
+    return (srcFmt == FMT_RGBA8) ? FMT_RGBA8PM : srcFmt;
+}
+
+void Downsample(Img const& src, Img& dest, Box const& area)
+{
+    assert(src.Fmt() == dest.Fmt() || dest.Fmt() == MipFmt(src.Fmt()));
+    assert(dest.Bounds().Contains(area));
+    int xlast = src.W() - 1;
+    int ylast = src.H() - 1;
+
+    for (int y = area.YMin(); y <= area.YMax(); ++y) {
+        int sy0 = std::min(y * 2, ylast);
+        int sy1 = std::min(y * 2 + 1, ylast);
+        switch (src.Fmt()) {
+        case FMT_I8:
+            {
+                I8 const* s0 = src.PtrConst_I8(0, sy0);
+                I8 const* s1 = src.PtrConst_I8(0, sy1);
+                I8* d = dest.Ptr_I8(area.x, y);
+                for (int x = area.XMin(); x <= area.XMax(); ++x) {
+                    int sx0 = std::min(x * 2, xlast);
+                    int sx1 = std::min(x * 2 + 1, xlast);
+                    *d++ = mode4(s0[sx0], s0[sx1], s1[sx0], s1[sx1]);
+                }
+            }
+            break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            {
+                I8* d = dest.Ptr_I8(area.x, y);
+                for (int x = area.XMin(); x <= area.XMax(); ++x) {
+                    int sx0 = std::min(x * 2, xlast);
+                    int sx1 = std::min(x * 2 + 1, xlast);
+                    *d++ = mode4(src.GetIndex(sx0, sy0), src.GetIndex(sx1, sy0),
+                        src.GetIndex(sx0, sy1), src.GetIndex(sx1, sy1));
+                }
+            }
+            break;
+        case FMT_RGBX8:
+            {
+                RGBX8 const* s0 = src.PtrConst_RGBX8(0, sy0);
+                RGBX8 const* s1 = src.PtrConst_RGBX8(0, sy1);
+                RGBX8* d = dest.Ptr_RGBX8(area.x, y);
+                for (int x = area.XMin(); x <= area.XMax(); ++x) {
+                    int sx0 = std::min(x * 2, xlast);
+                    int sx1 = std::min(x * 2 + 1, xlast);
+                    *d++ = avg4(s0[sx0], s0[sx1], s1[sx0], s1[sx1]);
+                }
+            }
+            break;
+        case FMT_RGBA8:
+            {
+                RGBA8 const* s0 = src.PtrConst_RGBA8(0, sy0);
+                RGBA8 const* s1 = src.PtrConst_RGBA8(0, sy1);
+                RGBA8* d = dest.Ptr_RGBA8(area.x, y);
+                for (int x = area.XMin(); x <= area.XMax(); ++x) {
+                    int sx0 = std::min(x * 2, xlast);
+                    int sx1 = std::min(x * 2 + 1, xlast);
+                    *d++ = avg4(Premultiply(s0[sx0]), Premultiply(s0[sx1]),
+                        Premultiply(s1[sx0]), Premultiply(s1[sx1]));
+                }
+            }
+            break;
+        case FMT_RGBA8PM:
+            {
+                RGBA8 const* s0 = src.PtrConst_RGBA8(0, sy0);
+                RGBA8 const* s1 = src.PtrConst_RGBA8(0, sy1);
+                RGBA8* d = dest.Ptr_RGBA8(area.x, y);
+                for (int x = area.XMin(); x <= area.XMax(); ++x) {
+                    int sx0 = std::min(x * 2, xlast);
+                    int sx1 = std::min(x * 2 + 1, xlast);
+                    *d++ = avg4(s0[sx0], s0[sx1], s1[sx0], s1[sx1]);
+                }
+            }
+            break;
+        default:
+            assert(false);
+            break;
+        }
+    }
+}
+
+
+MipPyramid::MipPyramid()
+{
+}
+
+MipPyramid::~MipPyramid()
+{
+    for (auto& l : m_Levels) {
+        delete l.img;
+    }
+}
+
+Img const& MipPyramid::Level(Img const& src, int n)
+{
+    assert(n >= 1);
+    // add any missing levels (all dirty)
+    while ((int)m_Levels.size() < n) {
+        Img const& prev = m_Levels.empty() ? src : *m_Levels.back().img;
+        Mip l;
+        l.img = new Img(MipFmt(src.Fmt()), (prev.W() + 1) / 2, (prev.H() + 1) / 2);
+        l.cols = (l.img->W() + TILE_SIZE - 1) / TILE_SIZE;
+        l.rows = (l.img->H() + TILE_SIZE - 1) / TILE_SIZE;
+        l.dirty.assign(l.cols * l.rows, true);
+        l.numDirty = l.cols * l.rows;
+        m_Levels.push_back(l);
+    }
+    // each level is built from the one below it
+    for (int k = 1; k <= n; ++k) {
+        if (m_Levels[k - 1].numDirty > 0) {
+            Update(src, k);
+        }
+    }
+    return *m_Levels[n - 1].img;
+}
+
+// Rebuild the dirty tiles of level n.
+void MipPyramid::Update(Img const& src, int n)
+{
+    Mip& l = m_Levels[n - 1];
+    Img const& prev = (n == 1) ? src : *m_Levels[n - 2].img;
+    for (int row = 0; row < l.rows; ++row) {
+        for (int col = 0; col < l.cols; ++col) {
+            if (!l.dirty[row * l.cols + col]) {
+                continue;
+            }
+            Box area(col * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+            area.ClipAgainst(l.img->Bounds());
+            Downsample(prev, *l.img, area);
+            l.dirty[row * l.cols + col] = false;
+        }
+    }
+    l.numDirty = 0;
+}
+
+void MipPyramid::Damage(Box const& dmg)
+{
+    if (dmg.Empty() || dmg.XMax() < 0 || dmg.YMax() < 0) {
+        return;
+    }
+    int x0 = std::max(dmg.XMin(), 0);
+    int y0 = std::max(dmg.YMin(), 0);
+    int x1 = dmg.XMax();
+    int y1 = dmg.YMax();
+    for (auto& l : m_Levels) {
+        // the area affected shrinks with each level
+        x0 /= 2;
+        y0 /= 2;
+        x1 /= 2;
+        y1 /= 2;
+        int c0 = x0 / TILE_SIZE;
+        int r0 = y0 / TILE_SIZE;
+        int c1 = std::min(x1 / TILE_SIZE, l.cols - 1);
+        int r1 = std::min(y1 / TILE_SIZE, l.rows - 1);
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                if (!l.dirty[r * l.cols + c]) {
+                    l.dirty[r * l.cols + c] = true;
+                    ++l.numDirty;
+                }
+            }
+        }
+    }
+}
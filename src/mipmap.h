@@ -0,0 +1,61 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "box.h"
+#include "colours.h"
+
+#include <vector>
+
+class Img;
+
+// MipPyramid holds successively halved versions of an image, for drawing
+// it zoomed out.
+// RGB images are box filtered, indexed images use the most common
+// index in each 2x2 block (so no new colours are introduced).
+// RGBA levels are always premultiplied (see MipFmt()), so filtering is a
+// straight average with no per-pixel divide. Packed indexed levels are
+// unpacked to I8.
+//
+// Levels are built lazily, and damage is tracked per tile, so only the
+// parts of the pyramid above a change need to be recalculated. Each
+// level keeps a count of its dirty tiles, so fetching a level which is
+// already up to date (ie every tile drawn between edits) costs nothing.
+class MipPyramid
+{
+public:
+    enum { TILE_SIZE = 64 };
+
+    MipPyramid();
+    ~MipPyramid();
+
+    // Fetch level n (1=half size, 2=quarter size etc) of src.
+    // src is the full-size image, which must be the same one each time
+    // (or at least the same format and size).
+    Img const& Level(Img const& src, int n);
+
+    // An area of the full-size image has changed.
+    void Damage(Box const& dmg);
+
+private:
+    MipPyramid(MipPyramid const&);  // disallowed
+
+    struct Mip {
+        Img* img {nullptr};
+        int cols {0};
+        int rows {0};
+        std::vector<bool> dirty;    // per tile
+        int numDirty {0};           // so clean levels can be skipped
+    };
+
+    void Update(Img const& src, int n);
+    std::vector<Mip> m_Levels;    // [0] is level 1
+};
+
+// The format mip levels of a srcFmt image are held in.
+PixelFormat MipFmt(PixelFormat srcFmt);
+
+// Halve an area of src into dest (area is in dest coords).
+// dest must be in MipFmt(src.Fmt()) (or the same format as src).
+void Downsample(Img const& src, Img& dest, Box const& area);
+
+#endif // MIPMAP_H
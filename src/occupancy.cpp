@@ -0,0 +1,105 @@
+#include "occupancy.h"
+#include "img.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+IndexOccupancy::IndexOccupancy() :
+    m_W(0),
+    m_H(0),
+    m_Cols(0),
+    m_Rows(0),
+    m_AnyStale(false)
+{
+}
+
+void IndexOccupancy::Damage(Box const& dmg)
+{
+    Box b(dmg);
+    b.ClipAgainst(Box(0, 0, m_W, m_H));
+    if (b.Empty()) {
+        return;
+    }
+    int c0 = b.XMin() / TILE_SIZE;
+    int c1 = b.XMax() / TILE_SIZE;
+    int r0 = b.YMin() / TILE_SIZE;
+    int r1 = b.YMax() / TILE_SIZE;
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            m_Stale[r * m_Cols + c] = true;
+        }
+    }
+    m_AnyStale = true;
+}
+
+void IndexOccupancy::Find(Img const& img, Mask const& indices, std::vector<Box>& out)
+{
+    assert(FmtIsIndexed(img.Fmt()));
+    if (!indices.Any()) {
+        return;
+    }
+    Update(img);
+    for (int r = 0; r < m_Rows; ++r) {
+        int c = 0;
+        while (c < m_Cols) {
+            if (!m_Masks[r * m_Cols + c].Intersects(indices)) {
+                ++c;
+                continue;
+            }
+            int start = c;
+            while (c < m_Cols && m_Masks[r * m_Cols + c].Intersects(indices)) {
+                ++c;
+            }
+            Box b(start * TILE_SIZE, r * TILE_SIZE, (c - start) * TILE_SIZE, TILE_SIZE);
+            b.ClipAgainst(img.Bounds());
+            out.push_back(b);
+        }
+    }
+}
+
+// Bring all the stale tile masks up to date.
+void IndexOccupancy::Update(Img const& img)
+{
+    if (img.W() != m_W || img.H() != m_H) {
+        m_W = img.W();
+        m_H = img.H();
+        m_Cols = (m_W + TILE_SIZE - 1) / TILE_SIZE;
+        m_Rows = (m_H + TILE_SIZE - 1) / TILE_SIZE;
+        m_Masks.resize(m_Cols * m_Rows);
+        m_Stale.assign(m_Cols * m_Rows, true);
+        m_AnyStale = true;
+    }
+    if (!m_AnyStale) {
+        return;
+    }
+    for (int r = 0; r < m_Rows; ++r) {
+        for (int c = 0; c < m_Cols; ++c) {
+            if (m_Stale[r * m_Cols + c]) {
+                Scan(img, c, r);
+                m_Stale[r * m_Cols + c] = false;
+            }
+        }
+    }
+    m_AnyStale = false;
+}
+
+void IndexOccupancy::Scan(Img const& img, int col, int row)
+{
+    Box area(col * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    area.ClipAgainst(img.Bounds());
+    Mask m;
+    for (int y = area.YMin(); y <= area.YMax(); ++y) {
+        if (img.Fmt() == FMT_I8) {
+            I8 const* p = img.PtrConst_I8(area.x, y);
+            for (int x = 0; x < area.w; ++x) {
+                m.Set(p[x]);
+            }
+        } else {
+            for (int x = area.XMin(); x <= area.XMax(); ++x) {
+                m.Set(img.GetIndex(x, y));
+            }
+        }
+    }
+    m_Masks[row * m_Cols + col] = m;
+}
@@ -0,0 +1,60 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include "box.h"
+
+#include <cstdint>
+#include <vector>
+
+class Img;
+
+// IndexOccupancy records which palette indices occur in each tile of an
+// indexed image, so a change to a single palette entry need only redraw
+// the tiles which actually use it.
+//
+// Tile masks are built lazily, and damage just marks the tiles it touches
+// as stale, so painting doesn't pay for rescans it might never need.
+class IndexOccupancy
+{
+public:
+    enum { TILE_SIZE = 64 };
+
+    // 256-bit set, one bit per index
+    struct Mask {
+        uint64_t bits[4] {0, 0, 0, 0};
+        void Set(int i) { bits[i >> 6] |= uint64_t(1) << (i & 63); }
+        bool Has(int i) const { return (bits[i >> 6] >> (i & 63)) & 1; }
+        bool Any() const { return (bits[0] | bits[1] | bits[2] | bits[3]) != 0; }
+        bool Intersects(Mask const& other) const {
+            return ((bits[0] & other.bits[0]) | (bits[1] & other.bits[1]) |
+                (bits[2] & other.bits[2]) | (bits[3] & other.bits[3])) != 0;
+        }
+    };
+
+    IndexOccupancy();
+
+    // An area of the image has changed.
+    void Damage(Box const& dmg);
+
+    // Find the tiles of img which contain any of indices, and append their
+    // areas (in img coords) to out. Horizontally adjacent tiles are merged.
+    // img must be indexed, and the same one each time (or at least the same
+    // size).
+    void Find(Img const& img, Mask const& indices, std::vector<Box>& out);
+
+private:
+    IndexOccupancy(IndexOccupancy const&);  // disallowed
+
+    void Update(Img const& img);
+    void Scan(Img const& img, int col, int row);
+
+    int m_W;
+    int m_H;
+    int m_Cols;
+    int m_Rows;
+    std::vector<Mask> m_Masks;
+    std::vector<bool> m_Stale;  // per tile
+    bool m_AnyStale;
+};
+
+#endif // OCCUPANCY_H
@@ -0,0 +1,178 @@
+#include "onionskin.h"
+#include "img.h"
+#include "palette.h"
+#include "project.h"
+
+#include <cassert>
+
+
+// how strongly the onion skins show through
+static const int ONION_ALPHA = 128;
+
+static const RGBA8 tintBefore(255, 32, 32, 255);
+static const RGBA8 tintAfter(32, 255, 32, 255);
+
+// tint a straight colour, returning it premultiplied
+static inline RGBA8 tint(RGBA8 c, RGBA8 t)
+{
+    return Premultiply(RGBA8(
+        (c.r + t.r) / 2,
+        (c.g + t.g) / 2,
+        (c.b + t.b) / 2,
+        (c.a * ONION_ALPHA) / 255));
+}
+
+
+OnionSkins::OnionSkins(Project const& proj) :
+    m_Proj(proj)
+{
+}
+
+OnionSkins::~OnionSkins()
+{
+    Clear();
+}
+
+void OnionSkins::SetLayer(NodePath const& layer)
+{
+    if (layer != m_Layer) {
+        Clear();
+        m_Layer = layer;
+    }
+}
+
+Img const& OnionSkins::Fetch(int frame, int dir)
+{
+    Entry& e = m_Cache[Key(frame, dir)];
+    Img const& src = m_Proj.GetImgConst(m_Layer, frame);
+    if (!e.img) {
+        e.img = new Img(FMT_RGBA8PM, src.W(), src.H());
+        e.dirty = src.Bounds();
+    }
+    if (!e.dirty.Empty()) {
+        Tint(frame, dir, *e.img, e.dirty);
+        e.dirty.SetEmpty();
+    }
+    return *e.img;
+}
+
+void OnionSkins::Damage(int frame, Box const& dmg)
+{
+    for (int dir = -1; dir <= 1; dir += 2) {
+        auto it = m_Cache.find(Key(frame, dir));
+        if (it == m_Cache.end()) {
+            continue;
+        }
+        Entry& e = it->second;
+        Box b(dmg);
+        b.ClipAgainst(e.img->Bounds());
+        if (e.dirty.Empty()) {
+            e.dirty = b;
+        } else if (!b.Empty()) {
+            e.dirty.Merge(b);
+        }
+    }
+}
+
+void OnionSkins::Drop(int first, int count)
+{
+    auto it = m_Cache.begin();
+    while (it != m_Cache.end()) {
+        int frame = it->first.first;
+        if (frame >= first && frame < first + count) {
+            delete it->second.img;
+            it = m_Cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void OnionSkins::Prune(int lo, int hi)
+{
+    auto it = m_Cache.begin();
+    while (it != m_Cache.end()) {
+        int frame = it->first.first;
+        if (frame < lo || frame > hi) {
+            delete it->second.img;
+            it = m_Cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void OnionSkins::Clear()
+{
+    for (auto& it : m_Cache) {
+        delete it.second.img;
+    }
+    m_Cache.clear();
+}
+
+// Convert an area of a frame into its tinted form.
+void OnionSkins::Tint(int frame, int dir, Img& dest, Box const& area) const
+{
+    Img const& src = m_Proj.GetImgConst(m_Layer, frame);
+    assert(src.Bounds().Contains(area));
+    assert(dest.Bounds().Contains(area));
+    RGBA8 t = (dir < 0) ? tintBefore : tintAfter;
+
+    switch (src.Fmt()) {
+    case FMT_I8:
+    case FMT_I4:
+    case FMT_I2:
+    case FMT_I1:
+        {
+            Palette const& pal = m_Proj.PaletteConst(m_Layer, frame);
+            RGBA8 lut[256];
+            for (int i = 0; i < 256; ++i) {
+                lut[i] = tint(pal.GetColour(i), t);
+            }
+            for (int y = area.YMin(); y <= area.YMax(); ++y) {
+                RGBA8* d = dest.Ptr_RGBA8(area.x, y);
+                if (src.Fmt() == FMT_I8) {
+                    I8 const* s = src.PtrConst_I8(area.x, y);
+                    for (int x = 0; x < area.w; ++x) {
+                        d[x] = lut[s[x]];
+                    }
+                } else {
+                    for (int x = 0; x < area.w; ++x) {
+                        d[x] = lut[src.GetIndex(area.x + x, y)];
+                    }
+                }
+            }
+        }
+        break;
+    case FMT_RGBX8:
+        for (int y = area.YMin(); y <= area.YMax(); ++y) {
+            RGBX8 const* s = src.PtrConst_RGBX8(area.x, y);
+            RGBA8* d = dest.Ptr_RGBA8(area.x, y);
+            for (int x = 0; x < area.w; ++x) {
+                d[x] = tint(RGBA8(s[x]), t);
+            }
+        }
+        break;
+    case FMT_RGBA8:
+        for (int y = area.YMin(); y <= area.YMax(); ++y) {
+            RGBA8 const* s = src.PtrConst_RGBA8(area.x, y);
+            RGBA8* d = dest.Ptr_RGBA8(area.x, y);
+            for (int x = 0; x < area.w; ++x) {
+                d[x] = tint(s[x], t);
+            }
+        }
+        break;
+    case FMT_RGBA8PM:
+        for (int y = area.YMin(); y <= area.YMax(); ++y) {
+            RGBA8 const* s = src.PtrConst_RGBA8(area.x, y);
+            RGBA8* d = dest.Ptr_RGBA8(area.x, y);
+            for (int x = 0; x < area.w; ++x) {
+                d[x] = tint(Unpremultiply(s[x]), t);
+            }
+        }
+        break;
+    default:
+        assert(false);
+        break;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef ONIONSKIN_H
+#define ONIONSKIN_H
+
+#include "box.h"
+#include "layer.h"
+
+#include <map>
+#include <utility>
+
+class Img;
+class Project;
+
+// OnionSkins holds tinted, semi-transparent RGBA8PM copies of the frames
+// of a single layer, ready to be blended over the frame being edited.
+//
+// Frames before the current one are tinted red, frames after it green.
+// Tinted frames are kept across frame changes, so scrubbing back and
+// forth doesn't rebuild them. Only frames which are damaged are
+// re-tinted (and only the damaged area).
+class OnionSkins
+{
+public:
+    OnionSkins(Project const& proj);
+    ~OnionSkins();
+
+    // Set the layer to take frames from (discards cache if it changes).
+    void SetLayer(NodePath const& layer);
+
+    // Fetch the tinted version of a frame.
+    // dir is -1 for a frame before the current one, +1 for after.
+    Img const& Fetch(int frame, int dir);
+
+    // An area of a frame has changed.
+    void Damage(int frame, Box const& dmg);
+
+    // Discard cached frames in the range [first, first+count).
+    void Drop(int first, int count);
+
+    // Discard cached frames outside [lo, hi].
+    void Prune(int lo, int hi);
+
+    // Discard everything.
+    void Clear();
+
+private:
+    OnionSkins(OnionSkins const&);  // disallowed
+
+    struct Entry {
+        Img* img {nullptr};
+        Box dirty {0, 0, 0, 0};     // area needing re-tinting
+    };
+    typedef std::pair<int, int> Key;    // frame, dir
+
+    void Tint(int frame, int dir, Img& dest, Box const& area) const;
+
+    Project const& m_Proj;
+    NodePath m_Layer;
+    std::map<Key, Entry> m_Cache;
+};
+
+#endif // ONIONSKIN_H
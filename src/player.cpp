@@ -0,0 +1,298 @@
+#include "player.h"
+#include "compositor.h"
+#include "img.h"
+#include "project.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+// Is frame a before frame b (allowing for wraparound)?
+static bool isBehind(int a, int b, int numFrames)
+{
+    int dist = (b - a + numFrames) % numFrames;
+    return dist > 0 && dist <= numFrames / 2;
+}
+
+
+Player::Player(Project& proj, NodePath const& layer) :
+    m_Proj(proj),
+    m_Layer(layer),
+    m_Dropped(0),
+    m_FPSCount(0),
+    m_FPS(0.0f),
+    m_Quit(false),
+    m_Generation(0),
+    m_NextRender(0),
+    m_Head(0),
+    m_Count(0)
+{
+    m_Proj.AddListener(this);
+}
+
+Player::~Player()
+{
+    Stop();
+    m_Proj.RemoveListener(this);
+}
+
+void Player::Start(int frame)
+{
+    Stop();
+    Layer const& l = m_Proj.ResolveLayer(m_Layer);
+    assert(frame >= 0 && frame < l.NumFrames());
+
+    Clock::time_point now = Clock::now();
+    m_Start = now - std::chrono::microseconds(l.FrameTime(frame));
+    m_Current = Slot();
+    m_Dropped = 0;
+    m_FPSCount = 0;
+    m_FPSStart = now;
+    m_FPS = 0.0f;
+
+    m_Quit = false;
+    m_NextRender = frame;
+    m_Head = 0;
+    m_Count = 0;
+    m_Worker = std::thread(&Player::Run, this);
+}
+
+void Player::Stop()
+{
+    if (!m_Worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Quit = true;
+    }
+    m_Wake.notify_all();
+    m_Worker.join();
+
+    // no other thread now, so no need to lock
+    for (int i = 0; i < m_Count; ++i) {
+        delete m_Ring[(m_Head + i) % RING_SIZE].img;
+    }
+    m_Count = 0;
+    for (auto img : m_Free) {
+        delete img;
+    }
+    m_Free.clear();
+    delete m_Current.img;
+    m_Current = Slot();
+}
+
+Img const* Player::Poll(int& frame, Point& origin)
+{
+    assert(Playing());
+    Clock::time_point now = Clock::now();
+    int n;
+    int want;
+    {
+        // the layer's frame timings are shared with the worker
+        std::lock_guard<std::recursive_mutex> projLock(m_Proj.Mutex());
+        Layer const& l = m_Proj.ResolveLayer(m_Layer);
+        n = l.NumFrames();
+        uint64_t total = l.TotalTime();
+        if (total == 0) {
+            return nullptr;
+        }
+        uint64_t t = std::chrono::duration_cast<std::chrono::microseconds>(now - m_Start).count();
+        want = l.FrameIndexClipped(t % total);
+    }
+    if (want == m_Current.frame) {
+        return nullptr;
+    }
+
+    Slot got;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        // discard anything which is now too late to show
+        while (m_Count > 0) {
+            Slot& s = m_Ring[m_Head];
+            if (s.frame == want) {
+                got = s;
+            } else if (!isBehind(s.frame, want, n)) {
+                break;
+            }
+            if (got.img != s.img) {
+                Recycle(s.img);
+            }
+            m_Head = (m_Head + 1) % RING_SIZE;
+            --m_Count;
+            if (got.img) {
+                break;
+            }
+        }
+        if (got.img) {
+            Recycle(m_Current.img);
+        }
+    }
+    m_Wake.notify_all();
+    if (!got.img) {
+        // not rendered yet - keep showing the current frame
+        return nullptr;
+    }
+
+    if (m_Current.frame >= 0) {
+        m_Dropped += ((want - m_Current.frame + n) % n) - 1;
+    }
+    m_Current = got;
+
+    ++m_FPSCount;
+    float secs = std::chrono::duration<float>(now - m_FPSStart).count();
+    if (secs >= 1.0f) {
+        m_FPS = m_FPSCount / secs;
+        m_FPSCount = 0;
+        m_FPSStart = now;
+    }
+
+    frame = m_Current.frame;
+    origin = m_Current.origin;
+    return m_Current.img;
+}
+
+// Caller must hold m_Mutex.
+void Player::Recycle(Img* img)
+{
+    if (img) {
+        m_Free.push_back(img);
+    }
+}
+
+// Throw away any frames rendered so far (caller must be the GUI thread).
+void Player::Flush()
+{
+    if (!Playing()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        ++m_Generation;
+        while (m_Count > 0) {
+            Recycle(m_Ring[m_Head].img);
+            m_Head = (m_Head + 1) % RING_SIZE;
+            --m_Count;
+        }
+        m_NextRender = std::max(m_Current.frame, 0);
+    }
+    // make sure the current frame gets redisplayed
+    m_Current.frame = -1;
+    m_Wake.notify_all();
+}
+
+
+// The worker thread.
+void Player::Run()
+{
+    Compositor comp(m_Proj);
+    int64_t renderTime = 0;     // how long the last frame took (microsecs)
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true) {
+        m_Wake.wait(lock, [this]() { return m_Quit || m_Count < RING_SIZE; });
+        if (m_Quit) {
+            break;
+        }
+        int gen = m_Generation;
+        int frame = m_NextRender;
+        Img* img = nullptr;
+        if (!m_Free.empty()) {
+            img = m_Free.back();
+            m_Free.pop_back();
+        }
+        lock.unlock();
+
+        Point origin;
+        int n = 0;
+        {
+            std::lock_guard<std::recursive_mutex> projLock(m_Proj.Mutex());
+            Clock::time_point begin = Clock::now();
+            Layer const& l = m_Proj.ResolveLayer(m_Layer);
+            n = l.NumFrames();
+            uint64_t total = l.TotalTime();
+            if (frame >= n) {
+                frame = 0;
+            }
+            // if we're falling behind, skip ahead to the frame which will be
+            // due by the time it's rendered.
+            if (total > 0) {
+                uint64_t t = std::chrono::duration_cast<std::chrono::microseconds>(begin - m_Start).count() + renderTime;
+                int due = l.FrameIndexClipped(t % total);
+                if (isBehind(frame, due, n)) {
+                    frame = due;
+                }
+            }
+
+            comp.SetFocus(m_Layer, frame);
+            Box b = comp.Bound();
+            if (img && (img->W() != b.w || img->H() != b.h)) {
+                delete img;
+                img = nullptr;
+            }
+            if (!img) {
+                img = new Img(FMT_RGBA8PM, b.w, b.h);
+            }
+            for (int y = 0; y < b.h; ++y) {
+                RGBA8* dest = img->Ptr_RGBA8(0, y);
+                int x = 0;
+                while (x < b.w) {
+                    int count;
+                    RGBA8 const* src = comp.Span(b.x + x, b.y + y, count);
+                    count = std::min(count, b.w - x);
+                    std::copy(src, src + count, dest + x);
+                    x += count;
+                }
+            }
+            origin = b.TopLeft();
+            renderTime = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - begin).count();
+        }
+
+        lock.lock();
+        if (gen != m_Generation || m_Count >= RING_SIZE) {
+            // stale
+            Recycle(img);
+            continue;
+        }
+        Slot& s = m_Ring[(m_Head + m_Count) % RING_SIZE];
+        s.img = img;
+        s.frame = frame;
+        s.origin = origin;
+        ++m_Count;
+        m_NextRender = (frame + 1) % n;
+    }
+}
+
+
+// ProjectListener implementation.
+// Anything could have changed the look of upcoming frames.
+
+void Player::OnDamaged(NodePath const& /*target*/, int /*frame*/, Box const& /*dmg*/)
+{
+    Flush();
+}
+
+void Player::OnPaletteChanged(NodePath const& /*target*/, int /*frame*/, int /*index*/, Colour const& /*c*/)
+{
+    Flush();
+}
+
+void Player::OnPaletteReplaced(NodePath const& /*target*/, int /*frame*/)
+{
+    Flush();
+}
+
+void Player::OnFramesAdded(NodePath const& /*target*/, int /*first*/, int /*count*/)
+{
+    Flush();
+}
+
+void Player::OnFramesRemoved(NodePath const& /*target*/, int /*first*/, int /*count*/)
+{
+    Flush();
+}
+
+void Player::OnFramesBlatted(NodePath const& /*target*/, int /*first*/, int /*count*/)
+{
+    Flush();
+}
@@ -0,0 +1,100 @@
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include "layer.h"
+#include "point.h"
+#include "projectlistener.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Img;
+class Project;
+
+// Player handles animation playback of a layer (composited with the other
+// visible layers).
+//
+// Frames are scheduled by their mDuration against a monotonic clock.
+// A worker thread renders upcoming frames into a ring buffer ahead of
+// time, so the GUI only has to Poll() regularly and show what it gets.
+// If rendering can't keep up, frames are dropped rather than letting
+// playback slow down.
+//
+// The worker holds the project mutex while it reads the project. Any
+// change to the project throws away the frames rendered so far.
+class Player : public ProjectListener
+{
+public:
+    enum { RING_SIZE = 8 };
+
+    Player(Project& proj, NodePath const& layer);
+    virtual ~Player();
+
+    // Start playing from the given frame.
+    void Start(int frame);
+    void Stop();
+    bool Playing() const { return m_Worker.joinable(); }
+
+    // Call regularly (on the GUI thread) while playing.
+    // If it's time to show a different frame, returns it as an RGBA8PM image
+    // and sets frame and origin (the image position in focus coords).
+    // Otherwise returns null.
+    // The image is valid until the next Poll() or Stop().
+    Img const* Poll(int& frame, Point& origin);
+
+    // The achieved frame rate, averaged over the last second or so.
+    float FPS() const { return m_FPS; }
+    // Number of frames dropped since Start().
+    int Dropped() const { return m_Dropped; }
+
+    // ProjectListener implementation
+    virtual void OnDamaged(NodePath const& target, int frame, Box const& dmg) override;
+    virtual void OnPaletteChanged(NodePath const& target, int frame, int index, Colour const& c) override;
+    virtual void OnPaletteReplaced(NodePath const& target, int frame) override;
+    virtual void OnFramesAdded(NodePath const& target, int first, int count) override;
+    virtual void OnFramesRemoved(NodePath const& target, int first, int count) override;
+    virtual void OnFramesBlatted(NodePath const& target, int first, int count) override;
+
+private:
+    Player(Player const&);  // disallowed
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Slot {
+        Img* img {nullptr};
+        int frame {-1};
+        Point origin {0, 0};
+    };
+
+    void Run();
+    void Flush();
+    void Recycle(Img* img);
+
+    Project& m_Proj;
+    NodePath m_Layer;
+
+    // GUI thread only
+    Clock::time_point m_Start;  // time frame 0 would have started
+    Slot m_Current;             // the frame being shown
+    int m_Dropped;
+    int m_FPSCount;
+    Clock::time_point m_FPSStart;
+    float m_FPS;
+
+    // shared with worker (guarded by m_Mutex)
+    std::thread m_Worker;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    bool m_Quit;
+    int m_Generation;           // bumped whenever rendered frames are stale
+    int m_NextRender;           // frame the worker should render next
+    Slot m_Ring[RING_SIZE];
+    int m_Head;
+    int m_Count;
+    std::vector<Img*> m_Free;   // images to reuse
+};
+
+#endif // PLAYER_H
@@ -14,7 +14,8 @@
 Project::Project( std::string const& filename ) :
     mRoot(nullptr),
     m_Expendable(false),
-    m_Modified(false)
+    m_Modified(false),
+    m_DeferDamage(false)
 {
     mFilename = filename;
     Layer* l = LoadLayer(filename.c_str(), mSettings);
@@ -27,7 +28,8 @@ Project::Project( std::string const& filename ) :
 Project::Project(Layer* layer) :
     mRoot(nullptr),
     m_Expendable(false),
-    m_Modified( false )
+    m_Modified( false ),
+    m_DeferDamage(false)
 {
     mRoot = new Stack();
     mRoot->AddChild(layer);
@@ -37,7 +39,8 @@ Project::Project(Layer* layer) :
 Project::Project() :
     mRoot(nullptr),
     m_Expendable(true),
-    m_Modified( false )
+    m_Modified( false ),
+    m_DeferDamage(false)
 {
     int w = 128;
     int h = 128;
@@ -55,7 +58,8 @@ Project::Project() :
 Project::Project( PixelFormat fmt, int w, int h, Palette* palette, int num_frames ) :
     mRoot(nullptr),
     m_Expendable(false),
-    m_Modified( false )
+    m_Modified( false ),
+    m_DeferDamage(false)
 {
     assert(num_frames>=1);
     if(!palette) {
@@ -103,11 +107,37 @@ bool Project::SharesPalette(NodePath const& a, int /*frameA*/, NodePath const& b
 
 void Project::NotifyDamage(NodePath const& target, int frame, Box const& b )
 {
+    if (m_DeferDamage) {
+        // merge with the last lot, unless that'd cover a lot of
+        // undamaged area
+        if (!m_Deferred.empty()) {
+            Damage& last = m_Deferred.back();
+            if (last.target == target && last.frame == frame) {
+                Box merged(last.area);
+                merged.Merge(b);
+                if (merged.w * merged.h <= 2 * (last.area.w * last.area.h + b.w * b.h)) {
+                    last.area = merged;
+                    return;
+                }
+            }
+        }
+        m_Deferred.push_back(Damage{target, frame, b});
+        return;
+    }
     for (auto l : m_Listeners) {
         l->OnDamaged(target, frame, b);
     }
 }
 
+void Project::DeliverDeferredDamage()
+{
+    std::vector<Damage> pending;
+    pending.swap(m_Deferred);
+    for (auto const& d : pending) {
+        NotifyDamage(d.target, d.frame, d.area);
+    }
+}
+
 void Project::NotifyFramesAdded(NodePath const& target, int first, int count)
 {
     for (auto l : m_Listeners) {
@@ -189,6 +219,15 @@ PenColour Project::PickUpPen(NodePath const& target, int frame, Point const& pt)
             return PenColour(c);
         }
         break;
+    case FMT_RGBA8PM:
+        return PenColour(Unpremultiply(*srcimg.PtrConst_RGBA8(pt.x,pt.y)));
+    case FMT_I4:
+    case FMT_I2:
+    case FMT_I1:
+        {
+            I8 idx = srcimg.GetIndex(pt.x, pt.y);
+            return PenColour(PaletteConst(target, frame).GetColour(idx), idx);
+        }
     default:
         assert(false);
         break;
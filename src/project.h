@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <list>
+#include <mutex>
 #include <set>
 #include <vector>
 #include <string>
@@ -14,6 +15,7 @@
 #include "palette.h"
 #include "point.h"
 #include "ranges.h"
+#include "retromode.h"
 
 class Tool;
 class ProjectListener;
@@ -36,6 +38,9 @@ struct ProjSettings
     // TODO: should be in LayerSettings!
     int PixW {1};
     int PixH {1};
+
+    // Attribute clash rules to check against (see AttrClash).
+    RetroMode Retro;
 };
 
 
@@ -116,6 +121,14 @@ public:
     // --------------------------------------
 	void NotifyDamage(NodePath const& target, int frame, Box const& b);
 
+    // While deferred, damage isn't passed on to listeners straight away,
+    // but collected up until DeliverDeferredDamage() is called. This lets
+    // a worker thread draw into the project, with the listeners only ever
+    // being called on the GUI thread.
+    // Both must be called with the mutex held.
+    void DeferDamage( bool defer ) { m_DeferDamage = defer; }
+    void DeliverDeferredDamage();
+
     // notify operations on frames
     void NotifyFramesAdded(NodePath const& target, int first, int count);
     void NotifyFramesRemoved(NodePath const& target, int first, int count);
@@ -132,6 +145,11 @@ public:
     // Return true if both paths share the same palette
     bool SharesPalette(NodePath const& a, int frameA, NodePath const& b, int frameB) const;
 
+    // Other threads (eg animation playback) hold this while reading the
+    // project, so the GUI thread must hold it while modifying it.
+    // Recursive, so nested modifications (eg a tool adding a Cmd) are fine.
+    std::recursive_mutex& Mutex() const { return m_Mutex; }
+
     // --------------------------------------
     // DATA
     // --------------------------------------
@@ -148,11 +166,22 @@ private:
 
 	std::set< ProjectListener* > m_Listeners;
 
+    mutable std::recursive_mutex m_Mutex;
+
     bool m_Expendable;
 
     // has project been modified?
     bool m_Modified;
 
+    // damage collected up while deferring (see DeferDamage())
+    struct Damage {
+        NodePath target;
+        int frame;
+        Box area;
+    };
+    bool m_DeferDamage;
+    std::vector<Damage> m_Deferred;
+
 };
 
 
@@ -0,0 +1,94 @@
+#include <QtWidgets/QtWidgets>
+
+#include "brushxformdialog.h"
+
+#include <cmath>
+
+// slider position for an angle (the slider only covers -180..180)
+static int sliderAngle(double angle)
+{
+    int deg = (int)std::lround(std::fmod(angle, 360.0));
+    if (deg > 180) {
+        deg -= 360;
+    } else if (deg < -180) {
+        deg += 360;
+    }
+    return deg;
+}
+
+BrushXformDialog::BrushXformDialog(QWidget *parent, float angle, float scale)
+    : QDialog(parent)
+{
+    m_AngleSlider = new QSlider(Qt::Horizontal, this);
+    m_AngleSlider->setRange(-180, 180);
+    m_AngleSlider->setTickPosition(QSlider::TicksBelow);
+    m_AngleSlider->setTickInterval(45);
+
+    m_Angle = new QDoubleSpinBox(this);
+    m_Angle->setRange(-360.0, 360.0);
+    m_Angle->setDecimals(1);
+    QLabel* anglelabel = new QLabel(tr("Angle (degrees, clockwise):"));
+    anglelabel->setBuddy(m_Angle);
+
+    m_Scale = new QDoubleSpinBox(this);
+    m_Scale->setRange(1.0, 1600.0);
+    m_Scale->setDecimals(0);
+    m_Scale->setSuffix(tr("%"));
+    QLabel* scalelabel = new QLabel(tr("Size:"));
+    scalelabel->setBuddy(m_Scale);
+
+    // (set the initial values before connecting, so they don't trigger a
+    // preview)
+    m_Angle->setValue(angle);
+    m_AngleSlider->setValue(sliderAngle(angle));
+    m_Scale->setValue(scale * 100.0);
+    connect(m_AngleSlider, SIGNAL(valueChanged(int)), this, SLOT(angleSliderMoved(int)));
+    connect(m_Angle, SIGNAL(valueChanged(double)), this, SLOT(angleChanged(double)));
+    connect(m_Scale, SIGNAL(valueChanged(double)), this, SLOT(scaleChanged(double)));
+
+    QDialogButtonBox* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttonBox, SIGNAL(accepted()), this, SLOT(accept()));
+    connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+
+    QGridLayout *l = new QGridLayout;
+    l->addWidget(anglelabel, 0, 0);
+    l->addWidget(m_Angle, 0, 1);
+    l->addWidget(m_AngleSlider, 1, 0, 1, 2);
+    l->addWidget(scalelabel, 2, 0);
+    l->addWidget(m_Scale, 2, 1);
+    l->addWidget(buttonBox, 3, 0, 1, 2);
+    setLayout(l);
+    setWindowTitle(tr("Rotate/Resize Brush"));
+}
+
+float BrushXformDialog::Angle() const
+{
+    return (float)m_Angle->value();
+}
+
+float BrushXformDialog::Scale() const
+{
+    return (float)(m_Scale->value() / 100.0);
+}
+
+void BrushXformDialog::angleSliderMoved(int value)
+{
+    // the spinbox passes it on
+    m_Angle->setValue((double)value);
+}
+
+void BrushXformDialog::angleChanged(double value)
+{
+    int deg = sliderAngle(value);
+    if (deg != m_AngleSlider->value()) {
+        m_AngleSlider->blockSignals(true);
+        m_AngleSlider->setValue(deg);
+        m_AngleSlider->blockSignals(false);
+    }
+    emit xformChanged(Angle(), Scale());
+}
+
+void BrushXformDialog::scaleChanged(double)
+{
+    emit xformChanged(Angle(), Scale());
+}
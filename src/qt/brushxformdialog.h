@@ -0,0 +1,31 @@
+#ifndef BRUSHXFORMDIALOG_H
+#define BRUSHXFORMDIALOG_H
+
+#include <QtWidgets/QDialog>
+
+class QDoubleSpinBox;
+class QSlider;
+
+// Dialog to rotate and scale the current brush.
+// xformChanged() is emitted as the controls are dragged, so the brush can
+// be previewed as it goes.
+class BrushXformDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    BrushXformDialog(QWidget *parent, float angle, float scale);
+    float Angle() const;
+    float Scale() const;
+signals:
+    void xformChanged(float angle, float scale);
+private slots:
+    void angleSliderMoved(int value);
+    void angleChanged(double value);
+    void scaleChanged(double value);
+private:
+    QSlider *m_AngleSlider;
+    QDoubleSpinBox *m_Angle;
+    QDoubleSpinBox *m_Scale;
+};
+
+#endif
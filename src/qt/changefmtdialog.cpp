@@ -11,6 +11,7 @@ struct modepreset {
 
 static modepreset presets[] = {
     {"RGBA",FMT_RGBA8,0},
+    {"RGBA (premultiplied)",FMT_RGBA8PM,0},
     {"RGB",FMT_RGBX8,0},
     {"256 colour palette",FMT_I8,256},
     {"128 colour palette",FMT_I8,128},
@@ -20,6 +21,9 @@ static modepreset presets[] = {
     {"8 colour palette",FMT_I8,8},
     {"4 colour palette",FMT_I8,4},
     {"2 colour palette",FMT_I8,2},
+    {"16 colour palette (packed)",FMT_I4,16},
+    {"4 colour palette (packed)",FMT_I2,4},
+    {"2 colour palette (packed)",FMT_I1,2},
 };
 
 const int N_PRESETS = sizeof(presets)/sizeof(modepreset);
@@ -41,6 +45,8 @@ static std::string describeFmt(PixelFormat fmt, int nColours) {
     switch(fmt) {
         case FMT_RGBA8:
             return "RGBA";
+        case FMT_RGBA8PM:
+            return "RGBA (premultiplied)";
         case FMT_RGBX8:
             return "RGB";
         case FMT_I8:
@@ -49,6 +55,16 @@ static std::string describeFmt(PixelFormat fmt, int nColours) {
                 sprintf(buf, "%d colour palette", nColours);
                 return std::string(buf);
             }
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            {
+                char buf[32];
+                sprintf(buf, "%d colour palette (packed)", nColours);
+                return std::string(buf);
+            }
+        default:
+            break;
     }
     return "???";
 }
@@ -8,13 +8,18 @@
 #include "../file_type.h"
 #include "../cmd.h"
 #include "../cmd_changefmt.h"
+#include "../cmd_optimisepalette.h"
 #include "../cmd_remap.h"
 #include "../sheet.h"
 #include "../img_convert.h"
+#include "../jobs.h"
+#include "../player.h"
+#include "../rotscale.h"
 #include "guistuff.h"
 #include "editorwindow.h"
 #include "editviewwidget.h"
 #include "file_load.h"
+#include "brushxformdialog.h"
 #include "griddialog.h"
 #include "palettewidget.h"
 #include "rangeswidget.h"
@@ -31,6 +36,7 @@
 #include <algorithm>
 #include <memory>
 #include <cassert>
+#include <cmath>
 #ifdef WIN32
 #include <unistd.h> // for getcwd()
 #endif
@@ -52,11 +58,14 @@
 #include <QtWidgets/QStatusBar>
 #include <QtWidgets/QMenuBar>
 #include <QtWidgets/QMessageBox>
+#include <QtWidgets/QInputDialog>
+#include <QtWidgets/QProgressDialog>
 #include <QtWidgets/QAction>
 #include <QtWidgets/QTextEdit>
 
 #include <QCloseEvent>
 #include <QCursor>
+#include <QTimer>
 
 
 
@@ -110,7 +119,16 @@ EditorWindow::EditorWindow( Project* proj, QWidget* parent ) :
     m_HelpWindow(0),
     m_ActionUndo(0),
     m_ActionRedo(0),
-    m_StatusViewInfo(0)
+    m_StatusViewInfo(0),
+    m_Player(nullptr),
+    m_PlayTimer(nullptr),
+    m_CycleTimer(nullptr),
+    m_StrokesPending(false),
+    m_BrushXform(nullptr),
+    m_BrushXformGen(0),
+    m_BrushXformHandle(0, 0),
+    m_BrushAngle(0.0f),
+    m_BrushScale(1.0f)
 {
     // focus upon the first layer
     Layer *firstLayer = FindLayer(proj->mRoot);
@@ -134,6 +152,14 @@ EditorWindow::EditorWindow( Project* proj, QWidget* parent ) :
     m_PaletteEditor = new PaletteEditor(this, *this, m_Focus, m_Frame);
     m_PaletteEditor->hide();
 
+    m_PlayTimer = new QTimer(this);
+    m_PlayTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_PlayTimer, SIGNAL(timeout()), this, SLOT(play_tick()));
+
+    m_CycleTimer = new QTimer(this);
+    m_CycleTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_CycleTimer, SIGNAL(timeout()), this, SLOT(cycle_tick()));
+
     resize( 700,500 );
 
     QGridLayout* layout = new QGridLayout();
@@ -240,6 +266,10 @@ EditorWindow::EditorWindow( Project* proj, QWidget* parent ) :
 
 EditorWindow::~EditorWindow()
 {
+    // (so the stroke worker won't call OnStrokeDrawn() mid-destruction)
+    FinishStrokes();
+    delete m_Player;
+    delete m_BrushXform;
     delete m_PaletteEditor;
     delete m_AboutBox;
     delete m_HelpWindow;
@@ -528,7 +558,8 @@ void EditorWindow::magnifyButtonToggled(bool checked)
             // Create the magnified view and figure out position/zoom.
             m_MagView = new EditViewWidget(*this, m_Focus, m_Frame);
             m_MagView->setCursor(*m_MouseCursors[MOUSESTYLE_DEFAULT]);
-            m_MagView->SetZoom(m_ViewWidget->Zoom() * 4);
+            int zoom = m_ViewWidget->Zoom();
+            m_MagView->SetZoom((zoom > 1 ? zoom : 1) * 4);
             m_ViewSplitter->addWidget(m_MagView);
 
             // adding the widget will have set up the view dimensions, so
@@ -587,7 +618,7 @@ void EditorWindow::fgColourPickedRGB( Colour c )
     int idx = pal.Closest(c);
     // snap to palette colour on indexed images
     Layer& l = Proj().ResolveLayer(Focus());
-    if(l.Fmt()==FMT_I8 && idx >=0) {
+    if(FmtIsIndexed(l.Fmt()) && idx >=0) {
         c = pal.Colours[idx];
     }
     SetFGPen(PenColour(c, idx));
@@ -599,7 +630,7 @@ void EditorWindow::bgColourPickedRGB( Colour c )
     int idx = pal.Closest(c);
     // snap to palette colour on indexed images
     Layer& l = Proj().ResolveLayer(Focus());
-    if(l.Fmt()==FMT_I8 && idx >=0) {
+    if(FmtIsIndexed(l.Fmt()) && idx >=0) {
         c = pal.Colours[idx];
     }
     SetBGPen(PenColour(c, idx));
@@ -631,15 +662,15 @@ void EditorWindow::update_menu_states()
     m_ActionGridOnOff->setChecked( GridActive() );
     m_ActionUseBrushPalette->setEnabled( GetBrush() == -1 );
 
-    // custom brush, and indexed?
-    m_ActionScale2xBrush->setEnabled(
-        GetBrush() == -1 && CurrentBrush().Fmt() == FMT_I8);
-
-    // custom brush, and focus has a palette?
-    m_ActionScale2xBrush->setEnabled(GetBrush() == -1 && pal.NColours >0);
+    // custom brush?
+    m_ScaleBrushMenu->setEnabled(GetBrush() == -1);
+    m_ActionRotateBrush90->setEnabled(GetBrush() == -1);
+    m_ActionRotateBrush->setEnabled(GetBrush() == -1);
+    m_ActionResizeBrush->setEnabled(GetBrush() == -1);
 
     // Got a palette in focus?
     m_ActionSavePalette->setEnabled(pal.NColours > 0);
+    m_ActionOptimisePalette->setEnabled(Proj().ResolveLayer(m_Focus).Fmt() == FMT_I8);
 
     // int nframes= Proj().GetLayer(ActiveLayer()).NumFrames();
     // TODO: IMPLEMENT!
@@ -649,11 +680,19 @@ void EditorWindow::update_menu_states()
     m_ActionZapFrame->setEnabled(nframes>1);
     m_ActionNextFrame->setEnabled(nframes>1);
     m_ActionPrevFrame->setEnabled(nframes>1);
+    m_ActionOnionSkin->setChecked(OnionSkins() > 0);
+    m_ActionPlay->setEnabled(nframes>1);
+    m_ActionPlay->setChecked(m_Player && m_Player->Playing());
+    m_ActionCycle->setChecked(Cycling());
 
     m_ActionToSpritesheet->setEnabled(nframes>1);
     m_ActionFromSpritesheet->setEnabled(nframes==1);
 
     m_ActionToggleSpare->setChecked(m_Frame == SPARE_FRAME);
+
+    for (QAction* a : m_RetroModeMenu->actions()) {
+        a->setChecked(a->data().toInt() == (int)Retro().id);
+    }
 }
 
 void EditorWindow::do_undo()
@@ -718,11 +757,15 @@ void EditorWindow::do_resize()
             firstFrame = SPARE_FRAME;
             numFrames = 1;
         }
-        Cmd* c = new Cmd_ResizeFrames(Proj(), Focus(),
-            firstFrame, numFrames,
-            Box(0,0,area.width(),area.height()),
-            BGPen() );
-        AddCmd(c);
+        Cmd* c = BuildCmd("Resizing...", [&](Job* job) {
+            return new Cmd_ResizeFrames(Proj(), Focus(),
+                firstFrame, numFrames,
+                Box(0,0,area.width(),area.height()),
+                BGPen(), job);
+        });
+        if (c) {
+            AddCmd(c);
+        }
     }
 }
 
@@ -735,7 +778,7 @@ void EditorWindow::do_changefmt()
     if( dlg.exec() == QDialog::Accepted ) {
         // ignore no-ops (eg rgba->rgba)
         if (dlg.pixel_format != l.Fmt() ||
-            (l.Fmt() == FMT_I8 && dlg.num_colours != currColours)) {
+            (FmtIsIndexed(l.Fmt()) && dlg.num_colours != currColours)) {
             // TODO:
             // - don't remap if increasing palette size
             // - if decreasing palette size, give option to calculate new palette
@@ -779,8 +822,12 @@ void EditorWindow::do_usebrushpalette()
                 // Remap it.
                 Layer& l = Proj().ResolveLayer(m_Focus);
                 // keep the same pixelformat
-                Cmd* cmd = new Cmd_Remap(Proj(), m_Focus, l.Fmt(), brushPalette);
-                AddCmd(cmd);
+                Cmd* cmd = BuildCmd("Remapping...", [&](Job* job) {
+                    return new Cmd_Remap(Proj(), m_Focus, l.Fmt(), brushPalette, job);
+                });
+                if (cmd) {
+                    AddCmd(cmd);
+                }
             }
             break;
         case QMessageBox::No:
@@ -795,41 +842,65 @@ void EditorWindow::do_usebrushpalette()
     }
 }
 
+void EditorWindow::do_retromode(QAction* act)
+{
+    RetroModeID id = (RetroModeID)act->data().toInt();
+    SetRetroMode(RetroMode::Get(id));
+    update_menu_states();
+}
+
+void EditorWindow::do_optimisepalette()
+{
+    QStringList orders;
+    orders << "Leave order" << "Sort by hue" << "Sort by brightness";
+    bool ok;
+    QString order = QInputDialog::getItem(this, "Optimise Palette",
+        "Merge duplicate colours and remove unused ones, then:",
+        orders, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    Cmd_OptimisePalette::SortOrder sort = (Cmd_OptimisePalette::SortOrder)orders.indexOf(order);
+
+    Cmd* c = BuildCmd("Optimising palette...", [&](Job* job) {
+        return new Cmd_OptimisePalette(Proj(), m_Focus, sort, job);
+    });
+    if (c) {
+        AddCmd(c);
+    }
+}
+
 void EditorWindow::do_xflipbrush()
 {
     if( GetBrush() != -1 )
         return; // std brush - do nothing
-    HideToolCursor();
     CurrentBrush().XFlip();
-    ShowToolCursor();
+    BrushModified();
 }
 
 void EditorWindow::do_yflipbrush()
 {
     if( GetBrush() != -1 )
         return; // std brush - do nothing
-    HideToolCursor();
     CurrentBrush().YFlip();
-    ShowToolCursor();
+    BrushModified();
 }
 
-void EditorWindow::do_scale2xbrush()
+void EditorWindow::do_scalebrush(QAction* act)
 {
     if (GetBrush() != -1)
         return; // std brush - do nothing
-    if (CurrentBrush().Fmt() != FMT_I8) {
-        return;
-    }
+    ScaleMethod method = (ScaleMethod)act->data().toInt();
     HideToolCursor();
 
     Brush& oldBrush = CurrentBrush();
-    Img* tmpImg = DoScale2x(oldBrush);
+    Img* tmpImg = DoScale(oldBrush, method);
 
     Brush* newBrush = new Brush(oldBrush.Style(),
            *tmpImg,
            tmpImg->Bounds(),
            oldBrush.TransparentColour());
-    newBrush->SetHandle(oldBrush.Handle() * 2.0f);
+    newBrush->SetHandle(oldBrush.Handle() * (float)ScaleFactor(method));
     newBrush->SetPalette(oldBrush.GetPalette());
 
     // UGH!
@@ -839,6 +910,137 @@ void EditorWindow::do_scale2xbrush()
     ShowToolCursor();
 }
 
+void EditorWindow::do_rotatebrush90()
+{
+    if (GetBrush() != -1)
+        return; // std brush - do nothing
+    SyncBrushXform();
+    TransformBrush(std::fmod(m_BrushAngle + 90.0f, 360.0f), m_BrushScale);
+}
+
+void EditorWindow::do_rotatebrush()
+{
+    EditBrushXform();
+}
+
+void EditorWindow::do_resizebrush()
+{
+    EditBrushXform();
+}
+
+void EditorWindow::previewbrushxform(float angle, float scale)
+{
+    TransformBrush(angle, scale);
+}
+
+// Show the rotate/resize dialog, previewing the brush as the controls
+// are dragged (the RotScaler cache makes going back and forth cheap).
+void EditorWindow::EditBrushXform()
+{
+    if (GetBrush() != -1)
+        return; // std brush - do nothing
+    SyncBrushXform();
+    float angle = m_BrushAngle;
+    float scale = m_BrushScale;
+
+    BrushXformDialog dlg(this, angle, scale);
+    connect(&dlg, SIGNAL(xformChanged(float,float)), this, SLOT(previewbrushxform(float,float)));
+    if (dlg.exec() == QDialog::Accepted) {
+        angle = dlg.Angle();
+        scale = dlg.Scale();
+    }
+    // (cancelling puts back the brush we started with)
+    if (angle != m_BrushAngle || scale != m_BrushScale) {
+        TransformBrush(angle, scale);
+    }
+}
+
+// Make sure m_BrushXform holds the original of the current custom brush.
+void EditorWindow::SyncBrushXform()
+{
+    Brush& b = CurrentBrush();
+    if (!m_BrushXform || b.Generation() != m_BrushXformGen) {
+        // it's a new brush - start afresh
+        delete m_BrushXform;
+        m_BrushXform = new RotScaler(b, b.TransparentColour());
+        m_BrushXformGen = b.Generation();
+        m_BrushXformHandle = b.Handle();
+        m_BrushAngle = 0.0f;
+        m_BrushScale = 1.0f;
+    }
+}
+
+// Replace the current custom brush with a rotated/scaled version of the
+// original.
+void EditorWindow::TransformBrush(float angle, float scale)
+{
+    SyncBrushXform();
+    Brush& oldBrush = CurrentBrush();
+    HideToolCursor();
+
+    // grab what we need before SetCustomBrush() zaps the old brush
+    BrushStyle style = oldBrush.Style();
+    PenColour transparent = oldBrush.TransparentColour();
+    Palette pal = oldBrush.GetPalette();
+
+    Img const& img = m_BrushXform->Get(angle, scale);
+    Brush* newBrush = new Brush(style, img, img.Bounds(), transparent);
+    newBrush->SetHandle(m_BrushXform->Map(m_BrushXformHandle, angle, scale));
+    newBrush->SetPalette(pal);
+
+    g_App->SetCustomBrush(newBrush);
+    SetBrush(-1);
+    m_BrushXformGen = newBrush->Generation();
+    m_BrushAngle = angle;
+    m_BrushScale = scale;
+    ShowToolCursor();
+}
+
+void EditorWindow::do_scaleframes(QAction* act)
+{
+    ScaleMethod method = (ScaleMethod)act->data().toInt();
+    Layer const& l = Proj().ResolveLayer(m_Focus);
+    int firstFrame = 0;
+    int numFrames = (int)l.mFrames.size();
+    if (m_Frame == SPARE_FRAME) {
+        firstFrame = SPARE_FRAME;
+        numFrames = 1;
+    }
+    Cmd* c = BuildCmd("Scaling...", [&](Job* job) {
+        return new Cmd_ScaleFrames(Proj(), Focus(), firstFrame, numFrames, method, job);
+    });
+    if (c) {
+        AddCmd(c);
+    }
+}
+
+
+Cmd* EditorWindow::BuildCmd(QString const& what, std::function<Cmd*(Job*)> const& build)
+{
+    // The work is done off the GUI thread, reading the project without
+    // the lock, so make sure no strokes are still being drawn.
+    FinishStrokes();
+
+    Job job;
+    QProgressDialog progress(what, "Cancel", 0, 0, this);
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(500);
+    job.SetPoll([&]() {
+        // (setValue() on a modal progress dialog pumps the event loop)
+        progress.setMaximum(job.Total());
+        progress.setValue(job.Done());
+        if (progress.wasCanceled()) {
+            job.Cancel();
+        }
+    });
+
+    Cmd* c = build(&job);
+    if (job.Cancelled()) {
+        delete c;
+        return nullptr;
+    }
+    return c;
+}
 
 void EditorWindow::do_remapbrush()
 {
@@ -848,8 +1050,12 @@ void EditorWindow::do_remapbrush()
 
     // Create new image with the same format as the project target.
     Img const& focusImg = Proj().GetImgConst(m_Focus, m_Frame);
-    // Get the palette we're remapping to.
-    Palette const& destPalette = Proj().PaletteConst(m_Focus, m_Frame);
+    // Get the palette we're remapping to (a packed image can only use the
+    // colours which fit).
+    Palette destPalette(Proj().PaletteConst(m_Focus, m_Frame));
+    if (FmtIsPacked(focusImg.Fmt())) {
+        destPalette.SetNumColours(std::min(destPalette.NumColours(), 1 << FmtBits(focusImg.Fmt())));
+    }
     Brush const& brush = CurrentBrush();
 
     if(destPalette.NColours == 0) {
@@ -861,6 +1067,9 @@ void EditorWindow::do_remapbrush()
     Img* newImg = nullptr;
     switch(focusImg.Fmt()) {
         case FMT_I8:
+        case FMT_I4:    // (brushes are always I8 rather than packed)
+        case FMT_I2:
+        case FMT_I1:
             switch(brush.Fmt()) {
                 case FMT_I8:    // I8 -> I8
                     newImg = new Img(brush);
@@ -897,6 +1106,7 @@ void EditorWindow::do_remapbrush()
             }
             break;
         case FMT_RGBA8:
+        case FMT_RGBA8PM:   // (brushes are always straight alpha)
             switch(brush.Fmt()) {
                 case FMT_I8:    // I8 -> RGBA8
                     newImg = ConvertI8toRGBX8(brush, brush.GetPalette());
@@ -915,6 +1125,9 @@ void EditorWindow::do_remapbrush()
                     break;
             }
             break;
+        default:
+            assert(false);
+            break;
     }
 
     // map across the transparent pen
@@ -994,8 +1207,101 @@ void EditorWindow::do_nextframe()
     }
 }
 
+void EditorWindow::do_onionskin(bool checked)
+{
+    SetOnionSkins(checked ? 2 : 0);
+}
+
+void EditorWindow::do_play(bool checked)
+{
+    if (!checked) {
+        stopPlayback();
+        return;
+    }
+    if (!m_Player) {
+        m_Player = new Player(Proj(), m_Focus);
+    }
+    int frame = (m_Frame == SPARE_FRAME) ? m_NonSpareFrame : m_Frame;
+    m_Player->Start(frame);
+    m_PlayTimer->start(4);
+}
+
+void EditorWindow::do_cycle(bool checked)
+{
+    SetCycling(checked);
+    if (checked) {
+        m_CycleTimer->start(16);    // ~60fps
+    } else {
+        m_CycleTimer->stop();
+    }
+}
+
+void EditorWindow::do_cyclerate()
+{
+    bool ok;
+    double rate = QInputDialog::getDouble(this, "Cycle Rate",
+        "Steps per second (negative to cycle backwards):",
+        Rates().defaultRate, -60.0, 60.0, 1, &ok);
+    if (ok) {
+        Rates().defaultRate = (float)rate;
+    }
+}
+
+void EditorWindow::cycle_tick()
+{
+    CycleColours();
+}
+
+// Called on the stroke worker thread, so just get the GUI thread to
+// deliver the damage (once, however many batches get drawn meanwhile).
+void EditorWindow::OnStrokeDrawn()
+{
+    if (!m_StrokesPending.exchange(true)) {
+        QMetaObject::invokeMethod(this, "deliver_strokes", Qt::QueuedConnection);
+    }
+}
+
+void EditorWindow::deliver_strokes()
+{
+    m_StrokesPending = false;
+    DeliverStrokes();
+}
+
+void EditorWindow::play_tick()
+{
+    int frame;
+    Point origin;
+    Img const* img = m_Player->Poll(frame, origin);
+    if (!img) {
+        return;
+    }
+    m_ViewWidget->SetPlayback(img, origin);
+    if (m_MagView) {
+        m_MagView->SetPlayback(img, origin);
+    }
+
+    char buf[64];
+    sprintf(buf, "frame %d: %.1f fps (%d dropped)", frame, m_Player->FPS(), m_Player->Dropped());
+    m_StatusViewInfo->setText(buf);
+}
+
+void EditorWindow::stopPlayback()
+{
+    if (!m_Player || !m_Player->Playing()) {
+        return;
+    }
+    m_PlayTimer->stop();
+    m_ViewWidget->SetPlayback(nullptr, Point(0,0));
+    if (m_MagView) {
+        m_MagView->SetPlayback(nullptr, Point(0,0));
+    }
+    m_Player->Stop();
+    m_ActionPlay->setChecked(false);
+}
+
 void EditorWindow::setFrame(int frame)
 {
+    stopPlayback();
     Layer& l = Proj().ResolveLayer(m_Focus);
     assert(frame == SPARE_FRAME || (frame >= 0 && frame < (int)l.mFrames.size()));
     if (frame == SPARE_FRAME) {
@@ -1036,8 +1342,12 @@ void EditorWindow::do_tospritesheet()
     ToSpritesheetDialog dlg(this, grid, Proj(), m_Focus);
     if( dlg.exec() == QDialog::Accepted )
     {
-        Cmd* c= new Cmd_ToSpriteSheet(Proj(), m_Focus, dlg.getGrid());
-        AddCmd(c);
+        Cmd* c = BuildCmd("Building spritesheet...", [&](Job* job) {
+            return new Cmd_ToSpriteSheet(Proj(), m_Focus, dlg.getGrid(), job);
+        });
+        if (c) {
+            AddCmd(c);
+        }
     }
 }
 
@@ -1061,8 +1371,12 @@ void EditorWindow::do_fromspritesheet()
     FromSpritesheetDialog dlg(this, srcImg, grid);
     if( dlg.exec() == QDialog::Accepted )
     {
-        Cmd* c= new Cmd_FromSpriteSheet(Proj(), m_Focus, dlg.getGrid());
-        AddCmd(c);
+        Cmd* c = BuildCmd("Splitting spritesheet...", [&](Job* job) {
+            return new Cmd_FromSpriteSheet(Proj(), m_Focus, dlg.getGrid(), job);
+        });
+        if (c) {
+            AddCmd(c);
+        }
     }
 }
 
@@ -1095,8 +1409,12 @@ void EditorWindow::do_loadpalette()
                     // Remap it.
                     Layer& l = Proj().ResolveLayer(m_Focus);
                     // keep the same pixelformat
-                    Cmd* cmd = new Cmd_Remap(Proj(), m_Focus, l.Fmt(), *newPalette);
-                    AddCmd(cmd);
+                    Cmd* cmd = BuildCmd("Remapping...", [&](Job* job) {
+                        return new Cmd_Remap(Proj(), m_Focus, l.Fmt(), *newPalette, job);
+                    });
+                    if (cmd) {
+                        AddCmd(cmd);
+                    }
                 }
                 break;
             case QMessageBox::No:
@@ -1346,10 +1664,19 @@ QMenuBar* EditorWindow::CreateMenuBar()
         m_ActionUseBrushPalette = a = m->addAction( "Use Brush Palette...", this, SLOT(do_usebrushpalette()) );
         a = m->addAction( "&Load Palette...", this, SLOT( do_loadpalette()) );
         m_ActionSavePalette = a = m->addAction( "&Save Palette...", this, SLOT( do_savepalette()) );
+        m_ActionOptimisePalette = a = m->addAction( "Optimise Palette...", this, SLOT( do_optimisepalette()) );
         m->addSeparator();
         m->addAction( "X-Flip Brush", this, SLOT(do_xflipbrush()),QKeySequence("x") );
         m->addAction( "Y-Flip Brush", this, SLOT(do_yflipbrush()),QKeySequence("y") );
-        m_ActionScale2xBrush = m->addAction( "Scale2x Brush", this, SLOT(do_scale2xbrush()));
+        m_ScaleBrushMenu = m->addMenu("Scale Brush");
+        for (int i = 0; i < SCALE_NUM_METHODS; ++i) {
+            a = m_ScaleBrushMenu->addAction(ScaleMethodName((ScaleMethod)i));
+            a->setData(QVariant(i));
+        }
+        connect(m_ScaleBrushMenu, SIGNAL(triggered(QAction*)), this, SLOT(do_scalebrush(QAction*)));
+        m_ActionRotateBrush90 = m->addAction( "Rotate Brush 90", this, SLOT(do_rotatebrush90()), QKeySequence("z") );
+        m_ActionRotateBrush = m->addAction( "Rotate Brush...", this, SLOT(do_rotatebrush()) );
+        m_ActionResizeBrush = m->addAction( "Resize Brush...", this, SLOT(do_resizebrush()) );
         m_ActionRemapBrush = m->addAction( "Remap Brush", this, SLOT(do_remapbrush()));
         m->addSeparator();
 
@@ -1357,7 +1684,22 @@ QMenuBar* EditorWindow::CreateMenuBar()
         m_ActionGridOnOff = a = m->addAction( "&Grid On?", this, SLOT( do_gridonoff(bool)), QKeySequence("g") );
         a->setCheckable(true);
         m_ActionGridConfig = m->addAction( "Grid Config...", this, SLOT( do_gridconfig()));
+        m_RetroModeMenu = m->addMenu("Retro Mode");
+        for (int i = 0; i < RETRO_NUM_MODES; ++i) {
+            a = m_RetroModeMenu->addAction(RetroModeName((RetroModeID)i));
+            a->setData(QVariant(i));
+            a->setCheckable(true);
+        }
+        connect(m_RetroModeMenu, SIGNAL(triggered(QAction*)), this, SLOT(do_retromode(QAction*)));
         a = m->addAction( "Resize...", this, SLOT(do_resize()));
+        {
+            QMenu* sm = m->addMenu("Scale Up");
+            for (int i = 0; i < SCALE_NUM_METHODS; ++i) {
+                a = sm->addAction(ScaleMethodName((ScaleMethod)i));
+                a->setData(QVariant(i));
+            }
+            connect(sm, SIGNAL(triggered(QAction*)), this, SLOT(do_scaleframes(QAction*)));
+        }
         a = m->addAction( "Change format...", this, SLOT(do_changefmt()));
         m->addSeparator();
         m_ActionToggleSpare = a = m->addAction("Spare page?", this, SLOT(do_togglespare(bool)),QKeySequence("j"));
@@ -1373,9 +1715,17 @@ QMenuBar* EditorWindow::CreateMenuBar()
         m->addSeparator();
         m_ActionPrevFrame = m->addAction( "Previous Frame", this, SLOT( do_prevframe()),QKeySequence("1"));
         m_ActionNextFrame = m->addAction( "Next Frame", this, SLOT( do_nextframe()),QKeySequence("2"));
+        m_ActionOnionSkin = a = m->addAction( "Onion Skin?", this, SLOT( do_onionskin(bool)),QKeySequence("o"));
+        a->setCheckable(true);
+        m_ActionPlay = a = m->addAction( "Play?", this, SLOT( do_play(bool)),QKeySequence("p"));
+        a->setCheckable(true);
+        m_ActionCycle = a = m->addAction( "Cycle Colours?", this, SLOT( do_cycle(bool)),QKeySequence("Tab"));
+        a->setCheckable(true);
+        m->addAction( "Cycle Rate...", this, SLOT( do_cyclerate()));
         m->addSeparator();
         m->addAction( m_ActionToSpritesheet);
         m->addAction( m_ActionFromSpritesheet);
+        connect(m, SIGNAL(aboutToShow()), this, SLOT( update_menu_states()));
     }
 
 #if 0
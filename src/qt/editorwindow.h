@@ -12,11 +12,18 @@
 #include <QIcon>
 #include <QColor>
 
+#include <atomic>
+#include <functional>
+
+class Cmd;
 class EditViewWidget;
+class Job;
+class Player;
 class PaletteEditor;
 class PaletteWidget;
 class RangesWidget;
 class RGBPickerWidget;
+class RotScaler;
 class HelpWindow;
 class AboutBox;
 class QLayout;
@@ -25,6 +32,7 @@ class QMenuBar;
 class QAction;
 class QTabWidget;
 class QSplitter;
+class QTimer;
 
 
 struct EditorActions {
@@ -85,6 +93,7 @@ public:
     virtual void SetMouseStyle( MouseStyle s );
     virtual void OnPenChanged();
     virtual void OnUndoRedoChanged() { update_menu_states(); }
+    virtual void OnStrokeDrawn();
 
     // projectlistener stuff
     virtual void OnPaletteChanged(NodePath const& target, int frame, int index, Colour const& c) override;
@@ -129,9 +138,16 @@ public slots:
     void do_loadpalette();
     void do_savepalette();
     void do_usebrushpalette();
+    void do_optimisepalette();
     void do_xflipbrush();
     void do_yflipbrush();
-    void do_scale2xbrush();
+    void do_scalebrush(QAction* act);
+    void do_retromode(QAction* act);
+    void do_rotatebrush90();
+    void do_rotatebrush();
+    void do_resizebrush();
+    void previewbrushxform(float angle, float scale);
+    void do_scaleframes(QAction* act);
     void do_remapbrush();
     void do_drawmodeChanged(QAction* act);
 
@@ -144,6 +160,13 @@ public slots:
     void do_zapframe();
     void do_prevframe();
     void do_nextframe();
+    void do_onionskin(bool checked);
+    void do_play(bool checked);
+    void play_tick();
+    void do_cycle(bool checked);
+    void do_cyclerate();
+    void cycle_tick();
+    void deliver_strokes();
 
 private:
     uint64_t m_Time;
@@ -184,11 +207,19 @@ private:
     QAction* m_ActionToggleSpare;
     QAction* m_ActionUseBrushPalette;
     QAction* m_ActionSavePalette;
-    QAction* m_ActionScale2xBrush;
+    QAction* m_ActionOptimisePalette;
+    QMenu* m_ScaleBrushMenu;
+    QMenu* m_RetroModeMenu;
+    QAction* m_ActionRotateBrush90;
+    QAction* m_ActionRotateBrush;
+    QAction* m_ActionResizeBrush;
     QAction* m_ActionRemapBrush;
     QAction* m_ActionZapFrame;
     QAction* m_ActionPrevFrame;
     QAction* m_ActionNextFrame;
+    QAction* m_ActionOnionSkin;
+    QAction* m_ActionPlay;
+    QAction* m_ActionCycle;
 
     QAction* m_ActionToSpritesheet;
     QAction* m_ActionFromSpritesheet;
@@ -210,7 +241,37 @@ private:
     // set current frame, tell things that need to know (views, widgets etc)
     void setFrame(int frame);
 
+    // animation playback
+    Player* m_Player;   // (created on first use)
+    QTimer* m_PlayTimer;
+    void stopPlayback();
+
+    // colour cycling
+    QTimer* m_CycleTimer;
+
     void SaveProject(std::string const& filename);
+
+    // set by the stroke worker when a deliver_strokes() call is on its way
+    std::atomic<bool> m_StrokesPending;
+
+    // brush rotation/resizing
+    // Transforms are always applied to the original brush, so repeated
+    // rotations don't degrade it. m_BrushXform is reset whenever the
+    // current brush isn't the one we last produced (tracked by generation,
+    // as a new brush can turn up at the same address).
+    RotScaler* m_BrushXform;
+    unsigned int m_BrushXformGen;   // generation of the brush we produced
+    Point m_BrushXformHandle;   // handle of the original brush
+    float m_BrushAngle;
+    float m_BrushScale;
+    void SyncBrushXform();
+    void TransformBrush(float angle, float scale);
+    void EditBrushXform();
+
+    // Run build (which should construct a Cmd using the Job it's passed),
+    // showing a progress dialog if it takes a while. Returns null if the
+    // user cancelled it.
+    Cmd* BuildCmd(QString const& what, std::function<Cmd*(Job*)> const& build);
 };
 
 
@@ -7,8 +7,11 @@
 #include <QImage>
 #include <QPainter>
 #include <QMouseEvent>
+#include <QPaintEvent>
 #include <QtWidgets/QShortcut>
 #include <cassert>
+#include <utility>
+#include <vector>
 
 EditViewWidget::EditViewWidget(Editor& editor, NodePath const& focus, int frame) :
 	EditView(editor, focus, frame, 500, 500),
@@ -83,13 +86,41 @@ void EditViewWidget::wheelEvent(QWheelEvent *event)
 	AlignView(viewpos, projpos);
 }
 
-void EditViewWidget::paintEvent(QPaintEvent * /* event */)
+// Return a QImage sharing the canvas pixels.
+// The canvases only get reallocated on resize, so the wrappers are
+// usually reused.
+QImage const& EditViewWidget::Wrap(Img const& canvas)
 {
-    Img const& src = Canvas();
-    QImage image( (const uchar *)src.PtrConst_RGBX8(0,0), Canvas().W(), Canvas().H(), QImage::Format_RGB32 );
+    uchar const* pixels = (uchar const*)canvas.PtrConst_RGBX8(0,0);
+    for (QImage const& wrapped : m_Wrapped) {
+        if (wrapped.constBits() == pixels && wrapped.width() == canvas.W() &&
+            wrapped.height() == canvas.H()) {
+            return wrapped;
+        }
+    }
+    // replace the older one
+    std::swap(m_Wrapped[0], m_Wrapped[1]);
+    m_Wrapped[1] = QImage(pixels, canvas.W(), canvas.H(), canvas.Pitch(), QImage::Format_RGB32);
+    return m_Wrapped[1];
+}
+
+void EditViewWidget::paintEvent(QPaintEvent* event)
+{
+    if (!m_Unpresented.isEmpty()) {
+        std::vector<Box> areas;
+        for (QRect const& r : m_Unpresented) {
+            areas.push_back(Box(r.x(), r.y(), r.width(), r.height()));
+        }
+        Present(areas);
+        m_Unpresented = QRegion();
+    }
 
+    QImage const& image = Wrap(FrontConst());
     QPainter painter(this);
-    painter.drawImage(QPoint(0, 0), image);
+    // only paint the exposed parts
+    for (QRect const& r : event->region()) {
+        painter.drawImage(r.topLeft(), image, r);
+    }
 }
 
 void EditViewWidget::resizeEvent(QResizeEvent *event)
@@ -103,9 +134,20 @@ void EditViewWidget::resizeEvent(QResizeEvent *event)
 // EditViewListener fn
 void EditViewWidget::Redraw( Box const& b )
 {
+    m_Unpresented += QRect(b.x, b.y, b.w, b.h);
     update( b.x, b.y, b.w, b.h );
 }
 
+// EditViewListener fn
+// The front canvas has already been scrolled, so just move what's
+// onscreen to match (Qt only repaints the parts this exposes).
+void EditViewWidget::Scrolled( int dx, int dy )
+{
+    m_Unpresented.translate(dx, dy);
+    m_Unpresented &= rect();
+    scroll(dx, dy);
+}
+
 
 void EditViewWidget::zoomIn()
 {
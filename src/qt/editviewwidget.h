@@ -5,6 +5,8 @@
 #include <cstdio>
 #include "../editview.h"
 
+#include <QImage>
+#include <QRegion>
 #include <QtWidgets/QWidget>
 
 class EditViewWidget : public QWidget, public EditView
@@ -16,6 +18,7 @@ public:
 
 	// Editview virtuals
 	virtual void Redraw( Box const& b );
+	virtual void Scrolled( int dx, int dy );
 
 protected:
     void mousePressEvent(QMouseEvent *event);
@@ -29,11 +32,18 @@ public slots:
     void zoomOut();
 
 private:
+    QImage const& Wrap(Img const& canvas);
 
 	Point m_Anchor;
 
     bool m_Panning;
 
+    // area redrawn since last Present()
+    QRegion m_Unpresented;
+
+    // QImages wrapping the front and back canvases (no copying)
+    QImage m_Wrapped[2];
+
 };
 
 #endif // EDITVIEWWIDGET_H
@@ -22,6 +22,9 @@ static modepreset presets[] = {
     {"8 colour palette",FMT_I8,8},
     {"4 colour palette",FMT_I8,4},
     {"2 colour palette",FMT_I8,2},
+    {"16 colour palette (packed)",FMT_I4,16},
+    {"4 colour palette (packed)",FMT_I2,4},
+    {"2 colour palette (packed)",FMT_I1,2},
 };
 
 const int N_PRESETS = sizeof(presets)/sizeof(modepreset);
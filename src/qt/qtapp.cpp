@@ -83,7 +83,7 @@ EditorWindow* QTApp::NewProject()
 
     QSize sz = dlg.GetSize();
     Palette* pal = Palette::Load( JoinPath(g_App->DataPath(), "default.gpl").c_str());
-    if( dlg.pixel_format == FMT_I8)
+    if( FmtIsIndexed(dlg.pixel_format))
         pal->SetNumColours(dlg.num_colours);
     else
         pal->SetNumColours(256);
@@ -3,6 +3,7 @@
 #include <map>
 #include "quantise.h"
 #include "colours.h"
+#include "histogram.h"
 #include "img.h"
 #include "palette.h"
 
@@ -95,6 +96,7 @@ static bool operator<(Bucket const& lhs, Bucket const& rhs) {
 }
 
 static void medianCut(Bucket all, std::vector<Colour>& out, int numColours);
+static void pickColours(std::map<Colour, int>& hist, std::vector<Colour>& out, int nColours);
 
 
 
@@ -130,6 +132,16 @@ void CalculatePalette(Img const& srcImg, std::vector<Colour>& out, int nColours,
                     }
                 }
                 break;
+            case FMT_RGBA8PM:
+                {
+                    int x;
+                    RGBA8 const* src = srcImg.PtrConst_RGBA8(0,y);
+                    for (x = 0; x < srcImg.W(); ++x) {
+                        Colour c(Unpremultiply(*src++));
+                        hist[c]++;
+                    }
+                }
+                break;
             case FMT_I8:
                 {
                     assert(srcPalette);
@@ -140,12 +152,43 @@ void CalculatePalette(Img const& srcImg, std::vector<Colour>& out, int nColours,
                     }
                 }
                 break;
-                // TODO: handle indexed images ;-)
+            case FMT_I4:
+            case FMT_I2:
+            case FMT_I1:
+                assert(srcPalette);
+                for (int x = 0; x < srcImg.W(); ++x) {
+                    hist[srcPalette->GetColour(srcImg.GetIndex(x, y))]++;
+                }
+                break;
+            default:
                 assert(false);  // not supported...
                 break;
         }
     }
 
+    pickColours(hist, out, nColours);
+}
+
+
+void CalculatePalette(Histogram const& usage, std::vector<Colour>& out, int nColours, Palette const* srcPalette /*= nullptr*/)
+{
+    out.clear();
+    out.reserve(nColours);
+
+    std::vector<std::pair<Colour, int>> used;
+    usage.Colours(used, srcPalette);
+    // (indices might share colours)
+    std::map<Colour, int> hist;
+    for (auto const& u : used) {
+        hist[u.first] += u.second;
+    }
+    pickColours(hist, out, nColours);
+}
+
+
+// Choose up to nColours colours to represent the histogram.
+static void pickColours(std::map<Colour, int>& hist, std::vector<Colour>& out, int nColours)
+{
     if (hist.size() <= (size_t)nColours) {
         // no colour reduction needed!
         for (auto const& dat : hist) {
@@ -3,9 +3,16 @@
 
 #include <vector>
 #include "colours.h"
+class Histogram;
 class Palette;
 class Img;
 
 void CalculatePalette(Img const& srcImg, std::vector<Colour>& out, int nColours, Palette const* srcPalette = nullptr);
 
+// As above, but using precalculated colour usage instead of scanning the
+// image (srcPalette needed for indexed images).
+// usage should be exact (see Histogram::Exact()), or colours might be
+// missed.
+void CalculatePalette(Histogram const& usage, std::vector<Colour>& out, int nColours, Palette const* srcPalette = nullptr);
+
 #endif // QUANTISE_H
@@ -65,6 +65,27 @@ int RangeGrid::Remap(Palette const& newPalette)
     return cnt;
 }
 
+int RangeGrid::RemapIndices(I8 const* lut, Palette const& newPalette)
+{
+    int cnt = 0;
+    for (size_t i=0; i<m_Valid.size(); ++i) {
+        if (!m_Valid[i]) {
+            continue;
+        }
+        PenColour& pen = m_Pens[i];
+        if (!pen.IdxValid() || pen.idx() > 255) {
+            continue;
+        }
+
+        int newIdx = lut[pen.idx()];
+        Colour newRGB = newPalette.GetColour(newIdx);
+        if (newIdx != pen.idx() || newRGB != pen.rgb()) {
+            pen = PenColour(newRGB, newIdx);
+            ++cnt;
+        }
+    }
+    return cnt;
+}
 
 
 Box RangeGrid::PickRange(Point const& pos) const
@@ -147,3 +168,38 @@ void RangeGrid::FetchPens(Box const& range, std::vector<PenColour>& out) const
 }
 
 
+void RangeGrid::FindRanges(std::vector<Box>& out) const
+{
+    // horizontal runs
+    for (int y = m_Bound.YMin(); y <= m_Bound.YMax(); ++y) {
+        int x = m_Bound.XMin();
+        while (x <= m_Bound.XMax()) {
+            int start = x;
+            while (IsSet(Point(x, y))) {
+                ++x;
+            }
+            if (x - start > 1) {
+                out.push_back(Box(start, y, x - start, 1));
+            }
+            if (x == start) {
+                ++x;
+            }
+        }
+    }
+    // vertical runs
+    for (int x = m_Bound.XMin(); x <= m_Bound.XMax(); ++x) {
+        int y = m_Bound.YMin();
+        while (y <= m_Bound.YMax()) {
+            int start = y;
+            while (IsSet(Point(x, y))) {
+                ++y;
+            }
+            if (y - start > 1) {
+                out.push_back(Box(x, start, 1, y - start));
+            }
+            if (y == start) {
+                ++y;
+            }
+        }
+    }
+}
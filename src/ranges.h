@@ -42,6 +42,11 @@ public:
     // Returns the number of entries affected.
     int Remap(Palette const& newPalette);
 
+    // Remap ranges through an index lookup table (256 entries), picking
+    // up the rgb values from newPalette.
+    // Returns the number of entries affected.
+    int RemapIndices(I8 const* lut, Palette const& newPalette);
+
     // Return the first range found which passes through pos.
     // (there might be both vertical and horizontal. Undefined which one will
     // be returned). Returned box will be either w=1 (vertical range),
@@ -56,6 +61,10 @@ public:
     // (ok if range is empty - out will be empty).
     void FetchPens(Box const& range, std::vector<PenColour>& out) const;
 
+    // Find all the ranges in the grid (horizontal ones first, then
+    // vertical), and append them to out.
+    void FindRanges(std::vector<Box>& out) const;
+
 private:
     Box m_Bound;
     std::vector<bool> m_Valid;
@@ -0,0 +1,143 @@
+#include "retromode.h"
+#include "img.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+
+
+RetroMode RetroMode::Get(RetroModeID id)
+{
+    RetroMode m;
+    m.id = id;
+    switch (id) {
+    case RETRO_NONE:
+        break;
+    case RETRO_SPECTRUM:
+        m.cellW = 8;
+        m.cellH = 8;
+        m.maxColours = 2;
+        break;
+    case RETRO_C64_HIRES:
+        m.cellW = 8;
+        m.cellH = 8;
+        m.maxColours = 2;
+        break;
+    case RETRO_C64_MULTICOLOUR:
+        m.cellW = 4;
+        m.cellH = 8;
+        m.maxColours = 3;
+        m.sharedIdx = 0;
+        m.pixW = 2;
+        break;
+    default:
+        assert(false);
+        break;
+    }
+    return m;
+}
+
+char const* RetroModeName(RetroModeID id)
+{
+    switch (id) {
+    case RETRO_NONE: return "None";
+    case RETRO_SPECTRUM: return "ZX Spectrum";
+    case RETRO_C64_HIRES: return "C64 Hires";
+    case RETRO_C64_MULTICOLOUR: return "C64 Multicolour";
+    default:
+        assert(false);
+        return "";
+    }
+}
+
+
+AttrClash::AttrClash(RetroMode const& mode, int w, int h) :
+    m_Mode(mode),
+    m_Bound(0, 0, w, h),
+    m_CellsW(0),
+    m_CellsH(0),
+    m_NumClashes(0)
+{
+    assert(mode.Active());
+    m_CellsW = (w + mode.cellW - 1) / mode.cellW;
+    m_CellsH = (h + mode.cellH - 1) / mode.cellH;
+    m_Colours.assign(m_CellsW * m_CellsH, 0);
+}
+
+bool AttrClash::CellRange(Box const& area, int& cx0, int& cy0, int& cx1, int& cy1) const
+{
+    Box b(area);
+    b.ClipAgainst(m_Bound);
+    if (b.Empty()) {
+        return false;
+    }
+    cx0 = b.XMin() / m_Mode.cellW;
+    cy0 = b.YMin() / m_Mode.cellH;
+    cx1 = b.XMax() / m_Mode.cellW + 1;
+    cy1 = b.YMax() / m_Mode.cellH + 1;
+    return true;
+}
+
+Box AttrClash::CellBox(int cx, int cy) const
+{
+    Box b(cx * m_Mode.cellW, cy * m_Mode.cellH, m_Mode.cellW, m_Mode.cellH);
+    b.ClipAgainst(m_Bound);
+    return b;
+}
+
+Box AttrClash::Update(Img const& img, Box const& area)
+{
+    assert(FmtIsIndexed(img.Fmt()));
+    assert(img.Bounds() == m_Bound);
+    int cx0, cy0, cx1, cy1;
+    if (!CellRange(area, cx0, cy0, cx1, cy1)) {
+        return Box(0, 0, 0, 0);
+    }
+
+    for (int cy = cy0; cy < cy1; ++cy) {
+        for (int cx = cx0; cx < cx1; ++cx) {
+            Box cell = CellBox(cx, cy);
+            std::bitset<256> used;
+            for (int y = cell.YMin(); y <= cell.YMax(); ++y) {
+                if (img.Fmt() == FMT_I8) {
+                    I8 const* p = img.PtrConst_I8(cell.x, y);
+                    for (int x = 0; x < cell.w; ++x) {
+                        used.set(*p++);
+                    }
+                } else {
+                    for (int x = cell.XMin(); x <= cell.XMax(); ++x) {
+                        used.set(img.GetIndex(x, y));
+                    }
+                }
+            }
+            if (m_Mode.sharedIdx >= 0) {
+                used.reset(m_Mode.sharedIdx);
+            }
+
+            uint16_t& n = m_Colours[cy * m_CellsW + cx];
+            bool was = n > m_Mode.maxColours;
+            n = (uint16_t)used.count();
+            bool is = n > m_Mode.maxColours;
+            m_NumClashes += (int)is - (int)was;
+        }
+    }
+
+    Box covered = CellBox(cx0, cy0);
+    covered.Merge(CellBox(cx1 - 1, cy1 - 1));
+    return covered;
+}
+
+void AttrClash::FindClashes(Box const& area, std::vector<Box>& out) const
+{
+    int cx0, cy0, cx1, cy1;
+    if (m_NumClashes == 0 || !CellRange(area, cx0, cy0, cx1, cy1)) {
+        return;
+    }
+    for (int cy = cy0; cy < cy1; ++cy) {
+        for (int cx = cx0; cx < cx1; ++cx) {
+            if (m_Colours[cy * m_CellsW + cx] > m_Mode.maxColours) {
+                out.push_back(CellBox(cx, cy));
+            }
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef RETROMODE_H
+#define RETROMODE_H
+
+#include "box.h"
+
+#include <cstdint>
+#include <vector>
+
+class Img;
+
+// Retro display modes, which limit how many colours can be used within
+// each attribute cell (colour clash!).
+enum RetroModeID {
+    RETRO_NONE=0,
+    RETRO_SPECTRUM,         // 8x8 cells, ink + paper
+    RETRO_C64_HIRES,        // 8x8 cells, 2 colours
+    RETRO_C64_MULTICOLOUR,  // 4x8 cells of double-wide pixels, 3 colours + background
+    RETRO_NUM_MODES
+};
+
+struct RetroMode
+{
+    RetroModeID id {RETRO_NONE};
+    // attribute cell size (in image pixels)
+    int cellW {0};
+    int cellH {0};
+    // max colours in a cell
+    int maxColours {0};
+    // index which can be used anywhere without counting towards
+    // maxColours (eg C64 background colour), or -1 for none.
+    int sharedIdx {-1};
+    // pixel width to display with
+    int pixW {1};
+
+    bool Active() const { return id != RETRO_NONE; }
+
+    static RetroMode Get(RetroModeID id);
+};
+
+// Human-readable name, for menus etc.
+char const* RetroModeName(RetroModeID id);
+
+
+// AttrClash tracks which attribute cells of an indexed image use more
+// colours than the retro mode allows.
+//
+// It's incremental - Update() only rechecks the cells overlapping the
+// damaged area, so keeping it up to date while drawing costs about the
+// same as the drawing itself, rather than a full rescan per stroke.
+class AttrClash
+{
+public:
+    AttrClash(RetroMode const& mode, int w, int h);
+
+    // Recheck the cells overlapping area of img (which must be indexed, and
+    // the size given to the constructor).
+    // Returns the area covered by those cells - the clash state of any of
+    // it might have changed.
+    Box Update(Img const& img, Box const& area);
+
+    // Append the bounds of the clashing cells which overlap area to out.
+    void FindClashes(Box const& area, std::vector<Box>& out) const;
+
+    int NumClashes() const { return m_NumClashes; }
+
+private:
+    AttrClash(AttrClash const&);    // disallowed
+
+    // cells overlapping area: [cx0,cx1) x [cy0,cy1)
+    bool CellRange(Box const& area, int& cx0, int& cy0, int& cx1, int& cy1) const;
+    Box CellBox(int cx, int cy) const;
+
+    RetroMode m_Mode;
+    Box m_Bound;
+    int m_CellsW;
+    int m_CellsH;
+    // number of colours used in each cell (not counting mode.sharedIdx)
+    std::vector<uint16_t> m_Colours;
+    int m_NumClashes;
+};
+
+#endif // RETROMODE_H
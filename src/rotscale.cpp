@@ -0,0 +1,215 @@
+#include "rotscale.h"
+#include "scale2x.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+static const float PI = 3.14159265f;
+
+// quantise angle and scale for the cache
+static int angleKey(float angle)
+{
+    int a = (int)std::lround(angle * 10.0f) % 3600;
+    return (a < 0) ? a + 3600 : a;
+}
+
+static int scaleKey(float scale)
+{
+    return std::max(1, (int)std::lround(scale * 100.0f));
+}
+
+// Size of the image needed to hold a w*h one once it's transformed.
+static void destSize(int w, int h, float c, float s, float scale, int& dw, int& dh)
+{
+    float hw = (w * scale) / 2.0f;
+    float hh = (h * scale) / 2.0f;
+    float ex = std::fabs(hw * c) + std::fabs(hh * s);
+    float ey = std::fabs(hw * s) + std::fabs(hh * c);
+    // (fudge so exact right-angles don't grow a pixel)
+    dw = std::max(1, (int)std::ceil(ex * 2.0f - 0.001f));
+    dh = std::max(1, (int)std::ceil(ey * 2.0f - 0.001f));
+}
+
+// alpha-weighted bilinear blend of four pixels
+static RGBA8 bilinear(RGBA8 p00, RGBA8 p10, RGBA8 p01, RGBA8 p11, float fx, float fy)
+{
+    float w00 = (1.0f - fx) * (1.0f - fy) * p00.a;
+    float w10 = fx * (1.0f - fy) * p10.a;
+    float w01 = (1.0f - fx) * fy * p01.a;
+    float w11 = fx * fy * p11.a;
+    float a = w00 + w10 + w01 + w11;
+    if (a <= 0.0f) {
+        return RGBA8(0, 0, 0, 0);
+    }
+    float inv = 1.0f / a;
+    return RGBA8(
+        (uint8_t)std::lround((p00.r * w00 + p10.r * w10 + p01.r * w01 + p11.r * w11) * inv),
+        (uint8_t)std::lround((p00.g * w00 + p10.g * w10 + p01.g * w01 + p11.g * w11) * inv),
+        (uint8_t)std::lround((p00.b * w00 + p10.b * w10 + p01.b * w01 + p11.b * w11) * inv),
+        (uint8_t)std::lround(a));
+}
+
+
+RotScaler::RotScaler(Img const& src, PenColour const& transparent) :
+    m_Src(src),
+    m_Big(nullptr),
+    m_Transparent(transparent),
+    m_Clock(0)
+{
+}
+
+RotScaler::~RotScaler()
+{
+    for (auto& e : m_Cache) {
+        delete e.img;
+    }
+    delete m_Big;
+}
+
+Img const& RotScaler::Get(float angle, float scale)
+{
+    int a = angleKey(angle);
+    int s = scaleKey(scale);
+    ++m_Clock;
+    for (auto& e : m_Cache) {
+        if (e.angle == a && e.scale == s) {
+            e.lastUsed = m_Clock;
+            return *e.img;
+        }
+    }
+
+    Entry e;
+    e.angle = a;
+    e.scale = s;
+    e.img = Render(a, s);
+    e.lastUsed = m_Clock;
+    if ((int)m_Cache.size() < CACHE_SIZE) {
+        m_Cache.push_back(e);
+    } else {
+        // replace least recently used
+        auto oldest = std::min_element(m_Cache.begin(), m_Cache.end(),
+            [](Entry const& x, Entry const& y) { return x.lastUsed < y.lastUsed; });
+        delete oldest->img;
+        *oldest = e;
+    }
+    return *e.img;
+}
+
+Point RotScaler::Map(Point const& p, float angle, float scale) const
+{
+    float rad = (angleKey(angle) / 10.0f) * PI / 180.0f;
+    float sc = scaleKey(scale) / 100.0f;
+    float c = std::cos(rad);
+    float s = std::sin(rad);
+    int dw, dh;
+    destSize(m_Src.W(), m_Src.H(), c, s, sc, dw, dh);
+
+    float sx = (p.x + 0.5f) - m_Src.W() / 2.0f;
+    float sy = (p.y + 0.5f) - m_Src.H() / 2.0f;
+    float dx = (c * sx - s * sy) * sc;
+    float dy = (s * sx + c * sy) * sc;
+    return Point((int)std::floor(dx + dw / 2.0f), (int)std::floor(dy + dh / 2.0f));
+}
+
+Img* RotScaler::Render(int angle, int scale)
+{
+    float rad = (angle / 10.0f) * PI / 180.0f;
+    float sc = scale / 100.0f;
+    float c = std::cos(rad);
+    float s = std::sin(rad);
+    int dw, dh;
+    destSize(m_Src.W(), m_Src.H(), c, s, sc, dw, dh);
+    Img* dest = new Img(m_Src.Fmt(), dw, dh);
+
+    if (m_Src.Fmt() == FMT_RGBA8) {
+        RenderBilinear(*dest, c, s, sc);
+    } else {
+        RenderRotSprite(*dest, c, s, sc);
+    }
+    return dest;
+}
+
+// Nearest-neighbour sampling of the 8x upscaled source.
+void RotScaler::RenderRotSprite(Img& dest, float c, float s, float scale)
+{
+    if (!m_Big) {
+        // Scale8x - ie Scale2x three times
+        Img* tmp = DoScale(m_Src, SCALE_4X);
+        m_Big = DoScale(*tmp, SCALE_2X);
+        delete tmp;
+    }
+    const int bw = m_Big->W();
+    const int bh = m_Big->H();
+    // step through the source (in 8x coords) for each dest pixel
+    const float ux = (c / scale) * 8.0f;
+    const float uy = (-s / scale) * 8.0f;
+    const float vx = (s / scale) * 8.0f;
+    const float vy = (c / scale) * 8.0f;
+    const float ox = dest.W() / 2.0f;
+    const float oy = dest.H() / 2.0f;
+
+    for (int y = 0; y < dest.H(); ++y) {
+        float dy = (y + 0.5f) - oy;
+        float dx = 0.5f - ox;
+        // position of this row's first pixel
+        float u = dx * ux + dy * vx + bw / 2.0f;
+        float v = dx * uy + dy * vy + bh / 2.0f;
+        for (int x = 0; x < dest.W(); ++x, u += ux, v += uy) {
+            int bx = (int)std::floor(u);
+            int by = (int)std::floor(v);
+            bool inside = (bx >= 0 && bx < bw && by >= 0 && by < bh);
+            switch (dest.Fmt()) {
+            case FMT_I8:
+                *dest.Ptr_I8(x, y) = inside ? *m_Big->PtrConst_I8(bx, by) : (I8)m_Transparent.idx();
+                break;
+            case FMT_RGBX8:
+                *dest.Ptr_RGBX8(x, y) = inside ? *m_Big->PtrConst_RGBX8(bx, by) : m_Transparent.toRGBX8();
+                break;
+            default:
+                assert(false);
+                break;
+            }
+        }
+    }
+}
+
+void RotScaler::RenderBilinear(Img& dest, float c, float s, float scale)
+{
+    const int sw = m_Src.W();
+    const int sh = m_Src.H();
+    const float ux = c / scale;
+    const float uy = -s / scale;
+    const float vx = s / scale;
+    const float vy = c / scale;
+    const float ox = dest.W() / 2.0f;
+    const float oy = dest.H() / 2.0f;
+    const RGBA8 clear(0, 0, 0, 0);
+
+    auto fetch = [&](int x, int y) -> RGBA8 {
+        if (x < 0 || x >= sw || y < 0 || y >= sh) {
+            return clear;
+        }
+        return *m_Src.PtrConst_RGBA8(x, y);
+    };
+
+    for (int y = 0; y < dest.H(); ++y) {
+        RGBA8* out = dest.Ptr_RGBA8(0, y);
+        float dy = (y + 0.5f) - oy;
+        float dx = 0.5f - ox;
+        // (the -0.5 puts us relative to source pixel centres)
+        float u = dx * ux + dy * vx + sw / 2.0f - 0.5f;
+        float v = dx * uy + dy * vy + sh / 2.0f - 0.5f;
+        for (int x = 0; x < dest.W(); ++x, u += ux, v += uy) {
+            float fu = std::floor(u);
+            float fv = std::floor(v);
+            int sx = (int)fu;
+            int sy = (int)fv;
+            out[x] = bilinear(fetch(sx, sy), fetch(sx + 1, sy),
+                fetch(sx, sy + 1), fetch(sx + 1, sy + 1),
+                u - fu, v - fv);
+        }
+    }
+}
+
@@ -0,0 +1,62 @@
+#ifndef ROTSCALE_H
+#define ROTSCALE_H
+
+#include "colours.h"
+#include "img.h"
+#include "point.h"
+
+#include <vector>
+
+// RotScaler rotates and scales an image (typically a brush) about its
+// centre, by any angle.
+//
+// Indexed (and RGBX8) images use RotSprite: the source is blown up 8x
+// with Scale2x, and that is sampled with nearest-neighbour. That keeps
+// lines clean and never introduces new colours.
+// RGBA8 images are bilinear filtered.
+// Areas not covered by the source are filled with the transparent colour.
+//
+// The 8x image is only made once, and results are cached (by angle and
+// scale), so dragging back and forth over the same values is cheap.
+// Always transforming from the original also means repeated rotations
+// don't degrade the image.
+class RotScaler
+{
+public:
+    enum { CACHE_SIZE = 16 };
+
+    RotScaler(Img const& src, PenColour const& transparent);
+    ~RotScaler();
+
+    Img const& Src() const { return m_Src; }
+
+    // Fetch the source rotated by angle (degrees, clockwise) and scaled.
+    // The result is owned by the RotScaler, and is valid until the next
+    // call.
+    Img const& Get(float angle, float scale);
+
+    // Where does a point in the source end up in Get()'s result?
+    Point Map(Point const& p, float angle, float scale) const;
+
+private:
+    RotScaler(RotScaler const&);    // disallowed
+
+    struct Entry {
+        int angle;      // in 1/10ths of a degree
+        int scale;      // in 1/100ths
+        Img* img;
+        unsigned int lastUsed;
+    };
+
+    Img* Render(int angle, int scale);
+    void RenderRotSprite(Img& dest, float c, float s, float scale);
+    void RenderBilinear(Img& dest, float c, float s, float scale);
+
+    Img m_Src;
+    Img* m_Big;     // 8x upscaled version of m_Src (RotSprite only)
+    PenColour m_Transparent;
+    std::vector<Entry> m_Cache;
+    unsigned int m_Clock;
+};
+
+#endif // ROTSCALE_H
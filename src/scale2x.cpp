@@ -1,78 +1,305 @@
+#include "scale2x.h"
 #include "img.h"
+#include "jobs.h"
+
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// All the scalers work on a copy of the image with every pixel packed into
+// a uint32_t key, so there's only one version of each algorithm, and the
+// inner loops are plain compares and selects (which the compiler can
+// vectorise).
+
+static inline uint32_t key(I8 c) { return c; }
+static inline uint32_t key(RGBX8 c) { return (c.r << 16) | (c.g << 8) | c.b; }
+static inline uint32_t key(RGBA8 c) { return ((uint32_t)c.a << 24) | (c.r << 16) | (c.g << 8) | c.b; }
+
+// An image full of keys, with a 1 pixel border replicating the edges.
+struct KeyImg
+{
+    int w;
+    int h;
+    std::vector<uint32_t> keys;
+
+    KeyImg(int width, int height) :
+        w(width),
+        h(height),
+        keys((width + 2) * (height + 2))
+    {}
+    uint32_t* Row(int y) { return &keys[(y + 1) * (w + 2) + 1]; }
+    uint32_t const* Row(int y) const { return &keys[(y + 1) * (w + 2) + 1]; }
+};
 
-// src1 is the current line, src0 the one above, src2 the one below
-// dest0 and dest1 are the output lines.
-static void doLine(const I8* src0, const I8* src1, const I8* src2, I8* dest0, I8* dest1, int srcw) {
-    // Using pixel naming convention from:
-    // https://en.wikipedia.org/wiki/Pixel-art_scaling_algorithms#EPX/Scale2%C3%97/AdvMAME2%C3%97
-    //   a     (src0)
-    // c p b   (src1-1, src1, src1+1)
-    //   d     (src2)
-    assert(srcw > 0);
-
-    I8 b = *src1++; // src leads by 1
-    I8 p = b;   // special case: duplicate first pixel
-    int i;
-    for (i=0; i<srcw-1; ++i) {
-        I8 a = *src0++;
-        I8 c = p;
-        p = b;
-        b = *src1++;
-        I8 d = *src2++;
-
-        *dest0++ = (c==a && c!=d && a!=b) ? a : p;  // 1
-        *dest0++ = (a==b && a!=c && b!=d) ? b : p;  // 2
-        *dest1++ = (d==c && d!=b && c!=a) ? c : p;  // 3
-        *dest1++ = (b==d && b!=a && d!=c) ? d : p;  // 4
+
+// Split the rows [0,h) up into bands and run fn(ymin, ymax) on each, on
+// the shared JobPool if it's worth it.
+// Cmds already run DoScale() as pool tasks (one per frame), so in that case
+// the bands are just done in turn.
+static void forBands(int h, int pixelsPerRow, std::function<void(int, int)> const& fn)
+{
+    const int minRows = std::max(1, (128 * 128) / std::max(1, pixelsPerRow));
+    int numBands = std::min((int)std::thread::hardware_concurrency(), h / minRows);
+    if (numBands <= 1 || JobPool::OnWorkerThread()) {
+        fn(0, h);
+        return;
     }
+    JobPool::Shared().ParallelFor(numBands, [&](int i) {
+        fn((h * i) / numBands, (h * (i + 1)) / numBands);
+    });
+}
 
-    // special case for last pixel (b is off image, so reuse last pixel)
-    {
-        I8 a = *src0++;
-        I8 c = p;
-        p = b;
-        I8 d = *src2++;
-
-        *dest0++ = (c==a && c!=d && a!=b) ? a : p;  // 1
-        *dest0++ = (a==b && a!=c && b!=d) ? b : p;  // 2
-        *dest1++ = (d==c && d!=b && c!=a) ? c : p;  // 3
-        *dest1++ = (b==d && b!=a && d!=c) ? d : p;  // 4
+
+static void pack(Img const& src, KeyImg& out, int ymin, int ymax)
+{
+    const int w = src.W();
+    for (int y = ymin; y < ymax; ++y) {
+        uint32_t* dest = out.Row(y);
+        switch (src.Fmt()) {
+        case FMT_I8:
+            {
+                I8 const* s = src.PtrConst_I8(0, y);
+                for (int x = 0; x < w; ++x) {
+                    dest[x] = key(s[x]);
+                }
+            }
+            break;
+        case FMT_RGBX8:
+            {
+                RGBX8 const* s = src.PtrConst_RGBX8(0, y);
+                for (int x = 0; x < w; ++x) {
+                    dest[x] = key(s[x]);
+                }
+            }
+            break;
+        case FMT_RGBA8:
+        case FMT_RGBA8PM:   // (pixels are only compared and copied)
+            {
+                RGBA8 const* s = src.PtrConst_RGBA8(0, y);
+                for (int x = 0; x < w; ++x) {
+                    dest[x] = key(s[x]);
+                }
+            }
+            break;
+        case FMT_I4:
+        case FMT_I2:
+        case FMT_I1:
+            for (int x = 0; x < w; ++x) {
+                dest[x] = key(src.GetIndex(x, y));
+            }
+            break;
+        default:
+            assert(false);
+            break;
+        }
+        dest[-1] = dest[0];
+        dest[w] = dest[w - 1];
     }
 }
 
+// replicate top and bottom rows into the border
+static void packBorders(KeyImg& out)
+{
+    std::copy(out.Row(0) - 1, out.Row(0) + out.w + 1, out.Row(-1) - 1);
+    std::copy(out.Row(out.h - 1) - 1, out.Row(out.h - 1) + out.w + 1, out.Row(out.h) - 1);
+}
 
-Img* DoScale2x(Img const& src) {
-    assert(src.Fmt() == FMT_I8);
-    assert(src.W() > 0 && src.H() > 0);
-    Img* dest = new Img(FMT_I8, src.W()*2, src.H()*2);
-
-    // special case for first line
-    doLine(src.PtrConst_I8(0, 0),  // replicated
-           src.PtrConst_I8(0, 0),
-           src.PtrConst_I8(0, 1),
-           dest->Ptr_I8(0, 0),
-           dest->Ptr_I8(0, 1),
-           src.W());
-    int y;
-    for (y=1; y<src.H()-1; ++y) {
-        doLine(src.PtrConst_I8(0, y-1),
-               src.PtrConst_I8(0, y),
-               src.PtrConst_I8(0, y+1),
-               dest->Ptr_I8(0, y*2),
-               dest->Ptr_I8(0, (y*2)+1),
-               src.W());
+static void unpackRow(uint32_t const* keys, Img& dest, int y)
+{
+    const int w = dest.W();
+    switch (dest.Fmt()) {
+    case FMT_I8:
+        {
+            I8* d = dest.Ptr_I8(0, y);
+            for (int x = 0; x < w; ++x) {
+                d[x] = (I8)keys[x];
+            }
+        }
+        break;
+    case FMT_RGBX8:
+        {
+            RGBX8* d = dest.Ptr_RGBX8(0, y);
+            for (int x = 0; x < w; ++x) {
+                uint32_t k = keys[x];
+                d[x] = RGBX8((k >> 16) & 0xff, (k >> 8) & 0xff, k & 0xff);
+            }
+        }
+        break;
+    case FMT_RGBA8:
+    case FMT_RGBA8PM:
+        {
+            RGBA8* d = dest.Ptr_RGBA8(0, y);
+            for (int x = 0; x < w; ++x) {
+                uint32_t k = keys[x];
+                d[x] = RGBA8((k >> 16) & 0xff, (k >> 8) & 0xff, k & 0xff, k >> 24);
+            }
+        }
+        break;
+    case FMT_I4:
+    case FMT_I2:
+    case FMT_I1:
+        for (int x = 0; x < w; ++x) {
+            dest.SetIndex(x, y, (I8)keys[x]);
+        }
+        break;
+    default:
+        assert(false);
+        break;
     }
-    if(y<src.H()) {
-        // special case for last line
-        doLine(src.PtrConst_I8(0, y-1),
-               src.PtrConst_I8(0, y),
-               src.PtrConst_I8(0, y),   // replicated
-               dest->Ptr_I8(0, y*2),
-               dest->Ptr_I8(0, (y*2)+1),
-               src.W());
+}
+
+
+// Using pixel naming convention from:
+// https://en.wikipedia.org/wiki/Pixel-art_scaling_algorithms
+//   A B C
+//   D E F
+//   G H I
+
+static void scale2xRow(KeyImg const& src, int y, uint32_t* out0, uint32_t* out1)
+{
+    uint32_t const* up = src.Row(y - 1);
+    uint32_t const* mid = src.Row(y);
+    uint32_t const* down = src.Row(y + 1);
+    for (int x = 0; x < src.w; ++x) {
+        uint32_t B = up[x];
+        uint32_t D = mid[x - 1];
+        uint32_t E = mid[x];
+        uint32_t F = mid[x + 1];
+        uint32_t H = down[x];
+        out0[x * 2 + 0] = (D == B && B != F && D != H) ? D : E;
+        out0[x * 2 + 1] = (B == F && B != D && F != H) ? F : E;
+        out1[x * 2 + 0] = (D == H && D != B && H != F) ? D : E;
+        out1[x * 2 + 1] = (H == F && D != H && B != F) ? F : E;
     }
-    return dest;
 }
 
+static void scale3xRow(KeyImg const& src, int y, uint32_t* out0, uint32_t* out1, uint32_t* out2)
+{
+    uint32_t const* up = src.Row(y - 1);
+    uint32_t const* mid = src.Row(y);
+    uint32_t const* down = src.Row(y + 1);
+    for (int x = 0; x < src.w; ++x) {
+        uint32_t A = up[x - 1];
+        uint32_t B = up[x];
+        uint32_t C = up[x + 1];
+        uint32_t D = mid[x - 1];
+        uint32_t E = mid[x];
+        uint32_t F = mid[x + 1];
+        uint32_t G = down[x - 1];
+        uint32_t H = down[x];
+        uint32_t I = down[x + 1];
+        bool db = (D == B && B != F && D != H);
+        bool bf = (B == F && B != D && F != H);
+        bool dh = (D == H && D != B && H != F);
+        bool hf = (H == F && D != H && B != F);
+        out0[x * 3 + 0] = db ? D : E;
+        out0[x * 3 + 1] = ((db && E != C) || (bf && E != A)) ? B : E;
+        out0[x * 3 + 2] = bf ? F : E;
+        out1[x * 3 + 0] = ((db && E != G) || (dh && E != A)) ? D : E;
+        out1[x * 3 + 1] = E;
+        out1[x * 3 + 2] = ((bf && E != I) || (hf && E != C)) ? F : E;
+        out2[x * 3 + 0] = dh ? D : E;
+        out2[x * 3 + 1] = ((hf && E != G) || (dh && E != I)) ? H : E;
+        out2[x * 3 + 2] = hf ? F : E;
+    }
+}
 
+static void eagleRow(KeyImg const& src, int y, uint32_t* out0, uint32_t* out1)
+{
+    uint32_t const* up = src.Row(y - 1);
+    uint32_t const* mid = src.Row(y);
+    uint32_t const* down = src.Row(y + 1);
+    for (int x = 0; x < src.w; ++x) {
+        uint32_t A = up[x - 1];
+        uint32_t B = up[x];
+        uint32_t C = up[x + 1];
+        uint32_t D = mid[x - 1];
+        uint32_t E = mid[x];
+        uint32_t F = mid[x + 1];
+        uint32_t G = down[x - 1];
+        uint32_t H = down[x];
+        uint32_t I = down[x + 1];
+        out0[x * 2 + 0] = (D == A && A == B) ? A : E;
+        out0[x * 2 + 1] = (B == C && C == F) ? C : E;
+        out1[x * 2 + 0] = (D == G && G == H) ? G : E;
+        out1[x * 2 + 1] = (F == I && I == H) ? I : E;
+    }
+}
+
+
+int ScaleFactor(ScaleMethod method)
+{
+    switch (method) {
+    case SCALE_2X: return 2;
+    case SCALE_3X: return 3;
+    case SCALE_4X: return 4;
+    case SCALE_EAGLE: return 2;
+    default:
+        assert(false);
+        return 1;
+    }
+}
+
+char const* ScaleMethodName(ScaleMethod method)
+{
+    switch (method) {
+    case SCALE_2X: return "Scale2x";
+    case SCALE_3X: return "Scale3x";
+    case SCALE_4X: return "Scale4x";
+    case SCALE_EAGLE: return "Eagle";
+    default:
+        assert(false);
+        return "";
+    }
+}
+
+
+Img* DoScale(Img const& src, ScaleMethod method)
+{
+    assert(src.W() > 0 && src.H() > 0);
+    if (method == SCALE_4X) {
+        Img* tmp = DoScale(src, SCALE_2X);
+        Img* dest = DoScale(*tmp, SCALE_2X);
+        delete tmp;
+        return dest;
+    }
+
+    const int f = ScaleFactor(method);
+    const int w = src.W();
+    const int h = src.H();
+    Img* dest = new Img(src.Fmt(), w * f, h * f);
+
+    KeyImg keys(w, h);
+    forBands(h, w, [&](int ymin, int ymax) {
+        pack(src, keys, ymin, ymax);
+    });
+    packBorders(keys);
+
+    forBands(h, w * f * f, [&](int ymin, int ymax) {
+        std::vector<uint32_t> out(w * f * f);
+        uint32_t* rows[3] = {&out[0], &out[w * f], (f > 2) ? &out[w * f * 2] : nullptr};
+        for (int y = ymin; y < ymax; ++y) {
+            switch (method) {
+            case SCALE_2X:
+                scale2xRow(keys, y, rows[0], rows[1]);
+                break;
+            case SCALE_3X:
+                scale3xRow(keys, y, rows[0], rows[1], rows[2]);
+                break;
+            case SCALE_EAGLE:
+                eagleRow(keys, y, rows[0], rows[1]);
+                break;
+            default:
+                assert(false);
+                break;
+            }
+            for (int i = 0; i < f; ++i) {
+                unpackRow(rows[i], *dest, y * f + i);
+            }
+        }
+    });
+    return dest;
+}
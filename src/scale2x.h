@@ -3,7 +3,25 @@
 
 class Img;
 
-// Create an image double the size of src, using the Scale2x algorithm.
-Img* DoScale2x(Img const& src);
+// Pixel-art upscalers.
+// These only ever copy existing pixels (compared exactly), so they work
+// on any pixel format and never introduce new colours.
+enum ScaleMethod {
+    SCALE_2X=0,     // Scale2x (aka AdvMAME2x, which gives the same results as EPX)
+    SCALE_3X,       // Scale3x
+    SCALE_4X,       // Scale2x, applied twice
+    SCALE_EAGLE,    // Eagle (2x)
+    SCALE_NUM_METHODS
+};
+
+// How much bigger the given method makes things.
+int ScaleFactor(ScaleMethod method);
+
+// Human-readable name, for menus etc.
+char const* ScaleMethodName(ScaleMethod method);
+
+// Create a scaled-up copy of src.
+// Big images are split up and processed on multiple threads.
+Img* DoScale(Img const& src, ScaleMethod method);
 
 #endif
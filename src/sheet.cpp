@@ -2,6 +2,7 @@
 #include "blit.h"
 #include "draw.h"
 #include "img.h"
+#include "jobs.h"
 #include "layer.h"
 #include "lexer.h"
 
@@ -116,33 +117,38 @@ bool SpriteGrid::Parse(std::string input, Box const& imgbounds)
 }
 
 
-Img* FramesToSpriteSheet(std::vector<Frame*> const& frames, SpriteGrid const& grid)
+Img* FramesToSpriteSheet(std::vector<Frame*> const& frames, SpriteGrid const& grid, Job* job)
 {
     assert(!frames.empty());
     std::vector<Box> cells;
     grid.Layout(cells);
     Box destBounds = grid.Extent();
     Img *dest = new Img(frames[0]->mImg->Fmt(), destBounds.w, destBounds.h);
-    for (unsigned int i = 0; i < cells.size(); ++i) {
+    // (cells don't overlap, so they can all be blitted at once)
+    JobPool::Shared().ParallelFor((int)cells.size(), [&](int i) {
         Img const& srcImg = *frames[i]->mImg;
-        Blit(srcImg, srcImg.Bounds(), *dest, cells[i]);
-    }
+        Box cell = cells[i];
+        Blit(srcImg, srcImg.Bounds(), *dest, cell);
+    }, job);
     return dest;
 }
 
 
 // split up a sprite sheet into multiple frames
-void FramesFromSpriteSheet(Img const& src, SpriteGrid const& grid, std::vector<Img*>& destFrames)
+void FramesFromSpriteSheet(Img const& src, SpriteGrid const& grid, std::vector<Img*>& destFrames, Job* job)
 {
     std::vector<Box> cells;
     grid.Layout(cells);
 
-    for(auto cell : cells) {
+    size_t first = destFrames.size();
+    destFrames.resize(first + cells.size(), nullptr);
+    JobPool::Shared().ParallelFor((int)cells.size(), [&](int i) {
+        Box cell = cells[i];
         Img* dest = new Img(src.Fmt(), cell.w, cell.h);
         Box destBox = dest->Bounds();
         Blit(src, cell, *dest, destBox);
-        destFrames.push_back(dest);
-    }
+        destFrames[first + i] = dest;
+    }, job);
 }
 
 
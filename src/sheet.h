@@ -10,6 +10,7 @@
 class Img;
 class Layer;
 class Frame;
+class Job;
 
 // Struct to describe how to lay out sprites on a regular grid.
 struct SpriteGrid
@@ -50,9 +51,13 @@ struct SpriteGrid
 
 // FramesToSpriteSheet() creates a spritesheet image from a sequence of frames.
 // The frames are laid out according to the grid.
-Img* FramesToSpriteSheet(std::vector<Frame*> const& frames, SpriteGrid const& grid);
+// The cells are done in parallel, tracked by job (if set).
+Img* FramesToSpriteSheet(std::vector<Frame*> const& frames, SpriteGrid const& grid, Job* job = nullptr);
 
-void FramesFromSpriteSheet(Img const& src, SpriteGrid const& grid, std::vector<Img*>& destFrames);
+// FramesFromSpriteSheet() cuts the cells of a spritesheet out into separate
+// images (appended to destFrames). If job is cancelled, some of them will
+// be null.
+void FramesFromSpriteSheet(Img const& src, SpriteGrid const& grid, std::vector<Img*>& destFrames, Job* job = nullptr);
 
 
 #endif // SHEET_H
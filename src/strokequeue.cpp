@@ -0,0 +1,73 @@
+#include "strokequeue.h"
+#include "project.h"
+#include "tool.h"
+
+#include <vector>
+
+
+StrokeQueue::StrokeQueue(Project& proj, std::function<void()> const& drawn) :
+    m_Proj(proj),
+    m_Drawn(drawn),
+    m_Busy(false),
+    m_Quit(false)
+{
+    m_Worker = std::thread(&StrokeQueue::Run, this);
+}
+
+StrokeQueue::~StrokeQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Quit = true;
+    }
+    m_Wake.notify_one();
+    m_Worker.join();
+}
+
+void StrokeQueue::Push(Tool& tool, EditView& view, Point const& pos)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Moves.push_back(Move{&tool, &view, pos});
+    }
+    m_Wake.notify_one();
+}
+
+void StrokeQueue::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Idle.wait(lock, [this] { return m_Moves.empty() && !m_Busy; });
+}
+
+void StrokeQueue::Run()
+{
+    std::vector<Move> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Wake.wait(lock, [this] { return m_Quit || !m_Moves.empty(); });
+            if (m_Moves.empty()) {
+                return; // quitting
+            }
+            batch.assign(m_Moves.begin(), m_Moves.end());
+            m_Moves.clear();
+            m_Busy = true;
+        }
+
+        {
+            std::lock_guard<std::recursive_mutex> projLock(m_Proj.Mutex());
+            m_Proj.DeferDamage(true);
+            for (auto const& m : batch) {
+                m.tool->OnMove(*m.view, m.pos);
+            }
+            m_Proj.DeferDamage(false);
+        }
+
+        m_Drawn();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Busy = false;
+        }
+        m_Idle.notify_all();
+    }
+}
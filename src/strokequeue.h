@@ -0,0 +1,72 @@
+#ifndef STROKEQUEUE_H
+#define STROKEQUEUE_H
+
+#include "point.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class EditView;
+class Project;
+class Tool;
+
+// StrokeQueue runs tool mouse-moves on a worker thread, so rasterising a
+// stroke doesn't hold up the GUI (and the stroke doesn't lag behind the
+// pointer when the GUI is busy).
+//
+// Ordering/locking:
+// - Moves are processed strictly in the order they were pushed. The worker takes all the pending ones in one go, and runs
+//   them with the project mutex held.
+// - Project damage is deferred while the worker has the mutex, so
+//   listeners are only ever called on the GUI thread (when it calls
+//   Project::DeliverDeferredDamage()).
+// - Only tools which say they're Stroking() have moves queued. Their
+//   OnMove() must only draw into the project - no cursors, no GUI, no
+//   Cmds.
+// - Everything else (button down/up, Cmd commits, tool changes etc) stays
+//   on the GUI thread, which calls Flush() first. So a stroke's Cmd is
+//   always committed after all of its moves have been drawn.
+class StrokeQueue
+{
+public:
+    // drawn is called (on the worker thread) after each batch of moves
+    // has been drawn, so the GUI can arrange to deliver the damage.
+    StrokeQueue(Project& proj, std::function<void()> const& drawn);
+    ~StrokeQueue();
+
+    // (GUI thread) Queue up a call to tool.OnMove(view, pos).
+    void Push(Tool& tool, EditView& view, Point const& pos);
+
+    // (GUI thread) Wait until all queued moves have been drawn.
+    // Don't call this with the project mutex held if there might be
+    // moves still queued.
+    void Flush();
+
+private:
+    StrokeQueue(StrokeQueue const&);    // disallowed
+
+    struct Move {
+        Tool* tool;
+        EditView* view;
+        Point pos;
+    };
+
+    void Run();
+
+    Project& m_Proj;
+    std::function<void()> m_Drawn;
+
+    // shared with worker (guarded by m_Mutex)
+    std::thread m_Worker;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;     // signalled when moves are pushed
+    std::condition_variable m_Idle;     // signalled when queue drained
+    std::deque<Move> m_Moves;
+    bool m_Busy;
+    bool m_Quit;
+};
+
+#endif // STROKEQUEUE_H
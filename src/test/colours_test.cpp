@@ -1,9 +1,12 @@
-// $ g++ -I .. colours_test.cpp ../colours.cpp
+// $ g++ -I .. colours_test.cpp ../colours.cpp ../blend.cpp
 // $ ./a.out || echo "FAILED"
 
 #include "colours.h"
+#include "blend.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <vector>
 
 static int fails = 0;
 
@@ -31,6 +34,88 @@ static void checkBad(const char* hex) {
     }
 }
 
+static void checkDiv255() {
+    // the documented range: any weighted sum of 8-bit channels
+    for (unsigned x = 0; x <= 255*255 + 637; ++x) {
+        if (Div255(x) != (x + 127) / 255) {
+            ++fails;
+            fprintf(stderr, "Div255(%u) = %u, expected %u\n", x, Div255(x), (x + 127) / 255);
+            return;
+        }
+    }
+}
+
+static void checkBlend(RGBA8 src, RGBA8 dest, RGBA8 expect) {
+    RGBA8 got = Blend(src, dest);
+    if (got != expect) {
+        ++fails;
+        fprintf(stderr, "Blend() got %d,%d,%d,%d expected %d,%d,%d,%d\n",
+            got.r, got.g, got.b, got.a,
+            expect.r, expect.g, expect.b, expect.a);
+    }
+}
+
+// random pixel, biased towards the alphas the span code treats specially
+static RGBA8 randomPixel() {
+    static const uint8_t alphas[] = {0, 255, 1, 254, 128};
+    int i = rand() % 8;
+    uint8_t a = (i < 5) ? alphas[i] : (uint8_t)(rand() & 255);
+    return RGBA8(rand() & 255, rand() & 255, rand() & 255, a);
+}
+
+// Check the span functions match Blend() pixel for pixel.
+// Runs of uniform alpha are mixed in, so the whole-block fast paths get
+// used as well as the per-pixel ones.
+static void checkSpans() {
+    const int w = 77;   // not a multiple of the block size
+    for (int pass = 0; pass < 2000; ++pass) {
+        std::vector<RGBA8> src(w);
+        std::vector<RGBA8> dest(w);
+        for (int x = 0; x < w; ++x) {
+            src[x] = randomPixel();
+            dest[x] = randomPixel();
+        }
+        if (pass & 1) {
+            uint8_t a = randomPixel().a;
+            for (int x = 0; x < w / 2; ++x) {
+                src[x].a = a;
+            }
+        }
+        if (pass & 2) {
+            uint8_t a = randomPixel().a;
+            for (int x = w / 3; x < w; ++x) {
+                dest[x].a = a;
+            }
+        }
+        RGBA8 c = randomPixel();
+
+        std::vector<RGBA8> span(dest);
+        std::vector<RGBA8> fill(dest);
+        std::vector<RGBX8> spanX(w);
+        std::vector<RGBX8> fillX(w);
+        for (int x = 0; x < w; ++x) {
+            spanX[x] = RGBX8(dest[x].r, dest[x].g, dest[x].b);
+        }
+        fillX = spanX;
+        BlendSpan(src.data(), span.data(), w);
+        BlendFill(c, fill.data(), w);
+        BlendSpan(src.data(), spanX.data(), w);
+        BlendFill(c, fillX.data(), w);
+
+        for (int x = 0; x < w; ++x) {
+            RGBX8 destX(dest[x].r, dest[x].g, dest[x].b);
+            if (span[x] != Blend(src[x], dest[x]) ||
+                fill[x] != Blend(c, dest[x]) ||
+                spanX[x] != Blend(src[x], destX) ||
+                fillX[x] != Blend(c, destX)) {
+                ++fails;
+                fprintf(stderr, "span/fill doesn't match Blend() (pass %d, x=%d)\n", pass, x);
+                return;
+            }
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
 
     check("#777", Colour(0x77, 0x77, 0x77, 0xff));
@@ -43,6 +128,25 @@ int main(int argc, char* argv[]) {
     checkBad("random words");
 
     checkBad("6789abcd");   // no leading '#'
+
+    checkDiv255();
+
+    // RGBX8 dest rounds to nearest
+    RGBX8 x = Blend(RGBA8(254, 128, 0, 1), RGBX8(0, 0, 0));
+    if (x != RGBX8(1, 1, 0)) {
+        ++fails;
+        fprintf(stderr, "Blend() onto RGBX8 got %d,%d,%d\n", x.r, x.g, x.b);
+    }
+
+    // RGBA8 dest alpha is taken into account
+    checkBlend(RGBA8(10, 20, 30, 0), RGBA8(1, 2, 3, 4), RGBA8(1, 2, 3, 4));
+    checkBlend(RGBA8(10, 20, 30, 255), RGBA8(1, 2, 3, 4), RGBA8(10, 20, 30, 255));
+    checkBlend(RGBA8(10, 20, 30, 40), RGBA8(1, 2, 3, 0), RGBA8(10, 20, 30, 40));
+    checkBlend(RGBA8(255, 0, 0, 128), RGBA8(0, 0, 255, 255), RGBA8(128, 0, 127, 255));
+    checkBlend(RGBA8(255, 0, 0, 128), RGBA8(0, 0, 255, 128), RGBA8(170, 0, 85, 192));
+    checkBlend(RGBA8(0, 255, 0, 64), RGBA8(200, 0, 0, 32), RGBA8(54, 186, 0, 88));
+
+    checkSpans();
     return (fails > 0) ? 1 : 0;
 }
 
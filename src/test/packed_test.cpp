@@ -0,0 +1,175 @@
+// $ g++ -I .. packed_test.cpp ../img.cpp ../blit.cpp ../img_convert.cpp ../colourmatch.cpp ../palette.cpp ../colours.cpp ../blend.cpp ../box.cpp ../exception.cpp ../util.cpp
+// $ ./a.out || echo "FAILED"
+
+// Checks the whole-byte kernels for the packed formats (fills, flips and
+// bit copies) against a plain pixel-at-a-time version.
+
+#include "blit.h"
+#include "box.h"
+#include "img.h"
+#include "img_convert.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static int fails = 0;
+
+static const PixelFormat packedFmts[] = {FMT_I4, FMT_I2, FMT_I1};
+
+// one I8 per pixel, via GetIndex()
+typedef std::vector<I8> Pixels;
+
+static Pixels pixels(Img const& img) {
+    Pixels out;
+    for (int y = 0; y < img.H(); ++y) {
+        for (int x = 0; x < img.W(); ++x) {
+            out.push_back(img.GetIndex(x, y));
+        }
+    }
+    return out;
+}
+
+static void randomise(Img& img) {
+    for (int y = 0; y < img.H(); ++y) {
+        for (int x = 0; x < img.W(); ++x) {
+            img.SetIndex(x, y, (I8)(rand() & 0xff));
+        }
+    }
+}
+
+static bool same(const char* what, PixelFormat fmt, Pixels const& got, Pixels const& expect) {
+    if (got != expect) {
+        ++fails;
+        fprintf(stderr, "%s: wrong result for %d bits/pixel\n", what, FmtBits(fmt));
+        return false;
+    }
+    return true;
+}
+
+// HLine() fills whole bytes, masking only the ends.
+static void checkFill(PixelFormat fmt) {
+    const int w = 37;
+    const int mask = (1 << FmtBits(fmt)) - 1;
+    for (int begin = 0; begin <= w; ++begin) {
+        for (int end = begin; end <= w; ++end) {
+            Img img(fmt, w, 2);
+            randomise(img);
+            Pixels expect = pixels(img);
+            // (out of range indices are masked)
+            int idx = rand() & 0xff;
+            img.HLine(PenColour(Colour(0, 0, 0), idx), begin, end, 1);
+            for (int x = begin; x < end; ++x) {
+                expect[w + x] = (I8)(idx & mask);
+            }
+            if (!same("HLine", fmt, pixels(img), expect)) {
+                return;
+            }
+        }
+    }
+}
+
+// XFlip() reverses bytes, then the pixels within them.
+static void checkFlip(PixelFormat fmt) {
+    for (int w = 1; w <= 40; ++w) {
+        Img img(fmt, w, 3);
+        randomise(img);
+        Pixels expect = pixels(img);
+        img.XFlip();
+        for (int y = 0; y < 3; ++y) {
+            for (int x = 0; x < w / 2; ++x) {
+                std::swap(expect[y * w + x], expect[y * w + (w - 1 - x)]);
+            }
+        }
+        if (!same("XFlip", fmt, pixels(img), expect)) {
+            return;
+        }
+    }
+}
+
+// Blit() and BlitSwap() copy bit ranges, at any alignment.
+static void checkCopy(PixelFormat fmt) {
+    const int sw = 29;
+    const int dw = 31;
+    Img src(fmt, sw, 2);
+    randomise(src);
+    Pixels srcPix = pixels(src);
+    for (int sx = 0; sx < sw; ++sx) {
+        for (int dx = 0; dx < dw; ++dx) {
+            for (int n = 1; sx + n <= sw; ++n) {
+                Img dest(fmt, dw, 2);
+                randomise(dest);
+                Pixels expect = pixels(dest);
+                Box destbox(dx, 1, 0, 0);
+                Blit(src, Box(sx, 1, n, 1), dest, destbox);
+                for (int x = 0; x < n && dx + x < dw; ++x) {
+                    expect[dw + dx + x] = srcPix[sw + sx + x];
+                }
+                if (!same("Blit", fmt, pixels(dest), expect)) {
+                    return;
+                }
+
+                // swapping again should put both back
+                Img a(src);
+                Img b(dest);
+                Pixels before = pixels(b);
+                destbox = Box(dx, 0, 0, 0);
+                BlitSwap(a, Box(sx, 0, n, 2), b, destbox);
+                destbox = Box(dx, 0, 0, 0);
+                BlitSwap(a, Box(sx, 0, n, 2), b, destbox);
+                if (!same("BlitSwap (src)", fmt, pixels(a), srcPix) ||
+                    !same("BlitSwap (dest)", fmt, pixels(b), before)) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+// UnpackArea()/PackArea() at any alignment.
+static void checkPacking(PixelFormat fmt) {
+    const int w = 23;
+    Img img(fmt, w, 2);
+    randomise(img);
+    Pixels pix = pixels(img);
+    for (int x = 0; x < w; ++x) {
+        for (int n = 0; x + n <= w; ++n) {
+            Img* tmp = UnpackArea(img, Box(x, 1, n, 1));
+            for (int i = 0; i < n; ++i) {
+                if (*tmp->PtrConst_I8(i, 0) != pix[w + x + i]) {
+                    ++fails;
+                    fprintf(stderr, "UnpackArea: wrong result for %d bits/pixel\n", FmtBits(fmt));
+                    delete tmp;
+                    return;
+                }
+                *tmp->Ptr_I8(i, 0) = (I8)(rand() & 0xff);
+            }
+            Pixels expect = pixels(img);
+            for (int i = 0; i < n; ++i) {
+                expect[w + x + i] = *tmp->PtrConst_I8(i, 0) & ((1 << FmtBits(fmt)) - 1);
+            }
+            PackArea(*tmp, img, Point(x, 1));
+            delete tmp;
+            if (!same("PackArea", fmt, pixels(img), expect)) {
+                return;
+            }
+            pix = expect;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    srand(1234);
+    for (PixelFormat fmt : packedFmts) {
+        checkFill(fmt);
+        checkFlip(fmt);
+        checkCopy(fmt);
+        checkPacking(fmt);
+    }
+
+    if (fails > 0) {
+        fprintf(stderr, "%d failures\n", fails);
+        return 1;
+    }
+    return 0;
+}
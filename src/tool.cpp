@@ -3,9 +3,7 @@
 #include "draw.h"
 #include "blit.h"
 #include "blit_keyed.h"
-#include "blit_matte.h"
 #include "blit_range.h"
-#include "blit_zoom.h"
 #include "draw.h"
 #include "project.h"
 #include "editor.h"
@@ -13,6 +11,7 @@
 #include "cmd.h"
 #include "global.h"
 #include "brush.h"
+#include "img_convert.h"
 
 #include <algorithm>    // for min,max
 #include <cstdlib>      // for std::abs
@@ -159,7 +158,7 @@ static void PlonkBrushToViewFG( EditView& view, Point const& pos, Box& viewdmg )
     {
         // force mode to COLOUR when blitting rgb brush onto I8 layer
         PixelFormat layerfmt = view.FocusedImgConst().Fmt();
-        if (layerfmt==FMT_I8 && b.Fmt() != FMT_I8)
+        if (FmtIsIndexed(layerfmt) && b.Fmt() != FMT_I8)
                 dm.mode = DrawMode::DM_COLOUR;
 
         // force mask brushes to use pen colour
@@ -170,21 +169,17 @@ static void PlonkBrushToViewFG( EditView& view, Point const& pos, Box& viewdmg )
     switch (dm.mode)
     {
         case DrawMode::DM_NORMAL:
-            BlitZoomKeyed( b, b.Bounds(),
-                view.FocusedPaletteConst(),
-                view.Canvas(), viewdmg,
-                view.XZoom(),
-                view.YZoom(),
-                b.TransparentColour());
+            view.BrushCursor().Draw( b, view.FocusedPaletteConst(),
+                view.XZoom(), view.YZoom(), view.Shrink(),
+                false, pen,
+                view.Canvas(), viewdmg.TopLeft() );
             break;
         case DrawMode::DM_COLOUR:
         case DrawMode::DM_RANGE:
-            BlitZoomMatteKeyed( b, b.Bounds(),
-                view.Canvas(), viewdmg,
-                view.XZoom(),
-                view.YZoom(),
-                b.TransparentColour(),
-                pen );
+            view.BrushCursor().Draw( b, view.FocusedPaletteConst(),
+                view.XZoom(), view.YZoom(), view.Shrink(),
+                true, pen,
+                view.Canvas(), viewdmg.TopLeft() );
             break;
         default:
             break;
@@ -200,12 +195,10 @@ static void PlonkBrushToViewBG( EditView& view, Point const& pos, Box& viewdmg )
 
     viewdmg = view.ProjToView( pb );
 
-    BlitZoomMatteKeyed( b, b.Bounds(),
-        view.Canvas(), viewdmg,
-        view.XZoom(),
-        view.YZoom(),
-        b.TransparentColour(),
-        view.Ed().BGPen() );
+    view.BrushCursor().Draw( b, view.FocusedPaletteConst(),
+        view.XZoom(), view.YZoom(), view.Shrink(),
+        true, view.Ed().BGPen(),
+        view.Canvas(), viewdmg.TopLeft() );
 }
 
 
@@ -220,19 +213,92 @@ static void PlonkBrushToView( EditView& view, Point const& pos, Box& viewdmg, Bu
 
 
 
-// helper to draw the current brush on the project, using the current editor settings
-static void PlonkBrushToProj(EditView& view, Point const& pos, Box& projdmg, Button button)
+// Helper to draw the current brush on the project, using the current
+// editor settings.
+// All the setup (brush, draw mode, pen, target) is done once, up front, so
+// a whole batch of points can be stamped in one go.
+// 1x1 brushes skip the blitting altogether and are drawn as spans.
+class BrushStamper
 {
-    Editor& ed = view.Ed();
-    Brush const& brush = ed.CurrentBrush();
-    Box dmg = brush.Bounds();
-    dmg.Translate(pos);
-    dmg.Translate(-brush.Handle());
+public:
+    BrushStamper(EditView& view, Button button, DrawTransaction& tx);
+    ~BrushStamper();
+
+    // Stamp the brush at each point, and add the damage to the transaction.
+    void Stamp(std::vector<Point> const& pts);
+    void Stamp(Point const& pos);
+
+    // the image being drawn on
+    NodePath const& Focus() const { return m_Focus; }
+    int Frame() const { return m_Frame; }
+
+private:
+    BrushStamper(BrushStamper const&);  // disallowed
+
+    void StampBrush(Point const& pos, Box& dmg);
+    void StampSpan(Box& span);
+    void Fill(PenColour const& pen, Box& span);
+    void AddDamage(Box const& dmg);
+    void FlushDamage();
+
+    DrawTransaction& m_Tx;
+    Brush m_Brush;      // (a copy, so it can't change under us)
+    NodePath m_Focus;
+    int m_Frame;
+    Img& m_Target;
+    DrawMode::Mode m_Mode;
+    PenColour m_Pen;
+    RangeShift* m_Shift;    // for DM_RANGE
+
+    bool m_Blend;       // composite over RGB targets (rather than replace)?
+    bool m_SolidFill;   // can solid brush runs be filled with a pen?
+    bool m_Pixel;       // 1x1 brush?
+    bool m_Clear;       // 1x1 brush is transparent (so draws nothing)
+    PenColour m_PixelPen;   // colour to draw 1x1 brush with
+
+    Box m_Pending;      // damage not yet passed on to m_Tx
+};
+
+// Damage is passed on in chunks, so a long diagonal stroke doesn't end up
+// as one huge box.
+static const int DAMAGE_BATCH = 64;
 
-    Img& target = view.FocusedImg();
+// The colour of a brush pixel, as a pen.
+static PenColour brushPen(Brush const& brush, int x, int y)
+{
+    switch (brush.Fmt()) {
+        case FMT_I8:
+            {
+                I8 c = *brush.PtrConst_I8(x, y);
+                return PenColour(brush.GetPalette().GetColour(c), c);
+            }
+        case FMT_RGBX8:
+            return PenColour(Colour(*brush.PtrConst_RGBX8(x, y)));
+        case FMT_RGBA8:
+            return PenColour(*brush.PtrConst_RGBA8(x, y));
+        default:
+            assert(false);
+            return PenColour();
+    }
+}
+
+BrushStamper::BrushStamper(EditView& view, Button button, DrawTransaction& tx) :
+    m_Tx(tx),
+    m_Brush(view.Ed().CurrentBrush()),
+    m_Focus(view.Focus()),
+    m_Frame(view.Frame()),
+    m_Target(view.FocusedImg()),
+    m_Shift(nullptr),
+    m_Blend(button==DRAW),
+    m_SolidFill(false),
+    m_Pixel(false),
+    m_Clear(false),
+    m_Pending(0,0,0,0)
+{
+    Editor& ed = view.Ed();
     DrawMode dm = ed.Mode();
 
-    PenColour pen = (button==DRAW) ? ed.FGPen() : ed.BGPen();
+    m_Pen = (button==DRAW) ? ed.FGPen() : ed.BGPen();
 
     if (dm.mode == DrawMode::DM_NORMAL)
     {
@@ -240,46 +306,196 @@ static void PlonkBrushToProj(EditView& view, Point const& pos, Box& projdmg, But
             dm.mode = DrawMode::DM_COLOUR;
 
         // force mask brushes to use pen colour
-        if (brush.Style()==MASK)
+        if (m_Brush.Style()==MASK)
             dm.mode = DrawMode::DM_COLOUR;
 
         // fudge if blitting rgb brush onto I8 image
         // draw in COLOUR mode instead.
         // TODO: work out a decent remapping-on-the-fly scheme :-)
-        if (target.Fmt()==FMT_I8 && brush.Fmt()!=FMT_I8)
+        if (FmtIsIndexed(m_Target.Fmt()) && m_Brush.Fmt()!=FMT_I8)
             dm.mode = DrawMode::DM_COLOUR;
     }
+    m_Mode = dm.mode;
 
- 
-    switch (dm.mode)
+    if (m_Mode == DrawMode::DM_RANGE) {
+        std::vector<PenColour> range;
+        view.FocusedRange(range);
+        m_Shift = new RangeShift(range, (button == DRAW) ? 1 : -1, m_Target.Fmt());
+    }
+
+    // A brush pixel only makes a usable pen if the target can take its
+    // colour directly - an RGB brush pixel has no index for an indexed
+    // target. Otherwise solid runs go through the keyed blit like the rest.
+    m_SolidFill = (!FmtIsIndexed(m_Target.Fmt()) || m_Brush.Fmt() == FMT_I8);
+
+    if (m_Brush.W() == 1 && m_Brush.H() == 1 &&
+        (m_SolidFill || m_Mode != DrawMode::DM_NORMAL)) {
+        m_Pixel = true;
+        int n;
+        m_Brush.Runs(0, n);
+        m_Clear = (n == 0);
+        m_PixelPen = brushPen(m_Brush, 0, 0);
+        if (m_Mode == DrawMode::DM_COLOUR) {
+            m_PixelPen = m_Pen;
+        }
+    }
+}
+
+BrushStamper::~BrushStamper()
+{
+    delete m_Shift;
+}
+
+void BrushStamper::Stamp(Point const& pos)
+{
+    Stamp(std::vector<Point>(1, pos));
+}
+
+void BrushStamper::Stamp(std::vector<Point> const& pts)
+{
+    if (!m_Pixel) {
+        for (auto const& p : pts) {
+            Box dmg;
+            StampBrush(p, dmg);
+            AddDamage(dmg);
+        }
+        FlushDamage();
+        return;
+    }
+
+    if (m_Clear) {
+        return;
+    }
+    // gather up runs of adjacent pixels on the same row
+    size_t i = 0;
+    while (i < pts.size()) {
+        int y = pts[i].y;
+        int xmin = pts[i].x;
+        int xmax = xmin;
+        for (++i; i < pts.size() && pts[i].y == y; ++i) {
+            if (pts[i].x == xmax + 1) {
+                xmax = pts[i].x;
+            } else if (pts[i].x == xmin - 1) {
+                xmin = pts[i].x;
+            } else {
+                break;
+            }
+        }
+        Box span(xmin, y, (xmax + 1) - xmin, 1);
+        StampSpan(span);
+        AddDamage(span);
+    }
+    FlushDamage();
+}
+
+// Stamp the brush by walking its opaque runs, so transparent pixels are
+// skipped entirely. Runs of a single colour are just filled.
+void BrushStamper::StampBrush(Point const& pos, Box& dmg)
+{
+    Brush const& brush = m_Brush;
+    Point origin = pos - brush.Handle();
+    dmg = brush.Bounds();
+    dmg.Translate(origin);
+    dmg.ClipAgainst(m_Target.Bounds());
+    if (dmg.Empty()) {
+        return;
+    }
+    if (m_Mode != DrawMode::DM_NORMAL && m_Mode != DrawMode::DM_COLOUR &&
+        m_Mode != DrawMode::DM_RANGE) {
+        dmg.SetEmpty();
+        return;
+    }
+
+    // the visible part of the brush, in brush coords
+    const int xmin = dmg.XMin() - origin.x;
+    const int xmax = dmg.XMax() - origin.x;
+    for (int by = dmg.YMin() - origin.y; by <= dmg.YMax() - origin.y; ++by) {
+        int n;
+        Brush::Run const* run = brush.Runs(by, n);
+        for (; n > 0; --n, ++run) {
+            int x0 = std::max(run->x, xmin);
+            int x1 = std::min(run->x + run->len - 1, xmax);
+            if (x0 > x1) {
+                continue;
+            }
+            Box span(x0 + origin.x, by + origin.y, (x1 - x0) + 1, 1);
+            switch (m_Mode)
+            {
+                case DrawMode::DM_NORMAL:
+                    if (run->solid && m_SolidFill) {
+                        Fill(brushPen(brush, run->x, by), span);
+                    } else {
+                        BlitTransparent(brush, Box(x0, by, span.w, 1),
+                            brush.GetPalette(),
+                            m_Target, span,
+                            brush.TransparentColour());
+                    }
+                    break;
+                case DrawMode::DM_COLOUR:
+                    Fill(m_Pen, span);
+                    break;
+                case DrawMode::DM_RANGE:
+                    DrawRectRangeShift(m_Target, span, *m_Shift);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// Draw a run of 1x1 brush stamps (span is clipped to the affected area).
+void BrushStamper::StampSpan(Box& span)
+{
+    switch (m_Mode)
     {
         case DrawMode::DM_NORMAL:
-            BlitTransparent( brush,
-                brush.Bounds(),
-                brush.GetPalette(),
-                target, dmg,
-                brush.TransparentColour() );
-            break;
         case DrawMode::DM_COLOUR:
-            BlitMatte( brush, brush.Bounds(),
-                target, dmg,
-                brush.TransparentColour(), pen );
+            Fill(m_PixelPen, span);
             break;
         case DrawMode::DM_RANGE:
-            {
-                std::vector<PenColour> range;
-                view.FocusedRange(range);
-                BlitRangeShiftKeyed(brush, brush.Bounds(),
-                    target, dmg,
-                    brush.TransparentColour(),
-                    range,
-                    (button == DRAW) ? 1 : -1);
-            }
+            DrawRectRangeShift(m_Target, span, *m_Shift);
             break;
         default:
+            span.SetEmpty();
             break;
     }
-    projdmg=dmg;
+}
+
+void BrushStamper::Fill(PenColour const& pen, Box& span)
+{
+    if (m_Blend) {
+        m_Target.BlendBox(pen, span);
+    } else {
+        m_Target.FillBox(pen, span);
+    }
+}
+
+void BrushStamper::AddDamage(Box const& dmg)
+{
+    if (dmg.Empty()) {
+        return;
+    }
+    if (m_Pending.Empty()) {
+        m_Pending = dmg;
+        return;
+    }
+    Box merged(m_Pending);
+    merged.Merge(dmg);
+    if (merged.w > DAMAGE_BATCH || merged.h > DAMAGE_BATCH) {
+        FlushDamage();
+        m_Pending = dmg;
+    } else {
+        m_Pending = merged;
+    }
+}
+
+void BrushStamper::FlushDamage()
+{
+    if (!m_Pending.Empty()) {
+        m_Tx.AddDamage(m_Pending);
+        m_Pending.SetEmpty();
+    }
 }
 
 
@@ -314,12 +530,15 @@ PencilTool::PencilTool( Editor& owner ) :
     m_Pos(0,0),
     m_DownButton(NONE),
     m_View(0),
-    m_Tx(0)
+    m_Joined(true),
+    m_Tx(0),
+    m_Stamper(0)
 {
 }
 
 PencilTool::~PencilTool()
 {
+    delete m_Stamper;
     if(m_Tx)
         delete m_Tx;
 }
@@ -335,14 +554,20 @@ void PencilTool::OnDown( EditView& view, Point const& p, Button b )
     m_View = &view;
     assert(m_Tx==0);
     m_Tx = new DrawTransaction(view.Proj());
+    // Everything the stroke needs is grabbed now, as the rest of it
+    // is drawn on the stroke worker thread.
+    m_Stamper = new BrushStamper(view, m_DownButton, *m_Tx);
+    // feels 'wrong' to do continuous lines if grid is on...
+    m_Joined = !Owner().GridActive();
 
     // draw 1st pixel
-    m_Tx->BeginDamage(view.Focus(), view.Frame());
-    Plot_cb( p.x, p.y, (void*)this );
+    m_Tx->BeginDamage(m_Stamper->Focus(), m_Stamper->Frame());
+    m_Stamper->Stamp(p);
     m_Tx->EndDamage();
 }
 
-void PencilTool::OnMove( EditView& view, Point const& p)
+// NOTE: called on the stroke worker thread while drawing (see Stroking())
+void PencilTool::OnMove( EditView& , Point const& p)
 {
     if( m_DownButton == NONE )
     {
@@ -350,15 +575,17 @@ void PencilTool::OnMove( EditView& view, Point const& p)
         return;
     }
 
-    assert(m_Tx);
-    m_Tx->BeginDamage(view.Focus(), view.Frame());
-    // feels 'wrong' to do continuous lines if grid is on...
-    if( Owner().GridActive() )
-        Plot_cb( p.x, p.y, (void*)this );
+    assert(m_Tx && m_Stamper);
+    m_Tx->BeginDamage(m_Stamper->Focus(), m_Stamper->Frame());
+    if( !m_Joined )
+        m_Stamper->Stamp(p);
     else
     {
-        // TODO: should not draw first point (m_Pos) - it's already been drawn.
-        WalkLine( m_Pos.x, m_Pos.y, p.x, p.y, Plot_cb, this );
+        std::vector<Point> pts;
+        LinePoints( m_Pos.x, m_Pos.y, p.x, p.y, pts );
+        // first point (m_Pos) has already been drawn.
+        pts.erase(pts.begin());
+        m_Stamper->Stamp(pts);
     }
     m_Tx->EndDamage();
     m_Pos = p;
@@ -372,6 +599,8 @@ void PencilTool::OnUp( EditView& , Point const& p, Button b )
     m_Pos = p;
     m_DownButton = NONE;
     m_View = 0;
+    delete m_Stamper;
+    m_Stamper = 0;
     assert( m_Tx != 0 );
     Owner().AddCmd(m_Tx->Commit());
     delete m_Tx;
@@ -387,21 +616,6 @@ void PencilTool::DrawCursor( EditView& view )
     view.AddCursorDamage( viewdmg );
 }
 
-//static
-void PencilTool::Plot_cb( int x, int y, void* user )
-{
-
-    PencilTool* that = (PencilTool*)user;
-    EditView& view = *that->m_View;
-
-    Box dmg;
-    PlonkBrushToProj(view, Point(x,y), dmg, that->m_DownButton );
-
-    assert(that->m_Tx != 0);
-    that->m_Tx->AddDamage( dmg );
-}
-
-
 //------------------------------
 
 
@@ -410,14 +624,12 @@ LineTool::LineTool( Editor& owner ) :
     m_From(0,0),
     m_To(0,0),
     m_DownButton(NONE),
-    m_View(0),
-    m_Tx(0)
+    m_View(0)
 {
 }
 
 LineTool::~LineTool()
 {
-    assert(m_Tx==0);
 }
 
 
@@ -447,11 +659,12 @@ void LineTool::OnUp( EditView& view, Point const& p, Button b )
     {
         DrawTransaction tx(view.Proj());
         m_To = p;
-        m_Tx = &tx; // to give plot_cb access
-        m_Tx->BeginDamage(view.Focus(), view.Frame());
-        WalkLine( m_From.x, m_From.y, m_To.x, m_To.y, Plot_cb, this );
+        tx.BeginDamage(view.Focus(), view.Frame());
+        std::vector<Point> pts;
+        LinePoints( m_From.x, m_From.y, m_To.x, m_To.y, pts );
+        BrushStamper stamper(view, m_DownButton, tx);
+        stamper.Stamp(pts);
         tx.EndDamage();
-        m_Tx = 0;
         Cmd* c = tx.Commit();
         Owner().AddCmd(c);
         m_DownButton = NONE;
@@ -460,20 +673,6 @@ void LineTool::OnUp( EditView& view, Point const& p, Button b )
     }
 }
 
-//static
-void LineTool::Plot_cb( int x, int y, void* user )
-{
-    LineTool* that = (LineTool*)user;
-    EditView& view = *that->m_View;
-
-    Box dmg;
-    PlonkBrushToProj(view, Point(x,y), dmg, that->m_DownButton);
-
-    that->m_Tx->AddDamage(dmg);
-}
-
-
-
 void LineTool::DrawCursor( EditView& view )
 {
     m_CursorDamage.SetEmpty();
@@ -560,7 +759,21 @@ void BrushPickupTool::OnUp( EditView& view, Point const& p, Button )
     if( pickup.Empty() )
         return;
 
-    Brush* brush = new Brush( FULLCOLOUR, view.FocusedImgConst(), pickup, Owner().BGPen() );
+    Brush* brush;
+    if (view.FocusedImgConst().Fmt() == FMT_RGBA8PM) {
+        // brushes are always straight alpha
+        Img area(view.FocusedImgConst(), pickup);
+        Img* straight = ConvertRGBA8PMtoRGBA8(area);
+        brush = new Brush( FULLCOLOUR, *straight, straight->Bounds(), Owner().BGPen() );
+        delete straight;
+    } else if (FmtIsPacked(view.FocusedImgConst().Fmt())) {
+        // brushes are always I8 rather than packed
+        Img* unpacked = UnpackArea(view.FocusedImgConst(), pickup);
+        brush = new Brush( FULLCOLOUR, *unpacked, unpacked->Bounds(), Owner().BGPen() );
+        delete unpacked;
+    } else {
+        brush = new Brush( FULLCOLOUR, view.FocusedImgConst(), pickup, Owner().BGPen() );
+    }
 
     // copy in palette
     brush->SetPalette(view.FocusedPaletteConst());
@@ -721,49 +934,29 @@ void RectTool::OnUp( EditView& view, Point const& p, Button b )
 
     tx.BeginDamage(view.Focus(), view.Frame());
 
+    std::vector<Point> pts;
     // top (including left and rightmost pixels)
-    dmg.SetEmpty();
     y = rect.YMin();
     for( x=rect.XMin(); x<=rect.XMax(); ++x )
-    {
-        Box tmp;
-        PlonkBrushToProj(view, Point(x,y), tmp, m_DownButton);
-        dmg.Merge( tmp );
-    }
-    tx.AddDamage( dmg );
+        pts.push_back(Point(x,y));
 
     // right edge (exclude top and bottom rows)
-    dmg.SetEmpty();
     x = rect.XMax();
     for( y=rect.YMin()+1; y<=rect.YMax()-1; ++y )
-    {
-        Box tmp;
-        PlonkBrushToProj(view, Point(x,y), tmp, m_DownButton);
-        dmg.Merge( tmp );
-    }
-    tx.AddDamage( dmg );
+        pts.push_back(Point(x,y));
 
     // bottom edge (including right and leftmost pixels)
-    dmg.SetEmpty();
     y = rect.YMax();
     for( x=rect.XMax(); x>=rect.XMin(); --x )
-    {
-        Box tmp;
-        PlonkBrushToProj(view, Point(x,y), tmp, m_DownButton );
-        dmg.Merge( tmp );
-    }
-    tx.AddDamage( dmg );
+        pts.push_back(Point(x,y));
 
     // left edge (exclude bottom and top rows)
-    dmg.SetEmpty();
     x = rect.XMin();
     for( y=rect.YMax()-1; y>=rect.YMin()+1; --y )
-    {
-        Box tmp;
-        PlonkBrushToProj(view, Point(x,y), tmp, m_DownButton );
-        dmg.Merge( tmp );
-    }
-    tx.AddDamage( dmg );
+        pts.push_back(Point(x,y));
+
+    BrushStamper stamper(view, m_DownButton, tx);
+    stamper.Stamp(pts);
 
     tx.EndDamage();
 
@@ -895,7 +1088,7 @@ void FilledRectTool::OnUp( EditView& view, Point const& p, Button b )
         default:
             {
                 if( m_DownButton == DRAW )
-                    img.FillBox( Owner().FGPen(),r );
+                    img.BlendBox( Owner().FGPen(),r );
                 else    //if( m_DownButton == ERASE )
                     img.FillBox( Owner().BGPen(),r );
             }
@@ -946,14 +1139,12 @@ CircleTool::CircleTool( Editor& owner ) :
     m_From(0,0),
     m_To(0,0),
     m_DownButton(NONE),
-    m_View(0),
-    m_Tx(0)
+    m_View(0)
 {
 }
 
 CircleTool::~CircleTool()
 {
-    assert(m_Tx==0);
 }
 
 void CircleTool::OnDown( EditView& view, Point const& p, Button b )
@@ -984,34 +1175,22 @@ void CircleTool::OnUp( EditView& view, Point const& p, Button b )
     m_To = p;
 
     DrawTransaction tx(view.Proj());
-    m_Tx = &tx;
     int rx = std::abs( m_To.x - m_From.x );
     int ry = std::abs( m_To.y - m_From.y );
 
     tx.BeginDamage(view.Focus(), view.Frame());
-    WalkEllipse( m_From.x, m_From.y, rx, ry, Plot_cb, this );
+    std::vector<Point> pts;
+    EllipsePoints( m_From.x, m_From.y, rx, ry, pts );
+    BrushStamper stamper(view, m_DownButton, tx);
+    stamper.Stamp(pts);
     tx.EndDamage();
     Cmd* c= tx.Commit();
-    m_Tx = 0;
     Owner().AddCmd(c);
     m_DownButton = NONE;
     m_View = 0;
     m_From = m_To;
 }
 
-//static
-void CircleTool::Plot_cb( int x, int y, void* user )
-{
-    CircleTool* that = (CircleTool*)user;
-    EditView& view = *that->m_View;
-
-    Box dmg;
-    PlonkBrushToProj(view, Point(x,y), dmg, that->m_DownButton );
-    that->m_Tx->AddDamage(dmg);
-}
-
-
-
 void CircleTool::DrawCursor( EditView& view )
 {
     m_CursorDamage.SetEmpty();
@@ -1056,14 +1235,12 @@ FilledCircleTool::FilledCircleTool( Editor& owner ) :
     m_From(0, 0),
     m_To(0, 0),
     m_DownButton(NONE),
-    m_View(0),
-    m_Tx(0)
+    m_View(0)
 {
 }
 
 FilledCircleTool::~FilledCircleTool()
 {
-    assert(m_Tx==0);
 }
 
 
@@ -1096,60 +1273,40 @@ void FilledCircleTool::OnUp( EditView& view, Point const& p, Button b )
     m_To = p;
 
     DrawTransaction tx(view.Proj());
-    m_Tx = &tx;
     int rx = std::abs( m_To.x - m_From.x );
     int ry = std::abs( m_To.y - m_From.y );
     tx.BeginDamage(view.Focus(), view.Frame());
 
+    std::vector<Box> spans;
+    FilledEllipseSpans( m_From.x, m_From.y, rx, ry, spans );
+
+    Img& destImg = view.FocusedImg();
+    PenColour pen = (m_DownButton == DRAW) ? Owner().FGPen() : Owner().BGPen();
+    std::vector<PenColour> range;
     DrawMode dm = view.Ed().Mode();
-    switch (dm.mode) {
-        case DrawMode::DM_RANGE:
-            view.FocusedRange(m_Range);
-            WalkFilledEllipse( m_From.x, m_From.y, rx, ry, Draw_hline_range_cb, this );
-            break;
-        default:
-            WalkFilledEllipse( m_From.x, m_From.y, rx, ry, Draw_hline_cb, this );
-            break;
+    if (dm.mode == DrawMode::DM_RANGE) {
+        view.FocusedRange(range);
+    }
+    RangeShift shift(range, (m_DownButton == DRAW) ? 1 : -1, destImg.Fmt());
+    for (auto& b : spans) {
+        if (dm.mode == DrawMode::DM_RANGE) {
+            DrawRectRangeShift(destImg, b, shift);
+        } else if (m_DownButton == DRAW) {
+            destImg.BlendBox(pen, b);
+        } else {
+            destImg.FillBox(pen, b);
+        }
+        tx.AddDamage(b);
     }
 
     tx.EndDamage();
     Cmd* c = tx.Commit();
-    m_Tx = 0;
     Owner().AddCmd(c);
     m_DownButton = NONE;
     m_View = 0;
     m_From = m_To;
 }
 
-//static
-void FilledCircleTool::Draw_hline_cb( int x0, int x1, int y, void* user )
-{
-    FilledCircleTool* that = (FilledCircleTool*)user;
-    EditView& view = *that->m_View;
-
-    Box b( x0,y,x1-x0,1 );
-    if( that->m_DownButton == DRAW )
-        view.FocusedImg().FillBox(that->Owner().FGPen(),b);
-    else if( that->m_DownButton == ERASE )
-        view.FocusedImg().FillBox(that->Owner().BGPen(),b);
-    that->m_Tx->AddDamage(b);
-}
-
-//static
-void FilledCircleTool::Draw_hline_range_cb( int x0, int x1, int y, void* user )
-{
-    FilledCircleTool* that = (FilledCircleTool*)user;
-    EditView& view = *that->m_View;
-    Img& destImg = view.FocusedImg();
-    Box b(x0, y, x1 - x0, 1);
-    if( that->m_DownButton == DRAW )
-       DrawRectRangeShift(destImg, b, that->m_Range, 1);
-    else if( that->m_DownButton == ERASE )
-       DrawRectRangeShift(destImg, b, that->m_Range, -1);
-    that->m_Tx->AddDamage(b);
-}
-
-
 void FilledCircleTool::DrawCursor( EditView& view )
 {
     m_CursorDamage.SetEmpty();
@@ -28,6 +28,7 @@ class Project;
 class Editor;
 class DrawTransaction;
 class Cmd_Batch;
+class BrushStamper;
 
 
 class Tool
@@ -44,6 +45,11 @@ public:
 	virtual void OnUp( EditView& view, Point const& p, Button b ) = 0;
 	virtual void DrawCursor( EditView& view )=0;
     virtual bool ObeyGrid() { return true; }
+
+    // True if OnMove() is currently just drawing into the project (no
+    // cursors, GUI calls, Cmds etc), so it can be run on the stroke
+    // worker thread (see StrokeQueue).
+    virtual bool Stroking() const { return false; }
 protected:
     Editor& Owner() { return m_Owner; }
 private:
@@ -60,13 +66,15 @@ public:
 	virtual void OnMove( EditView& view, Point const& p);
 	virtual void OnUp( EditView& view, Point const& p, Button b );
 	virtual void DrawCursor( EditView& view );
+    virtual bool Stroking() const { return m_DownButton != NONE; }
 private:
-    static void Plot_cb( int x, int y, void* user );
 	Point m_Pos;
 	Button m_DownButton;
     EditView* m_View;
+    bool m_Joined;      // join up the points with lines?
 
     DrawTransaction *m_Tx;
+    BrushStamper* m_Stamper;    // for the current stroke
 };
 
 
@@ -80,14 +88,12 @@ public:
 	virtual void OnUp( EditView& view, Point const& p, Button b );
     virtual void DrawCursor( EditView& view );
 private:
-    static void Plot_cb( int x, int y, void* user );
     static void PlotCursor_cb( int x, int y, void* user );
     Point m_From;
     Point m_To;
     Button m_DownButton;
     EditView* m_View;
     Box m_CursorDamage;
-    DrawTransaction *m_Tx;
 };
 
 
@@ -174,14 +180,12 @@ public:
 	virtual void OnUp( EditView& view, Point const& p, Button b );
     virtual void DrawCursor( EditView& view );
 private:
-    static void Plot_cb( int x, int y, void* user );
     static void PlotCursor_cb( int x, int y, void* user );
     Point m_From;
     Point m_To;
     Button m_DownButton;
     EditView* m_View;
     Box m_CursorDamage;
-    DrawTransaction *m_Tx;
 };
 
 
@@ -196,18 +200,12 @@ public:
 	virtual void OnUp( EditView& view, Point const& p, Button b );
     virtual void DrawCursor( EditView& view );
 private:
-    static void Draw_hline_cb( int x0, int x1, int y, void* user );
-    static void Draw_hline_range_cb( int x0, int x1, int y, void* user );
     static void Cursor_hline_cb( int x0, int x1, int y, void* user );
     Point m_From;
     Point m_To;
     Button m_DownButton;
     EditView* m_View;
     Box m_CursorDamage;
-    DrawTransaction *m_Tx;
-
-    // state for DM_RANGE drawing callback:
-    std::vector<PenColour> m_Range;
 };
 
 